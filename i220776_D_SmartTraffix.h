@@ -9,135 +9,136 @@
 #include <pthread.h>
 #include <queue>
 #include <map>
+#include <unordered_map>
 #include "i220776_D_roadtile.h"
 #include "i220776_D_trafficlightgroup.h"
 #include "i220776_D_car.h"
+#include "i220776_D_checkpointStream.h"
+#include "i220776_D_signalPlan.h"
+#include "i220776_D_lightController.h"
+#include "i220776_D_worldSnapshot.h"
+#include "i220776_D_challanReport.h"
 #include <sstream>
 #include <sys/wait.h>
 #include <sys/time.h>
 #include <string.h>
 
-// Speed limits in km/h
-const float SPEED_LIMIT_REGULAR = 60.0f; // For CAR1-4
-const float SPEED_LIMIT_CAR5 = 80.0f;    // For CAR5
-const float SPEED_LIMIT_CAR6 = 40.0f;    // For CAR6
+// Capacity of the banker's algorithm matrices in SmartTraffix
+const int MAX_TRACKED_VEHICLES = 5000;
+
+// Speed limits, categories and fines per vehicle type are in VEHICLE_TRAITS (i220776_D_vehicleTraits.h)
 
 using namespace std;
 using namespace sf;
 
-enum VehicleCategory
-{
-    REGULAR,   // CAR1-CAR4
-    EMERGENCY, // CAR5
-    HEAVY,     // CAR6-CAR7
-    UNKNOWN
-};
-
-enum PaymentStatus
-{
-    PAID,
-    UNPAID,
-    OVERDUE
-};
-
-class ChallanRecord
-{
-public:
-    int challanId;
-    string vehicleNumber;
-    VehicleCategory vehicleCategory;
-    float baseAmount;
-    float totalAmount;
-    time_t issueDate;
-    time_t dueDate;
-    PaymentStatus status;
-};
-class ChallanNode
-{
-public:
-    ChallanRecord challan;
-    ChallanNode *next;
-
-    ChallanNode(const ChallanRecord &record) : challan(record), next(nullptr) {}
-};
-
+// The ledger is shared: the simulation thread issues challans while portal and payment
+// threads (and the command server) look them up and pay them. Every public member takes the
+// ledger's mutex, so none of them may be called from an iterateChallans callback.
+// The challans are stored column by column (i220776_D_challanReport.h) for report().
 class ChallanGenerator
 {
 private:
-    ChallanNode *challanHead; // Head of the linked list of challans
-    ChallanNode *challanTail; // Tail of the linked list for efficient insertion
+    mutable pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    ChallanColumns ledger; // One row per challan in issue order
+    // Each plate's challans as a chain of rows in issue order, so a lookup visits only that plate's rows
+    struct PlateRows
+    {
+        uint32_t first, last;
+    };
+    unordered_map<PlateId, PlateRows> rowsByPlate;
+    vector<uint32_t> nextRowOfPlate; // Per row: the next row of the same plate, NO_ROW after the last
+    static constexpr uint32_t NO_ROW = UINT32_MAX;
     int nextChallanId;
     int totalChallanCount;
+    int unpaidCount;         // Counters for WorldSnapshot, kept as records come and go
+    float outstandingAmount;
 
     const float SERVICE_CHARGE_RATE = 0.17;
-    const float REGULAR_FINE = 5000.0f;
-    const float HEAVY_FINE = 7000.0f;
 
-    VehicleCategory categorizeVehicle(tVehicleType type)
+    string formatDate(time_t timestamp)
     {
-        if (type == CAR5)
-            return EMERGENCY;
-        if (type >= CAR6 && type <= CAR7)
-            return HEAVY;
-        if (type >= CAR1 && type <= CAR4)
-            return REGULAR;
-        return UNKNOWN;
+        char buffer[80];
+        tm local;
+        strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", localtime_r(&timestamp, &local));
+        return string(buffer);
     }
 
-    float calculateFine(VehicleCategory category)
+public:
+    ChallanGenerator() : nextChallanId(1), totalChallanCount(0), unpaidCount(0), outstandingAmount(0) {}
+
+    ~ChallanGenerator()
     {
-        switch (category)
-        {
-        case REGULAR:
-            return REGULAR_FINE;
-        case HEAVY:
-            return HEAVY_FINE;
-        case EMERGENCY:
-            return 0.0f;
-        default:
-            return REGULAR_FINE;
-        }
+        clear();
     }
 
-    string formatDate(time_t timestamp)
+    // Drops every challan
+    void clear()
     {
-        char buffer[80];
-        strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", localtime(&timestamp));
-        return string(buffer);
+        pthread_mutex_lock(&mutex);
+        clearLocked();
+        pthread_mutex_unlock(&mutex);
     }
 
-public:
-    ChallanGenerator() : challanHead(nullptr), challanTail(nullptr),
-                         nextChallanId(1), totalChallanCount(0) {}
+    // Adds a record to the end of the ledger; its id must be above every id already in it
+    void append(const ChallanRecord &challan)
+    {
+        pthread_mutex_lock(&mutex);
+        appendLocked(challan);
+        pthread_mutex_unlock(&mutex);
+    }
 
-    ~ChallanGenerator()
+private:
+    void clearLocked()
+    {
+        ledger.clear();
+        unordered_map<PlateId, PlateRows>().swap(rowsByPlate);
+        vector<uint32_t>().swap(nextRowOfPlate);
+        totalChallanCount = 0;
+        unpaidCount = 0;
+        outstandingAmount = 0;
+    }
+
+    void appendLocked(const ChallanRecord &challan)
     {
-        // Clean up the linked list
-        while (challanHead != nullptr)
+        MemoryScope scope(MEMORY_CHALLANS);
+        uint32_t row = ledger.size();
+        ledger.push(challan);
+        nextRowOfPlate.push_back(NO_ROW);
+        auto inserted = rowsByPlate.insert({challan.plate, {row, row}});
+        if (!inserted.second)
+        {
+            nextRowOfPlate[inserted.first->second.last] = row;
+            inserted.first->second.last = row;
+        }
+        totalChallanCount++;
+        if (challan.status != PAID)
         {
-            ChallanNode *temp = challanHead;
-            challanHead = challanHead->next;
-            delete temp;
+            unpaidCount++;
+            outstandingAmount += challan.totalAmount;
         }
     }
 
-    ChallanRecord generateChallan(const string &vehicleNumber, tVehicleType vehicleType, float speed)
+public:
+
+    // Prints the challan unless announce is false, as for load tests
+    ChallanRecord generateChallan(PlateId plate, tVehicleType vehicleType, float speed, bool announce = true)
     {
-        VehicleCategory category = categorizeVehicle(vehicleType);
+        const VehicleTraits &traits = traitsOf(vehicleType);
+        VehicleCategory category = traits.category;
 
         // Emergency vehicles are exempt
         if (category == EMERGENCY)
         {
-            cout << "Emergency vehicle " << vehicleNumber << " is exempt from challans.\n";
+            if (announce)
+                cout << "Emergency vehicle " << plates().format(plate) << " is exempt from challans.\n";
             return {};
         }
 
-        float baseAmount = calculateFine(category);
+        float baseAmount = traits.fine;
         float totalAmount = baseAmount * (1 + SERVICE_CHARGE_RATE);
 
         ChallanRecord challan;
-        challan.challanId = nextChallanId++;
-        challan.vehicleNumber = vehicleNumber;
+        challan.plate = plate;
         challan.vehicleCategory = category;
         challan.baseAmount = baseAmount;
         challan.totalAmount = totalAmount;
@@ -145,66 +146,101 @@ public:
         challan.dueDate = challan.issueDate + (3 * 24 * 60 * 60); // 3 days
         challan.status = UNPAID;
 
-        // Create a new node and add to the linked list
-        ChallanNode *newNode = new ChallanNode(challan);
-
-        if (challanHead == nullptr)
-        {
-            challanHead = newNode;
-            challanTail = newNode;
-        }
-        else
-        {
-            challanTail->next = newNode;
-            challanTail = newNode;
-        }
-
-        totalChallanCount++;
+        // Add to the ledger
+        pthread_mutex_lock(&mutex);
+        challan.challanId = nextChallanId++;
+        appendLocked(challan);
+        pthread_mutex_unlock(&mutex);
 
-        displayChallan(challan);
+        if (announce)
+            displayChallan(challan);
         return challan;
     }
 
     // Find challans for a specific vehicle number
-    bool findChallansByVehicleNumber(const string &vehicleNumber, ChallanRecord *resultArray, int &resultCount, int maxResults)
+    bool findChallansByVehicleNumber(PlateId plate, ChallanRecord *resultArray, int &resultCount, int maxResults)
     {
         resultCount = 0;
-        ChallanNode *current = challanHead;
+        pthread_mutex_lock(&mutex);
+        auto it = rowsByPlate.find(plate);
+        uint32_t row = it != rowsByPlate.end() ? it->second.first : NO_ROW;
+        for (; row != NO_ROW && resultCount < maxResults; row = nextRowOfPlate[row])
+            resultArray[resultCount++] = ledger.row(row);
+        pthread_mutex_unlock(&mutex);
+
+        return resultCount > 0;
+    }
 
-        while (current != nullptr && resultCount < maxResults)
+    // Marks the vehicle's unpaid challan as paid when the amount matches it to the rupee, as displayed.
+    // Returns false for an unknown id, another vehicle's challan, a paid one or a wrong amount.
+    bool payChallan(int challanId, PlateId plate, float amount)
+    {
+        bool paid = false;
+        pthread_mutex_lock(&mutex);
+        long row = ledger.find(challanId);
+        ChallanRecord challan = row != -1 ? ledger.row(row) : ChallanRecord{};
+        if (row != -1 && challan.plate == plate && challan.status != PAID && fabs(challan.totalAmount - amount) < 0.5f)
         {
-            if (current->challan.vehicleNumber == vehicleNumber)
-            {
-                resultArray[resultCount++] = current->challan;
-            }
-            current = current->next;
+            ledger.setStatus(row, PAID);
+            unpaidCount--;
+            outstandingAmount -= challan.totalAmount;
+            paid = true;
         }
-
-        return resultCount > 0;
+        pthread_mutex_unlock(&mutex);
+        return paid;
     }
 
     // Get total number of challans
     int getTotalChallanCount() const
     {
-        return totalChallanCount;
+        pthread_mutex_lock(&mutex);
+        int count = totalChallanCount;
+        pthread_mutex_unlock(&mutex);
+        return count;
+    }
+
+    int getUnpaidCount() const
+    {
+        pthread_mutex_lock(&mutex);
+        int count = unpaidCount;
+        pthread_mutex_unlock(&mutex);
+        return count;
     }
 
-    // Iterate through all challans (for analytics or display)
+    float getOutstandingAmount() const
+    {
+        pthread_mutex_lock(&mutex);
+        float amount = outstandingAmount;
+        pthread_mutex_unlock(&mutex);
+        return amount;
+    }
+
+    // Iterate through all challans (for display), holding the mutex throughout; aggregates go through report()
     void iterateChallans(void (*callback)(const ChallanRecord &))
     {
-        ChallanNode *current = challanHead;
-        while (current != nullptr)
-        {
-            callback(current->challan);
-            current = current->next;
-        }
+        pthread_mutex_lock(&mutex);
+        for (size_t row = 0; row < ledger.size(); row++)
+            callback(ledger.row(row));
+        pthread_mutex_unlock(&mutex);
+    }
+
+    // Revenue, unpaid and overdue totals and repeat offenders of the challans matched by query.
+    // Holds the mutex only to copy the chunk table: the threads scan the rows as of the call while
+    // new challans are issued. A payment made during the scan may or may not be counted.
+    ChallanReport report(const ChallanReportQuery &query, int numThreads = DEFAULT_REPORT_THREADS) const
+    {
+        MemoryScope scope(MEMORY_CHALLANS);
+        pthread_mutex_lock(&mutex);
+        ChallanColumns rows = ledger;
+        pthread_mutex_unlock(&mutex);
+        return buildChallanReport(rows, query, numThreads);
     }
 
     void displayChallan(const ChallanRecord &challan)
     {
         cout << "Challan Details:\n";
         cout << "ID: " << challan.challanId << "\n";
-        cout << "Vehicle: " << challan.vehicleNumber << "\n";
+        cout << "Vehicle: " << plates().format(challan.plate) << "\n";
         cout << "Category: " << getCategoryName(challan.vehicleCategory) << "\n";
         cout << "Base Fine: " << challan.baseAmount << " PKR\n";
         cout << "Total Amount: " << challan.totalAmount << " PKR\n";
@@ -212,134 +248,198 @@ public:
         cout << "Due Date: " << formatDate(challan.dueDate) << "\n";
     }
 
-    string getCategoryName(VehicleCategory category)
+    // Checkpoint support: the whole ledger in issue order
+    void saveState(CheckpointWriter &writer) const
+    {
+        pthread_mutex_lock(&mutex);
+        writer.put<int32_t>(nextChallanId);
+        writer.put<int32_t>(totalChallanCount);
+        for (size_t row = 0; row < ledger.size(); row++)
+        {
+            const ChallanRecord challan = ledger.row(row);
+            writer.put<int32_t>(challan.challanId);
+            writer.putString(plates().format(challan.plate));
+            writer.put<int32_t>(challan.vehicleCategory);
+            writer.put(challan.baseAmount);
+            writer.put(challan.totalAmount);
+            writer.put<int64_t>(challan.issueDate);
+            writer.put<int64_t>(challan.dueDate);
+            writer.put<int32_t>(challan.status);
+        }
+        pthread_mutex_unlock(&mutex);
+    }
+
+    bool loadState(CheckpointReader &reader)
     {
-        switch (category)
+        clear();
+        int firstFreeId = reader.get<int32_t>();
+        int count = reader.get<int32_t>();
+        for (int i = 0; i < count && !reader.fail(); i++)
         {
-        case REGULAR:
-            return "Regular";
-        case EMERGENCY:
-            return "Emergency";
-        case HEAVY:
-            return "Heavy";
-        default:
-            return "Unknown";
+            ChallanRecord challan;
+            challan.challanId = reader.get<int32_t>();
+            challan.plate = plates().intern(reader.getString());
+            challan.vehicleCategory = static_cast<VehicleCategory>(reader.get<int32_t>());
+            challan.baseAmount = reader.get<float>();
+            challan.totalAmount = reader.get<float>();
+            challan.issueDate = reader.get<int64_t>();
+            challan.dueDate = reader.get<int64_t>();
+            challan.status = static_cast<PaymentStatus>(reader.get<int32_t>());
+            append(challan);
         }
+        pthread_mutex_lock(&mutex);
+        nextChallanId = firstFreeId;
+        pthread_mutex_unlock(&mutex);
+        return !reader.fail();
+    }
+
+    string getCategoryName(VehicleCategory category)
+    {
+        return challanCategoryName(category);
     }
 };
 
 class SmartTraffix
 {
 private:
-    TrafficLight *trafficLights;
     int lightCount;
-    Clock rotationClock;
-    Clock car5PriorityClock;
-    const float LIGHT_INTERVAL = 10.0f;
-    const float CAR5_PRIORITY_DURATION = 5.0f;
+    SimTick now;                    // Tick of the last update()
+    TickTimer car5PriorityTimer;
+    float greenTimes[4];            // Seconds each light stays green in the rotation
+    float car5PriorityDuration;     // Seconds a CAR5 keeps its green after its last request
+    PhasePlan plan;                 // greenTimes compiled into one phase per light
+    SimTick cycleStart;             // Tick at which the current cycle of plan began
+    int currentPhase;
     int currentGreenIndex;
+    SignalState signalState;        // The only copy of the light states, see signals()
+    SimTick lastChange[SCENARIO_MAX_LIGHTS]; // Tick each light last changed colour
     bool car5PriorityActive = false;
     int car5PriorityLightIndex = -1;
-    vector<pid_t> processPIDs;
-    int available[4];        // Number of available lanes at each light
-    int maximum[5000][4];    // Maximum demand of each vehicle
-    int allocation[5000][4]; // Current allocation
-    int need[5000][4];       // Remaining need
+    LightControllers controllers; // One child process per light, see i220776_D_lightController.h
+    int available[4];                         // Number of available lanes at each light
+    int maximum[MAX_TRACKED_VEHICLES][4];    // Maximum demand of each vehicle
+    int allocation[MAX_TRACKED_VEHICLES][4]; // Current allocation
+    int need[MAX_TRACKED_VEHICLES][4];       // Remaining need
 
     int numVehicles; 
     int numLights;   
 
-    queue<string> activeChallans;  // Queue to manage vehicle numbers with active challans
-    queue<string> speedViolations; // Queue to hold vehicle numbers violating speed
-    const int SPEED_LIMIT = 60; // Speed limit in km/h
+    queue<PlateId> activeChallans;  // Queue to manage vehicle numbers with active challans
+    queue<PlateId> speedViolations; // Queue to hold vehicle numbers violating speed
 
     // Analytics data (using queue instead of array)
     queue<string> vehicleCount; // Queue to store vehicle type counts
     int activeChallanCount = 0;
 
-    void rotateTrafficLights()
+    static void saveQueue(CheckpointWriter &writer, queue<string> items)
     {
-        int nextGreenIndex = (currentGreenIndex - 1 + lightCount) % lightCount; // Ensures it wraps around
-        bool resourceAllocated = false;
-
-        // Check for resource allocation safety
-        for (int i = 0; i < numVehicles; ++i)
+        writer.put<uint32_t>(items.size());
+        while (!items.empty())
         {
-            if (requestResource(i, nextGreenIndex))
-            {
-                trafficLights[currentGreenIndex].setState(RED);
-                trafficLights[nextGreenIndex].setState(GREEN);
-                currentGreenIndex = nextGreenIndex;
-                resourceAllocated = true;
-                break;
-            }
+            writer.putString(items.front());
+            items.pop();
         }
+    }
 
-        // If no resource was allocated, proceed with regular rotation
-        if (!resourceAllocated)
-        {
-            trafficLights[currentGreenIndex].setState(RED);
-            trafficLights[nextGreenIndex].setState(GREEN);
-            currentGreenIndex = nextGreenIndex;
-        }
+    static void loadQueue(CheckpointReader &reader, queue<string> &items)
+    {
+        items = queue<string>();
+        uint32_t count = reader.get<uint32_t>();
+        for (uint32_t i = 0; i < count && !reader.fail(); i++)
+            items.push(reader.getString());
     }
 
-    void detectAndResolveDeadlock()
+    // Plate queues are stored as plate strings, ids are only valid within one process
+    static void saveQueue(CheckpointWriter &writer, queue<PlateId> items)
     {
-        // Detect potential deadlock (all lights are red)
-        bool deadlock = true;
-        for (int i = 0; i < lightCount; ++i)
+        writer.put<uint32_t>(items.size());
+        while (!items.empty())
         {
-            if (trafficLights[i].getState() == GREEN)
-            {
-                deadlock = false;
-                break;
-            }
+            writer.putString(plates().format(items.front()));
+            items.pop();
         }
+    }
 
-        // Resolve deadlock by granting a green light to the least used lane
-        if (deadlock)
-        {
-            for (int i = 0; i < lightCount; ++i)
-            {
-                trafficLights[i].setState(i == 0 ? GREEN : RED);
-            }
-        }
+    static void loadQueue(CheckpointReader &reader, queue<PlateId> &items)
+    {
+        items = queue<PlateId>();
+        uint32_t count = reader.get<uint32_t>();
+        for (uint32_t i = 0; i < count && !reader.fail(); i++)
+            items.push(plates().intern(reader.getString()));
     }
 
-    void createProcessForLight(int lightIndex)
+    // Switches to a phase of the plan and publishes its precomputed word
+    void enterPhase(int phase)
     {
-        pid_t pid = fork();
+        int nextGreenIndex = plan.phase(phase).green;
 
-        if (pid < 0)
+        // Check for resource allocation safety; the rotation goes ahead either way
+        for (int i = 0; i < numVehicles; ++i)
         {
-            cerr << "Fork failed for light " << lightIndex << endl;
-            exit(1);
+            if (requestResource(i, nextGreenIndex))
+                break;
         }
-        else if (pid == 0)
+
+        currentPhase = phase;
+        currentGreenIndex = nextGreenIndex;
+        publish(plan.phase(phase).word);
+    }
+
+    void publish(SignalWord word)
+    {
+        uint32_t changed = signalLights(word ^ signalState.load());
+        for (int i = 0; i < lightCount; i++)
         {
-            // Child process
-            while (true)
-            {
-                sleep(1); // Simulate work
-            }
-            exit(0);
+            if ((changed >> i) & 1)
+                lastChange[i] = now;
         }
-        else
+        signalState.publish(word);
+    }
+
+    // Acts on the light controllers' decisions between scheduled phase changes: a starved light
+    // is served next, and a green nobody is using ends early once another light has vehicles
+    // waiting
+    void actuate(const LightDecision decisions[])
+    {
+        bool demand = false;
+        int starved = -1;
+        for (int i = 0; i < lightCount; i++)
         {
-            // Parent process
-            processPIDs.push_back(pid);
+            demand = demand || decisions[i].demand;
+            if (decisions[i].starved && starved == -1)
+                starved = i;
         }
+
+        if (starved != -1)
+            startPhase(plan.phaseFor(starved));
+        else if (decisions[currentGreenIndex].gapOut && demand)
+            startPhase((currentPhase + 1) % lightCount);
     }
 
-    void generateChallan(string vehicleNumber)
+    // Enters a phase from its first tick, moving the cycle so that phase begins now
+    void startPhase(int phase)
+    {
+        cycleStart = now - plan.phase(phase).begin;
+        enterPhase(phase);
+    }
+
+    void detectAndResolveDeadlock()
     {
+        // Detect potential deadlock (all lights are red)
+        uint32_t allRed = (1u << lightCount) - 1;
+        if (signalLights(signalState.load()) == allRed)
+            startPhase(0); // Resolve it by restarting the cycle at light 0
+    }
+
+    void generateChallan(PlateId plate)
+    {
+        MemoryScope scope(MEMORY_ANALYTICS);
         // Check if vehicle is not already in the active challan queue
-        queue<string> tempQueue = activeChallans; // Temporarily store current state of activeChallans queue
+        queue<PlateId> tempQueue = activeChallans; // Temporarily store current state of activeChallans queue
         bool isChallanActive = false;
         while (!tempQueue.empty())
         {
-            if (tempQueue.front() == vehicleNumber)
+            if (tempQueue.front() == plate)
             {
                 isChallanActive = true;
                 break;
@@ -349,9 +449,9 @@ private:
 
         if (!isChallanActive)
         {
-            activeChallans.push(vehicleNumber); // Add vehicle number to the challan queue
+            activeChallans.push(plate); // Add vehicle number to the challan queue
             activeChallanCount++;
-            cout << "Challan generated for vehicle: " << vehicleNumber << endl;
+            cout << "Challan generated for vehicle: " << plates().format(plate) << endl;
         }
     }
 
@@ -359,29 +459,32 @@ private:
     {
         while (!speedViolations.empty())
         {
-            string vehicleNumber = speedViolations.front();
+            PlateId plate = speedViolations.front();
             speedViolations.pop();
-            generateChallan(vehicleNumber);
+            generateChallan(plate);
         }
     }
 
 public:
-    SmartTraffix(TrafficLight *lights, int count) : trafficLights(lights),
-                                                    lightCount(count),
-                                                    currentGreenIndex(0)
-    {
-        // Initially set first light to GREEN
-        trafficLights[0].setState(GREEN);
-        for (int i = 1; i < lightCount; i++)
-        {
-            trafficLights[i].setState(RED);
-        }
+    // controllerProcesses: one child process per light, or every light decided in-process
+    SmartTraffix(int count, bool controllerProcesses = true) : lightCount(count),
+                              now(0),
+                              cycleStart(0),
+                              currentPhase(0),
+                              currentGreenIndex(0),
+                              lastChange(),
+                              controllers(count, controllerProcesses),
+                              numVehicles(0),
+                              numLights(count)
+    {
+        // Fixed 10 s rotation with 5 s ambulance priority until setTiming says otherwise
+        for (float &greenTime : greenTimes)
+            greenTime = 10.0f;
+        car5PriorityDuration = 5.0f;
 
-        // Create a process for each traffic light
-        for (int i = 0; i < lightCount; i++)
-        {
-            createProcessForLight(i);
-        }
+        // Initially set first light to GREEN
+        plan.compile(greenTimes, lightCount);
+        startPhase(0);
 
         for (int i = 0; i < lightCount; ++i)
             available[i] = 1; // Each light initially has 1 available lane
@@ -392,84 +495,152 @@ public:
         memset(need, 0, sizeof(need));
     }
 
-    void update()
+    // Splits the cycle between the lights in proportion to splits (one per light) and sets
+    // how long CAR5 priority lasts. Takes effect from the light currently green onwards: the
+    // plan is recompiled and the time already spent in the current phase carries over.
+    void setTiming(float cycle, const float splits[], float priorityDuration)
+    {
+        float splitSum = 0;
+        for (int i = 0; i < lightCount; i++)
+            splitSum += splits[i];
+        for (int i = 0; i < lightCount; i++)
+            greenTimes[i] = splitSum > 0 ? cycle * splits[i] / splitSum : cycle / lightCount;
+        car5PriorityDuration = priorityDuration;
+
+        SimTick spent = (now - cycleStart) % plan.getCycleTicks() - plan.phase(currentPhase).begin;
+        plan.compile(greenTimes, lightCount);
+        const SignalPhase &phase = plan.phase(currentPhase);
+        // A phase that is already over under the new timing ends on the next update
+        cycleStart = now - phase.begin - min(spent, phase.end - phase.begin);
+    }
+
+    void update(SimTick tick)
     {
+        now = tick;
+        controllers.collect(); // Decisions on the detector counts posted at the end of the last tick
         if (car5PriorityActive &&
-            car5PriorityClock.getElapsedTime().asSeconds() >= CAR5_PRIORITY_DURATION)
+            car5PriorityTimer.elapsedSeconds(now) >= car5PriorityDuration)
         {
-            car5PriorityActive = false;
-            car5PriorityLightIndex = -1;
-
-            trafficLights[0].setState(GREEN);
-            for (int i = 1; i < lightCount; i++)
-            {
-                trafficLights[i].setState(RED);
-            }
-            rotateTrafficLights();
+            releaseCar5Priority();
         }
 
-        if (!car5PriorityActive &&
-            rotationClock.getElapsedTime().asSeconds() >= LIGHT_INTERVAL)
+        if (!car5PriorityActive)
         {
-            rotateTrafficLights();
-            rotationClock.restart();
+            int phase = plan.phaseAt(now - cycleStart);
+            if (phase != currentPhase)
+                enterPhase(phase);
+            else
+                actuate(controllers.collect());
         }
         detectAndResolveDeadlock();
         updateChallanStatus();
     }
 
+    // Hands the light controllers this tick's detector counts and ambulance ETAs (one per light,
+    // INFINITY for none). Call once per tick after the vehicles have moved; the decisions are
+    // used by the next update() and priorityRequest().
+    void postDetectors(const DetectorCounts &counts, const float emergencyEtas[])
+    {
+        LightInput inputs[SCENARIO_MAX_LIGHTS];
+        SignalWord word = signalState.load();
+        SimTick minGreen = (SimTick)lround(MIN_GREEN_SECONDS / SIM_TICK_SECONDS);
+        for (int i = 0; i < lightCount; i++)
+        {
+            inputs[i] = {now, word, now - lastChange[i], minGreen, 2 * plan.getCycleTicks(),
+                         counts.approaching[i], counts.waiting[i], emergencyEtas[i]};
+        }
+        controllers.post(inputs);
+    }
+
+    // ETA in ticks of the ambulance a light's controller wants priority for, INFINITY for none
+    float priorityRequest(int light)
+    {
+        return controllers.collect()[light].priorityEta;
+    }
+
+    // Light states, plan phase and priority flag as one word. Safe to call from any thread:
+    // the word is replaced with a single atomic store, never modified in place.
+    SignalWord signals() const
+    {
+        return signalState.load();
+    }
+
+    // Gives lightIndex green and holds it for car5PriorityDuration after the last request.
+    // Requesting a different light moves priority there straight away.
     void handleCar5Priority(int lightIndex)
+    {
+        car5PriorityTimer.restart(now);
+        if (car5PriorityActive && car5PriorityLightIndex == lightIndex)
+            return;
+
+        car5PriorityActive = true;
+        car5PriorityLightIndex = lightIndex;
+        publish(makeSignalWord(lightCount, lightIndex, SIGNAL_NO_PHASE, true));
+    }
+
+    // Ends CAR5 priority and resumes the normal rotation at resumePhase, publishing the lights once.
+    // By default it resumes after the priority light's phase, since that light has just had its green.
+    void releaseCar5Priority(int resumePhase = -1)
     {
         if (!car5PriorityActive)
-        {
-            car5PriorityActive = true;
-            car5PriorityLightIndex = lightIndex;
-            car5PriorityClock.restart();
+            return;
 
-            for (int i = 0; i < lightCount; i++)
-            {
-                trafficLights[i].setState(i == lightIndex ? GREEN : RED);
-            }
-        }
+        if (resumePhase == -1)
+            resumePhase = (plan.phaseFor(car5PriorityLightIndex) + 1) % plan.getPhaseCount();
+        car5PriorityActive = false;
+        car5PriorityLightIndex = -1;
+        startPhase(resumePhase);
+    }
+
+    // Light currently held green for a CAR5, or -1
+    int getCar5PriorityLight() const
+    {
+        return car5PriorityActive ? car5PriorityLightIndex : -1;
     }
 
-    void monitorSpeed(const string &vehicleNumber, tVehicleType vehicleType, float speed, int laneIndex)
+    void monitorSpeed(PlateId plate, tVehicleType vehicleType, float speed, int laneIndex)
     {
-        if (speed > SPEED_LIMIT)
+        MemoryScope scope(MEMORY_ANALYTICS);
+        if (speed > traitsOf(vehicleType).speedLimit)
         {
-            cout << "Speed violation detected for vehicle: " << vehicleNumber
+            cout << "Speed violation detected for vehicle: " << plates().format(plate)
                  << " in lane " << laneIndex << endl;
-            speedViolations.push(vehicleNumber);
+            speedViolations.push(plate);
         }
     }
 
     void recordVehicle(string vehicleType)
     {
+        MemoryScope scope(MEMORY_ANALYTICS);
         vehicleCount.push(vehicleType); // Add the vehicle type to the queue
     }
 
-    void displayAnalytics()
+    int getActiveChallanCount() const { return activeChallanCount; }
+
+    // Reads the published snapshot rather than the controller, so any thread may call it
+    void displayAnalytics(const Seqlock<WorldSnapshot> &world) const
     {
         cout << "Traffic Analytics:\n";
-        queue<string> tempQueue = vehicleCount; // Copy vehicle count queue to a temporary one
-        while (!tempQueue.empty())
-        {
-            cout << "Vehicle Type " << tempQueue.front() << ": 1\n"; // Displaying count as 1 for each vehicle type recorded
-            tempQueue.pop();
-        }
-        cout << "Active Challans: " << activeChallanCount << "\n";
-        // Display active challans
-        tempQueue = activeChallans;
-        while (!tempQueue.empty())
-        {
-            cout << "Vehicle " << tempQueue.front() << " has an active challan.\n";
-            tempQueue.pop();
-        }
+        printWorldSnapshot(cout, world.read(), lightCount);
     }
+    // Records a vehicle's maximum demand on a light for the banker's safety check.
+    // Vehicle IDs are dense; numVehicles grows to cover the highest registered ID.
+    bool registerVehicleDemand(int vehicleID, int lightIndex, int units)
+    {
+        if (vehicleID < 0 || vehicleID >= MAX_TRACKED_VEHICLES || lightIndex < 0 || lightIndex >= numLights)
+            return false;
+
+        maximum[vehicleID][lightIndex] = units;
+        need[vehicleID][lightIndex] = units - allocation[vehicleID][lightIndex];
+        if (vehicleID >= numVehicles)
+            numVehicles = vehicleID + 1;
+        return true;
+    }
+
     bool isSafeState()
     {
         int work[4];
-        bool finish[5000] = {false};
+        bool finish[MAX_TRACKED_VEHICLES] = {false};
 
         // Initialize work with available resources
         for (int i = 0; i < numLights; ++i)
@@ -530,107 +701,111 @@ public:
         return true;
     }
 
-    ~SmartTraffix()
-    {
-        for (pid_t pid : processPIDs)
-        {
-            kill(pid, SIGTERM);
-            waitpid(pid, nullptr, 0);
-        }
-    }
-};
+    // Checkpoint support: signal word, phase and priority state, the cycle start and priority
+    // timer, green times (the plan is recompiled from them), light controller inputs, banker's
+    // state and the challan queues
+    void saveState(CheckpointWriter &writer) const
+    {
+        writer.put<int32_t>(lightCount);
+        writer.put<uint32_t>(signalState.load());
+        writer.put<int32_t>(currentPhase);
+        writer.put<int32_t>(currentGreenIndex);
+        writer.put<bool>(car5PriorityActive);
+        writer.put<int32_t>(car5PriorityLightIndex);
+        writer.put<uint32_t>(now);
+        writer.put<uint32_t>(cycleStart);
+        writer.put<uint32_t>(car5PriorityTimer.start);
+        writer.put(greenTimes);
+        writer.put<float>(car5PriorityDuration);
+        writer.putBytes(lastChange, sizeof(lastChange[0]) * lightCount);
+        writer.put<bool>(controllers.hasPending());
+        writer.putBytes(controllers.pendingInputs(), sizeof(LightInput) * lightCount);
+        writer.put(available);
+
+        writer.put<int32_t>(numVehicles);
+        writer.putBytes(maximum, sizeof(maximum[0]) * numVehicles);
+        writer.putBytes(allocation, sizeof(allocation[0]) * numVehicles);
+        writer.putBytes(need, sizeof(need[0]) * numVehicles);
+
+        saveQueue(writer, activeChallans);
+        saveQueue(writer, speedViolations);
+        saveQueue(writer, vehicleCount);
+        writer.put<int32_t>(activeChallanCount);
+    }
+
+    bool loadState(CheckpointReader &reader)
+    {
+        if (reader.get<int32_t>() != lightCount)
+            return false;
+        SignalWord word = reader.get<uint32_t>();
+        currentPhase = reader.get<int32_t>();
+        if (currentPhase < 0 || currentPhase >= lightCount)
+            return false;
+        signalState.publish(word);
+        currentGreenIndex = reader.get<int32_t>();
+        car5PriorityActive = reader.get<bool>();
+        car5PriorityLightIndex = reader.get<int32_t>();
+        now = reader.get<uint32_t>();
+        cycleStart = reader.get<uint32_t>();
+        car5PriorityTimer.start = reader.get<uint32_t>();
+        reader.getBytes(greenTimes, sizeof(greenTimes));
+        car5PriorityDuration = reader.get<float>();
+        plan.compile(greenTimes, lightCount);
+        reader.getBytes(lastChange, sizeof(lastChange[0]) * lightCount);
+        bool pending = reader.get<bool>();
+        LightInput inputs[SCENARIO_MAX_LIGHTS];
+        reader.getBytes(inputs, sizeof(LightInput) * lightCount);
+        if (pending && !reader.fail())
+            controllers.post(inputs); // The decisions the saved run was about to receive
+        reader.getBytes(available, sizeof(available));
+
+        numVehicles = reader.get<int32_t>();
+        if (numVehicles < 0 || numVehicles > MAX_TRACKED_VEHICLES)
+            return false;
+        reader.getBytes(maximum, sizeof(maximum[0]) * numVehicles);
+        reader.getBytes(allocation, sizeof(allocation[0]) * numVehicles);
+        reader.getBytes(need, sizeof(need[0]) * numVehicles);
 
-struct SpeedViolationArgs
-{
-    Car **cars;
-    CarData **carData;
-    int startIndex;
-    int endIndex;
-    ChallanGenerator *challanGenerator;
-    SmartTraffix *trafficAnalytics;
+        loadQueue(reader, activeChallans);
+        loadQueue(reader, speedViolations);
+        loadQueue(reader, vehicleCount);
+        activeChallanCount = reader.get<int32_t>();
+        return !reader.fail();
+    }
 };
 
-void *checkSpeedViolationsThread(void *args)
+// Issues challans for the cars whose speed changed since the last call.
+// Car::setSpeed queues every change on speedChanges, so the work per tick follows the number of speed changes
+// rather than the number of cars, and a challan goes out in the same tick as the offending
+// change. Call it after the tick's speed updates and before updateCars removes exiting cars.
+// Returns the number of challans issued.
+int checkSpeedViolations(SpeedChangeList &speedChanges, ChallanGenerator &challanGenerator, SmartTraffix &trafficAnalytics)
 {
-    SpeedViolationArgs *threadArgs = static_cast<SpeedViolationArgs *>(args);
-
-    for (int i = threadArgs->startIndex; i < threadArgs->endIndex; i++)
+    int issued = 0;
+    for (Car *car : speedChanges.take())
     {
-        if (threadArgs->cars[i] == nullptr || threadArgs->carData[i] == nullptr)
+        CarData *data = car->getData();
+        if (data == nullptr || data->challanStatus)
             continue;
 
-        float speedLimit;
-        switch (threadArgs->cars[i]->getType())
-        {
-        case CAR5:
-            speedLimit = 80.0f;
-            break;
-        case CAR6:
-        case CAR7:
-            speedLimit = 40.0f;
-            break;
-        default:
-            speedLimit = 60.0f;
-        }
-
-        float currentSpeed = threadArgs->cars[i]->getSpeed();
-
-        if (currentSpeed > speedLimit && !threadArgs->carData[i]->challanStatus)
-        {
-            // Generate Challan
-            ChallanRecord challan = threadArgs->challanGenerator->generateChallan(
-                threadArgs->carData[i]->numberPlate,
-                threadArgs->cars[i]->getType(),
-                currentSpeed);
-
-            // Mark car for challan and potential deletion
-            threadArgs->carData[i]->challanStatus = true;
-            threadArgs->carData[i]->markedForDeletion = true;
-
-            // Update Traffic Analytics
-            threadArgs->trafficAnalytics->monitorSpeed(
-                threadArgs->carData[i]->numberPlate,
-                threadArgs->cars[i]->getType(),
-                currentSpeed,
-                threadArgs->carData[i]->laneIndex);
-
-            // Display Analytics
-           // threadArgs->trafficAnalytics->displayAnalytics();
-        }
-    }
-    return nullptr;
-}
-
-void checkSpeedViolationsMultiThreaded(
-    Car *cars[],
-    CarData *carData[],
-    int &carCount,
-    ChallanGenerator &challanGenerator,
-    SmartTraffix &trafficAnalytics)
-{
-    const int NUTHREADS = 4;
-    pthread_t threads[NUTHREADS];
-    SpeedViolationArgs threadArgs[NUTHREADS];
-
-    int carsPerThread = carCount / NUTHREADS;
+        float currentSpeed = car->getSpeed();
+        if (currentSpeed <= traitsOf(car->getType()).speedLimit)
+            continue;
 
-    for (int i = 0; i < NUTHREADS; i++)
-    {
-        threadArgs[i].cars = cars;
-        threadArgs[i].carData = carData;
-        threadArgs[i].startIndex = i * carsPerThread;
-        threadArgs[i].endIndex = (i == NUTHREADS - 1) ? carCount : (i + 1) * carsPerThread;
-        threadArgs[i].challanGenerator = &challanGenerator;
-        threadArgs[i].trafficAnalytics = &trafficAnalytics;
+        // Generate Challan
+        challanGenerator.generateChallan(data->plate, car->getType(), currentSpeed);
 
-        pthread_create(&threads[i], nullptr, checkSpeedViolationsThread, &threadArgs[i]);
-    }
+        // Mark car for challan and potential deletion
+        data->challanStatus = true;
+        data->markedForDeletion = true;
 
-    for (int i = 0; i < NUTHREADS; i++)
-    {
-        pthread_join(threads[i], nullptr);
+        // Update Traffic Analytics
+        trafficAnalytics.monitorSpeed(data->plate, car->getType(), currentSpeed, data->laneIndex);
+        issued++;
     }
+    return issued;
 }
+
 class StripPayment
 {
 private:
@@ -639,47 +814,49 @@ private:
 public:
     StripPayment(ChallanGenerator &generator) : challanGenerator(generator) {}
 
-    static void *processPaymentThread(void *args)
+    // Pays a challan and reports the outcome to out; safe from any thread
+    static bool charge(ChallanGenerator &generator, int challanId, PlateId plate, float amount, ostream &out)
     {
-        auto *paymentArgs = static_cast<tuple<int, string, float, ChallanGenerator *> *>(args);
-        int challanId = get<0>(*paymentArgs);
-        string vehicleNumber = get<1>(*paymentArgs);
-        float amount = get<2>(*paymentArgs);
-        ChallanGenerator *generator = get<3>(*paymentArgs);
-
-        const int MAX_CHALLANS = 10;
-        ChallanRecord challans[MAX_CHALLANS];
-        int resultCount = 0;
-
-        if (generator->findChallansByVehicleNumber(vehicleNumber, challans, resultCount, MAX_CHALLANS))
+        if (plate != NO_PLATE && generator.payChallan(challanId, plate, amount))
         {
-            for (int i = 0; i < resultCount; i++)
-            {
-                if (challans[i].challanId == challanId &&
-                    challans[i].status != PAID &&
-                    challans[i].totalAmount == amount)
-                {
-                    challans[i].status = PAID;
-                    cout << "Payment successful for Challan ID: " << challanId
-                         << " Vehicle: " << vehicleNumber
-                         << " Amount: " << amount << " PKR\n";
-
-                    delete paymentArgs; // Clean up dynamically allocated memory
-                    pthread_exit((void *)1);
-                }
-            }
+            out << "Payment successful for Challan ID: " << challanId
+                << " Vehicle: " << plates().format(plate)
+                << " Amount: " << amount << " PKR\n";
+            return true;
         }
 
-        cout << "Payment failed. Invalid challan details.\n";
-        delete paymentArgs;
-        pthread_exit((void *)0);
+        out << "Payment failed. Invalid challan details.\n";
+        return false;
+    }
+
+    static void *processPaymentThread(void *args)
+    {
+        auto *paymentArgs = static_cast<tuple<int, PlateId, float, ChallanGenerator *> *>(args);
+        bool paid = charge(*get<3>(*paymentArgs), get<0>(*paymentArgs), get<1>(*paymentArgs), get<2>(*paymentArgs), cout);
+        delete paymentArgs; // Clean up dynamically allocated memory
+        pthread_exit((void *)(intptr_t)paid);
+    }
+
+    // Synchronous payment, for callers that need the result
+    bool pay(int challanId, const string &vehicleNumber, float amount, ostream &out)
+    {
+        // A plate the table has never seen cannot have a challan
+        return charge(challanGenerator, challanId, plates().find(vehicleNumber), amount, out);
     }
 
     void processPayment(int challanId, const string &vehicleNumber, float amount)
     {
+        // A plate the table has never seen cannot have a challan
+        PlateId plate = plates().find(vehicleNumber);
+        if (plate == NO_PLATE)
+        {
+            cout << "Payment failed. Invalid challan details.\n";
+            return;
+        }
+
         pthread_t thread;
-        auto *args = new tuple<int, string, float, ChallanGenerator *>(
-            challanId, vehicleNumber, amount, &challanGenerator);
+        auto *args = new tuple<int, PlateId, float, ChallanGenerator *>(
+            challanId, plate, amount, &challanGenerator);
 
         pthread_create(&thread, nullptr, processPaymentThread, args);
         pthread_detach(thread); // Detach the thread for asynchronous execution
@@ -691,59 +868,104 @@ class UserPortal
 private:
     ChallanGenerator &challanGenerator;
     StripPayment stripPayment;
+    const Seqlock<WorldSnapshot> *world; // Published by the simulation, may be nullptr
 
 public:
-    UserPortal(ChallanGenerator &generator) : challanGenerator(generator),
-                                              stripPayment(generator) {}
+    UserPortal(ChallanGenerator &generator, const Seqlock<WorldSnapshot> *world = nullptr)
+        : challanGenerator(generator), stripPayment(generator), world(world) {}
 
-    static void *accessChallanDetailsThread(void *args)
+    // Intersection and challan counters of the last simulated tick; never waits for the simulation
+    void showStatus(int lightCount, ostream &out = cout) const
     {
-        auto *threadArgs = static_cast<tuple<string, time_t, ChallanGenerator *> *>(args);
-        string vehicleNumber = get<0>(*threadArgs);
-        time_t issueDate = get<1>(*threadArgs);
-        ChallanGenerator *generator = get<2>(*threadArgs);
+        if (world == nullptr || world->version() == 0)
+        {
+            out << "No intersection status published yet.\n";
+            return;
+        }
+        printWorldSnapshot(out, world->read(), lightCount);
+    }
+
+    // Revenue, unpaid and overdue totals and repeat offenders of a calendar month
+    void showReport(int year, int month, ostream &out = cout) const
+    {
+        printChallanReport(out, challanGenerator.report(monthQuery(year, month)));
+    }
 
+    // Writes a vehicle's challans to out; returns how many were found
+    static int listChallans(ChallanGenerator &generator, PlateId plate, time_t issueDate, ostream &out)
+    {
+        string vehicleNumber = plates().format(plate);
         const int MAX_CHALLANS = 10;
         ChallanRecord challans[MAX_CHALLANS];
         int resultCount = 0;
 
-        if (generator->findChallansByVehicleNumber(vehicleNumber, challans, resultCount, MAX_CHALLANS))
+        if (plate != NO_PLATE && generator.findChallansByVehicleNumber(plate, challans, resultCount, MAX_CHALLANS))
         {
-            cout << "Challans for Vehicle: " << vehicleNumber << "\n";
+            out << "Challans for Vehicle: " << vehicleNumber << "\n";
             for (int i = 0; i < resultCount; i++)
             {
-                if (issueDate == 0 || challans[i].vehicleNumber == vehicleNumber)
+                if (issueDate == 0 || challans[i].plate == plate)
                 {
-                    cout << "Challan ID: " << challans[i].challanId << "\n";
-                    cout << "Vehicle Number: " << challans[i].vehicleNumber << "\n";
-                    cout << "Payment Status: "
-                         << (challans[i].status == PAID ? "PAID" : (challans[i].status == OVERDUE ? "OVERDUE" : "UNPAID")) << "\n";
-                    cout << "Vehicle Type: " << generator->getCategoryName(challans[i].vehicleCategory) << "\n";
-                    cout << "Amount to Pay: " << challans[i].totalAmount << " PKR\n";
-                    cout << "Issue Date: " << formatDate(challans[i].issueDate) << "\n";
-                    cout << "Due Date: " << formatDate(challans[i].dueDate) << "\n\n";
+                    out << "Challan ID: " << challans[i].challanId << "\n";
+                    out << "Vehicle Number: " << vehicleNumber << "\n";
+                    out << "Payment Status: "
+                        << (challans[i].status == PAID ? "PAID" : (challans[i].status == OVERDUE ? "OVERDUE" : "UNPAID")) << "\n";
+                    out << "Vehicle Type: " << generator.getCategoryName(challans[i].vehicleCategory) << "\n";
+                    out << "Amount to Pay: " << challans[i].totalAmount << " PKR\n";
+                    out << "Issue Date: " << formatDate(challans[i].issueDate) << "\n";
+                    out << "Due Date: " << formatDate(challans[i].dueDate) << "\n\n";
                 }
             }
         }
         else
         {
-            cout << "No challans found for vehicle: " << vehicleNumber << "\n";
+            out << "No challans found for vehicle: " << vehicleNumber << "\n";
         }
+        return resultCount;
+    }
 
+    static void *accessChallanDetailsThread(void *args)
+    {
+        auto *threadArgs = static_cast<tuple<PlateId, time_t, ChallanGenerator *> *>(args);
+        listChallans(*get<2>(*threadArgs), get<0>(*threadArgs), get<1>(*threadArgs), cout);
         delete threadArgs; // Clean up dynamically allocated memory
         pthread_exit(nullptr);
     }
 
+    // Synchronous lookup, for callers that need the result
+    int lookup(const string &vehicleNumber, time_t issueDate, ostream &out)
+    {
+        PlateId plate = plates().find(vehicleNumber);
+        if (plate == NO_PLATE)
+        {
+            out << "No challans found for vehicle: " << vehicleNumber << "\n";
+            return 0;
+        }
+        return listChallans(challanGenerator, plate, issueDate, out);
+    }
+
     void accessChallanDetails(const string &vehicleNumber, time_t issueDate)
     {
+        PlateId plate = plates().find(vehicleNumber);
+        if (plate == NO_PLATE)
+        {
+            cout << "No challans found for vehicle: " << vehicleNumber << "\n";
+            return;
+        }
+
         pthread_t thread;
-        auto *args = new tuple<string, time_t, ChallanGenerator *>(
-            vehicleNumber, issueDate, &challanGenerator);
+        auto *args = new tuple<PlateId, time_t, ChallanGenerator *>(
+            plate, issueDate, &challanGenerator);
 
         pthread_create(&thread, nullptr, accessChallanDetailsThread, args);
         pthread_detach(thread);
     }
 
+    bool pay(int challanId, const string &vehicleNumber, float amount, ostream &out)
+    {
+        return stripPayment.pay(challanId, vehicleNumber, amount, out);
+    }
+
     void payChallan(int challanId, const string &vehicleNumber, float amount)
     {
         stripPayment.processPayment(challanId, vehicleNumber, amount);
@@ -752,7 +974,8 @@ public:
     static string formatDate(time_t timestamp)
     {
         char buffer[80];
-        strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", localtime(&timestamp));
+        tm local;
+        strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", localtime_r(&timestamp, &local));
         return string(buffer);
     }
 };
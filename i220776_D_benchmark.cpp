@@ -0,0 +1,514 @@
+#include <SFML/Window.hpp>
+#include <SFML/Graphics.hpp>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <cmath>
+#include <random>
+#include <ctime>
+#include <chrono>
+#include <functional>
+#include <vector>
+#include <array>
+#include <pthread.h>
+#include "i220776_D_roadtile.h"
+#include "i220776_D_trafficlightgroup.h"
+#include "i220776_D_car.h"
+#include "i220776_D_SmartTraffix.h"
+#include "i220776_D_carBreakDown.h"
+#include "i220776_D_spawnCars.h"
+#include "i220776_D_scenario.h"
+#include "i220776_D_conflicts.h"
+
+// Headless microbenchmarks for the simulation kernels.
+// No RenderWindow is ever created and no texture is loaded, so this runs on machines without a display.
+//
+// Usage: ./benchmark [--max N] [--threads a,b,c] [--filter name] [--min-time seconds] [--csv] [--ledger N]
+
+using namespace std;
+
+struct BenchOptions
+{
+    int maxCount = 1000000;
+    vector<int> threadCounts = {1, 2, 4, 8};
+    string filter;
+    double minSeconds = 0.2;
+    bool csv = false;
+    int ledgerCount = 10000000; // Challans of the month-end ledger ChallanGenerator::report is also run on
+};
+
+struct BenchResult
+{
+    string name;
+    int count;
+    int threads;
+    long iterations;
+    double nsPerCall;
+};
+
+// Sizes swept by every kernel: 1k to 1M vehicles or challans
+const int BENCH_COUNTS[] = {1000, 10000, 100000, 1000000};
+
+// Results of side-effect-free kernels are folded in here so the optimizer cannot drop the call
+volatile long benchSink = 0;
+
+// Output of the kernels under test (challan printouts, breakdown messages) goes here
+class NullBuffer : public streambuf
+{
+protected:
+    int overflow(int c) override { return c; }
+};
+
+// Runs fn repeatedly until at least minSeconds have elapsed and returns the mean time per call.
+// setup (optional) runs before every call and is not timed.
+double measure(const function<void()> &fn, double minSeconds, long &iterations, const function<void()> &setup = nullptr)
+{
+    using clock = chrono::steady_clock;
+
+    if (setup)
+        setup();
+    fn(); // warm-up
+
+    double totalNs = 0;
+    iterations = 0;
+    while (totalNs < minSeconds * 1e9 || iterations < 3)
+    {
+        if (setup)
+            setup();
+        auto start = clock::now();
+        fn();
+        totalNs += chrono::duration<double, nano>(clock::now() - start).count();
+        iterations++;
+    }
+    return totalNs / iterations;
+}
+
+// Layout the kernels run against, the same one the simulator uses without a scenario file
+const ScenarioBlob BENCH_SCENARIO = defaultScenario();
+const float(*const BENCH_SPAWN_POSITIONS)[3] = BENCH_SCENARIO.spawnPositions;
+
+// A population of cars spread along the eight lanes, mimicking a congested intersection
+struct CarPopulation
+{
+    vector<Car *> cars;
+    vector<CarData *> carData;
+
+    CarPopulation(int count, unsigned seed)
+    {
+        mt19937 rng(seed);
+        uniform_real_distribution<float> along(0.0f, 1000.0f);
+
+        cars.resize(count);
+        carData.resize(count);
+        for (int i = 0; i < count; i++)
+        {
+            int lane = i % 8;
+            float x = BENCH_SPAWN_POSITIONS[lane][0];
+            float y = BENCH_SPAWN_POSITIONS[lane][1];
+            float dir = BENCH_SPAWN_POSITIONS[lane][2];
+            if (dir == 0 || dir == 180)
+                y = along(rng);
+            else
+                x = along(rng);
+
+            cars[i] = new Car(static_cast<tVehicleType>(CAR1 + rng() % 7), x, y, dir);
+            cars[i]->setSpeed(10.0f); // Below every speed limit so no challans are issued
+
+            carData[i] = new CarData();
+            carData[i]->plate = cars[i]->generateNumberPlate();
+            carData[i]->laneIndex = lane / 2;
+            carData[i]->isBroken = false;
+            carData[i]->markedForDeletion = false;
+            cars[i]->setData(carData[i]);
+        }
+    }
+
+    ~CarPopulation()
+    {
+        for (size_t i = 0; i < cars.size(); i++)
+        {
+            delete cars[i];
+            delete carData[i];
+        }
+    }
+};
+
+bool selected(const BenchOptions &options, const string &name)
+{
+    return options.filter.empty() || name.find(options.filter) != string::npos;
+}
+
+void report(const BenchOptions &options, vector<BenchResult> &results, const BenchResult &result)
+{
+    results.push_back(result);
+    if (options.csv)
+    {
+        cout << result.name << "," << result.count << "," << result.threads << ","
+             << result.iterations << "," << fixed << setprecision(1) << result.nsPerCall << endl;
+    }
+    else
+    {
+        cout << left << setw(36) << result.name << right
+             << setw(10) << result.count
+             << setw(9) << result.threads
+             << setw(10) << result.iterations
+             << setw(16) << fixed << setprecision(1) << result.nsPerCall
+             << setw(12) << setprecision(2) << result.nsPerCall / result.count << endl;
+    }
+}
+
+void benchVehicleKernels(const BenchOptions &options, vector<BenchResult> &results, streambuf *nullBuffer)
+{
+    for (int count : BENCH_COUNTS)
+    {
+        if (count > options.maxCount)
+            continue;
+
+        CarPopulation population(count, 42);
+        Car **cars = population.cars.data();
+        CarData **carData = population.carData.data();
+        long iterations = 0;
+
+        for (int threads : options.threadCounts)
+        {
+            if (selected(options, "canSpawnCar"))
+            {
+                // Spawn index 0 with a zero distance never blocks, so every car is visited
+                double ns = measure([&]()
+                                    { canSpawnCar(count, cars, BENCH_SPAWN_POSITIONS, 0, 0.0f, threads); },
+                                    options.minSeconds, iterations);
+                report(options, results, {"canSpawnCar", count, threads, iterations, ns});
+            }
+        }
+
+        if (selected(options, "BreakdownScheduler"))
+        {
+            // Scheduling cost per car at spawn, then the per-tick cost of draining due events
+            mt19937 rng(11);
+            SimulationStats stats;
+            int carCount = count;
+            int carsInLane[8] = {};
+            BreakdownScheduler scheduler(rng);
+            unsigned long long tick = 0;
+            double ns = measure([&]()
+                                {
+                                    scheduler.clear();
+                                    for (int i = 0; i < count; i++)
+                                        scheduler.schedule(cars[i], carData[i], tick);
+                                },
+                                options.minSeconds, iterations);
+            report(options, results, {"BreakdownScheduler::schedule(all)", count, 1, iterations, ns});
+
+            // No rescue slots: the scheduler must not grow the population under test
+            streambuf *old = cout.rdbuf(nullBuffer);
+            ns = measure([&]()
+                         { scheduler.processDue(tick++, cars, carData, carCount, count, carsInLane, stats); },
+                         options.minSeconds, iterations);
+            cout.rdbuf(old);
+            report(options, results, {"BreakdownScheduler::processDue", count, 1, iterations, ns});
+
+            for (int i = 0; i < count; i++)
+            {
+                carData[i]->isBroken = false;
+                carData[i]->hasSpawnedRescueVehicle = false;
+                cars[i]->setBreakdownState(false);
+            }
+        }
+
+        if (selected(options, "checkSpeedViolations") || selected(options, "updateCars"))
+        {
+            // Lights 0 and 3 green, 1 and 2 red, so both stopped and moving cars are timed
+            const SignalWord signals = 1u << 1 | 1u << 2;
+            SmartTraffix trafficController(4);
+            ChallanGenerator challanGenerator;
+
+            if (selected(options, "checkSpeedViolations"))
+            {
+                // Worst case tick: every car changed speed (staying under its limit, so no challans)
+                float nextSpeed = 10.0f;
+                SpeedChangeList speedChanges;
+                double ns = measure([&]()
+                                    { benchSink = benchSink + checkSpeedViolations(speedChanges, challanGenerator, trafficController); },
+                                    options.minSeconds, iterations,
+                                    [&]()
+                                    {
+                                        nextSpeed = nextSpeed == 10.0f ? 11.0f : 10.0f;
+                                        for (int i = 0; i < count; i++)
+                                            cars[i]->setSpeed(nextSpeed, &speedChanges);
+                                    });
+                report(options, results, {"checkSpeedViolations", count, 1, iterations, ns});
+            }
+
+            if (selected(options, "updateCars"))
+            {
+                // updateCars moves the cars and compacts the arrays in place, so every call starts from
+                // the same positions, arrays and lane counts
+                vector<Car *> working(population.cars);
+                vector<CarData *> workingData(population.carData);
+                vector<array<float, 3>> placement(count);
+                for (int i = 0; i < count; i++)
+                    placement[i] = {population.cars[i]->getX(), population.cars[i]->getY(), population.cars[i]->getDir()};
+                int carsInLane[8] = {};
+                int carCount = count;
+                auto restore = [&]()
+                {
+                    for (int i = 0; i < count; i++)
+                        population.cars[i]->setPosition(placement[i][0], placement[i][1], placement[i][2]);
+                    working = population.cars;
+                    workingData = population.carData;
+                    fill(carsInLane, carsInLane + 8, 0);
+                    carCount = count;
+                };
+                double ns = measure([&]()
+                                    { updateCars(nullptr, working.data(), workingData.data(), signals, carCount, carsInLane, BENCH_SCENARIO); },
+                                    options.minSeconds, iterations, restore);
+                restore();
+                report(options, results, {"updateCars", count, 1, iterations, ns});
+            }
+        }
+    }
+}
+
+void benchSafeState(const BenchOptions &options, vector<BenchResult> &results)
+{
+    if (!selected(options, "SmartTraffix::isSafeState"))
+        return;
+
+    for (int count : BENCH_COUNTS)
+    {
+        if (count > options.maxCount)
+            continue;
+
+        // The banker's matrices hold at most MAX_TRACKED_VEHICLES rows
+        int tracked = min(count, MAX_TRACKED_VEHICLES);
+
+        SmartTraffix trafficController(4);
+        for (int v = 0; v < tracked; v++)
+        {
+            trafficController.registerVehicleDemand(v, v % 4, 1);
+        }
+
+        long iterations = 0;
+        double ns = measure([&]()
+                            { benchSink = benchSink + trafficController.isSafeState(); },
+                            options.minSeconds, iterations);
+        report(options, results, {"SmartTraffix::isSafeState", tracked, 1, iterations, ns});
+
+        if (tracked < count)
+            break;
+    }
+}
+
+void benchChallans(const BenchOptions &options, vector<BenchResult> &results, streambuf *nullBuffer)
+{
+    for (int count : BENCH_COUNTS)
+    {
+        if (count > options.maxCount)
+            continue;
+
+        // Every other challan repeats a plate, roughly two challans per offender
+        vector<PlateId> offenders(count);
+        for (int i = 0; i < count; i++)
+        {
+            stringstream ss;
+            ss << "ABC-" << (1000 + i / 2);
+            offenders[i] = plates().intern(ss.str());
+        }
+
+        ChallanGenerator challanGenerator;
+        streambuf *old = cout.rdbuf(nullBuffer);
+
+        auto start = chrono::steady_clock::now();
+        for (int i = 0; i < count; i++)
+        {
+            challanGenerator.generateChallan(offenders[i], static_cast<tVehicleType>(CAR1 + i % 4), 70.0f);
+        }
+        double totalNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+
+        cout.rdbuf(old);
+
+        // Reported per call, so the count column is the ledger size reached
+        if (selected(options, "ChallanGenerator::generateChallan"))
+            report(options, results, {"ChallanGenerator::generateChallan", count, 1, count, totalNs / count});
+
+        if (selected(options, "findChallansByVehicleNumber"))
+        {
+            mt19937 rng(7);
+            const int MAX_CHALLANS = 10;
+            ChallanRecord found[MAX_CHALLANS];
+            int resultCount = 0;
+            long iterations = 0;
+            double ns = measure([&]()
+                                {
+                                    challanGenerator.findChallansByVehicleNumber(offenders[rng() % count], found, resultCount, MAX_CHALLANS);
+                                    benchSink = benchSink + resultCount; },
+                                options.minSeconds, iterations);
+            report(options, results, {"findChallansByVehicleNumber", count, 1, iterations, ns});
+        }
+    }
+}
+
+// A month-end ledger: three months of challans on count / 3 plates, reported for the middle month
+void benchChallanReport(const BenchOptions &options, vector<BenchResult> &results)
+{
+    if (!selected(options, "ChallanGenerator::report"))
+        return;
+
+    vector<int> counts;
+    for (int count : BENCH_COUNTS)
+    {
+        if (count <= options.maxCount && count < options.ledgerCount)
+            counts.push_back(count);
+    }
+    counts.push_back(options.ledgerCount);
+
+    const time_t start = 1767225600; // 2026-01-01 UTC
+    const int DAY = 24 * 60 * 60;
+    for (int count : counts)
+    {
+        mt19937 rng(13);
+        int plateCount = count / 3 + 1;
+        vector<PlateId> offenders(plateCount);
+        for (int i = 0; i < plateCount; i++)
+            offenders[i] = plates().intern("RPT-" + to_string(i));
+
+        ChallanGenerator challanGenerator;
+        for (int i = 0; i < count; i++)
+        {
+            const VehicleTraits &traits = traitsOf(static_cast<tVehicleType>(CAR1 + rng() % 7));
+            ChallanRecord challan;
+            challan.challanId = i + 1;
+            challan.plate = offenders[rng() % plateCount];
+            challan.vehicleCategory = traits.category;
+            challan.baseAmount = traits.fine;
+            challan.totalAmount = traits.fine * 1.17f;
+            challan.issueDate = start + (time_t)i * 90 * DAY / count;
+            challan.dueDate = challan.issueDate + 3 * DAY;
+            challan.status = rng() % 3 ? UNPAID : PAID;
+            challanGenerator.append(challan);
+        }
+        ChallanReportQuery query = {start + 31 * DAY, start + 59 * DAY, start + 62 * DAY, 2};
+
+        for (int threads : options.threadCounts)
+        {
+            long iterations = 0;
+            double ns = measure([&]()
+                                { benchSink = benchSink + challanGenerator.report(query, threads).repeatOffenders; },
+                                options.minSeconds, iterations);
+            report(options, results, {"ChallanGenerator::report", count, threads, iterations, ns});
+        }
+    }
+}
+
+// Vehicles on a jittered grid, one per 60x60 px cell of a square box, all moving along their
+// heading between calls so the incremental sort has work to do
+void benchConflicts(const BenchOptions &options, vector<BenchResult> &results)
+{
+    if (!selected(options, "ConflictDetector::observe"))
+        return;
+
+    for (int count : BENCH_COUNTS)
+    {
+        if (count > options.maxCount)
+            continue;
+
+        int side = (int)ceil(sqrt((double)count));
+        float cell = 60.0f;
+        ConflictDetector detector({sf::FloatRect(0, 0, side * cell, side * cell)});
+
+        mt19937 rng(11);
+        uniform_real_distribution<float> jitter(0.0f, cell);
+        const float DIRS[] = {0, 90, 180, 270};
+        TrajectoryFrame frame = {};
+        frame.vehicles.resize(count);
+        for (int i = 0; i < count; i++)
+        {
+            VehicleSample &vehicle = frame.vehicles[i];
+            vehicle.id = i;
+            vehicle.type = CAR1 + rng() % 7;
+            vehicle.x = (i % side) * cell + jitter(rng);
+            vehicle.y = (i / side) * cell + jitter(rng);
+            vehicle.dir = DIRS[rng() % 4];
+            vehicle.speed = 2.0f;
+        }
+        detector.observe(frame); // First sort
+
+        long iterations = 0;
+        double ns = measure([&]()
+                            { benchSink = benchSink + detector.observe(frame).size(); },
+                            options.minSeconds, iterations,
+                            [&]()
+                            {
+                                frame.tick++;
+                                for (VehicleSample &vehicle : frame.vehicles)
+                                {
+                                    float step = (frame.tick / 40) % 2 ? -vehicle.speed : vehicle.speed; // Back and forth
+                                    if (vehicle.dir == 0 || vehicle.dir == 180)
+                                        vehicle.y += vehicle.dir == 0 ? step : -step;
+                                    else
+                                        vehicle.x += vehicle.dir == 90 ? step : -step;
+                                }
+                            });
+        report(options, results, {"ConflictDetector::observe", count, 1, iterations, ns});
+    }
+}
+
+vector<int> parseList(const string &text)
+{
+    vector<int> values;
+    stringstream ss(text);
+    string item;
+    while (getline(ss, item, ','))
+    {
+        if (!item.empty())
+            values.push_back(atoi(item.c_str()));
+    }
+    return values;
+}
+
+int main(int argc, char *argv[])
+{
+    BenchOptions options;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--max" && i + 1 < argc)
+            options.maxCount = atoi(argv[++i]);
+        else if (arg == "--threads" && i + 1 < argc)
+            options.threadCounts = parseList(argv[++i]);
+        else if (arg == "--filter" && i + 1 < argc)
+            options.filter = argv[++i];
+        else if (arg == "--min-time" && i + 1 < argc)
+            options.minSeconds = atof(argv[++i]);
+        else if (arg == "--csv")
+            options.csv = true;
+        else if (arg == "--ledger" && i + 1 < argc)
+            options.ledgerCount = atoi(argv[++i]);
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [--max N] [--threads a,b,c] [--filter name] [--min-time seconds] [--csv] [--ledger N]\n";
+            return 1;
+        }
+    }
+
+    NullBuffer nullBuffer;
+    vector<BenchResult> results;
+
+    if (options.csv)
+        cout << "kernel,count,threads,iterations,ns_per_call" << endl;
+    else
+        cout << left << setw(36) << "kernel" << right
+             << setw(10) << "count"
+             << setw(9) << "threads"
+             << setw(10) << "iters"
+             << setw(16) << "ns/call"
+             << setw(12) << "ns/item" << endl;
+
+    benchVehicleKernels(options, results, &nullBuffer);
+    benchSafeState(options, results);
+    benchChallans(options, results, &nullBuffer);
+    benchChallanReport(options, results);
+    benchConflicts(options, results);
+
+    return 0;
+}
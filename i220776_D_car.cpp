@@ -1,42 +1,89 @@
 #include "i220776_D_car.h"
+#include "i220776_D_routes.h"
 #include <iostream>
+#include <atomic>
+
+static atomic<unsigned> nextCarId(1);
 
 // Constructor definition
-Car::Car(tVehicleType type, float x, float y, float dir) : Vehicle(x, y, dir), vehicleType(type)
+Car::Car(tVehicleType type, float x, float y, float dir) : Vehicle(x, y, dir), id(nextCarId++), vehicleType(type), isBroken(false), data(nullptr), speedChanges(nullptr), speedChangeSlot(-1), route(nullptr), routeProgress(0), routeSegment(0), heldTicks(0)
 {
-    string texturePath;
-    switch (type)
-    {
-    case CAR1:
-        texturePath = "images/vehicles/car6.png";
-        break;
-    case CAR2:
-        texturePath = "images/vehicles/car2.png";
-        break;
-    case CAR3:
-        texturePath = "images/vehicles/car3.png";
-        break;
-    case CAR4:
-        texturePath = "images/vehicles/car4.png";
-        break;
-    case CAR5:
-        texturePath = "images/vehicles/ambulance.png";
-        break;
-    case CAR6:
-        texturePath = "images/vehicles/bus.png";
-        break;
-    case CAR7:
-        texturePath = "images/vehicles/car7.png";
-        break;
-    }
+    sprite.setPosition(x, y);
+}
+
+Car::~Car()
+{
+    // Never leave a dangling pointer in the speed change queue
+    if (speedChanges != nullptr)
+        speedChanges->remove(this);
+}
+
+SpeedChangeList::~SpeedChangeList()
+{
+    for (Car *car : queued)
+        car->speedChanges = nullptr;
+}
+
+void SpeedChangeList::add(Car *car)
+{
+    if (car->speedChanges != nullptr)
+        return;
+    car->speedChanges = this;
+    car->speedChangeSlot = queued.size();
+    queued.push_back(car);
+}
+
+void SpeedChangeList::remove(Car *car)
+{
+    Car *last = queued.back();
+    queued[car->speedChangeSlot] = last;
+    last->speedChangeSlot = car->speedChangeSlot;
+    queued.pop_back();
+    car->speedChanges = nullptr;
+}
+
+const vector<Car *> &SpeedChangeList::take()
+{
+    taken.clear();
+    taken.swap(queued);
+    for (Car *car : taken)
+        car->speedChanges = nullptr;
+    return taken;
+}
+
+const sf::Texture &Car::textureFor(tVehicleType type)
+{
+    static sf::Texture textures[VEHICLE_TYPE_COUNT];
+    static bool loaded[VEHICLE_TYPE_COUNT] = {false};
 
-    if (!texture.loadFromFile(texturePath))
+    if (!loaded[type])
     {
-        cerr << "Error: Failed to load texture for " << texturePath << "\n";
+        string texturePath = imagePathFor(type);
+        if (!textures[type].loadFromFile(texturePath))
+        {
+            cerr << "Error: Failed to load texture for " << texturePath << "\n";
+        }
+        loaded[type] = true;
     }
-    sprite.setTexture(texture);
-    sprite.setOrigin(sprite.getGlobalBounds().width / 6, sprite.getGlobalBounds().height / 6);
-    sprite.setPosition(x, y);
+    return textures[type];
+}
+
+const char *Car::imagePathFor(tVehicleType type)
+{
+    return traitsOf(type).imagePath;
+}
+
+float Car::spriteRotationFor(float dir)
+{
+    if (dir == 90)
+        return dir * 4;
+    else if (dir == 270)
+        return dir * 2;
+    else if (dir == 180)
+        return 270;
+    else if (dir == 0)
+        return 90;
+    return 0;
 }
 
 void Car::move2()
@@ -61,20 +108,64 @@ void Car::move2()
     }
 
     // Update the sprite position after movement
-    sprite.setPosition(x, y);
+    updateSprite();
+}
 
-    if (dir == 90)
-        sprite.setRotation(dir * 4);
-    else if (dir == 270)
-        sprite.setRotation(dir * 2);
-    else if (dir == 180)
-        sprite.setRotation(270);
-    else if (dir == 0)
-        sprite.setRotation(90);
+void Car::setRoute(const Route *newRoute, float progress)
+{
+    route = newRoute;
+    routeProgress = progress;
+    routeSegment = 0;
+    if (route != nullptr)
+        placeOnRoute();
+}
+
+void Car::followRoute()
+{
+    routeProgress = min(routeProgress + speed * 0.05f, route->length());
+    placeOnRoute();
+}
+
+void Car::placeOnRoute()
+{
+    // Progress only grows, so the segment index only moves forward
+    while (routeSegment + 1 < (int)route->headings.size() && route->distances[routeSegment + 1] <= routeProgress)
+        routeSegment++;
+
+    float along = routeProgress - route->distances[routeSegment];
+    float segmentLength = route->distances[routeSegment + 1] - route->distances[routeSegment];
+    sf::Vector2f from = route->points[routeSegment];
+    sf::Vector2f to = route->points[routeSegment + 1];
+    float t = segmentLength > 0 ? min(1.0f, along / segmentLength) : 1.0f;
+    setPosition(from.x + (to.x - from.x) * t, from.y + (to.y - from.y) * t, route->headings[routeSegment]);
+}
+
+bool Car::hasFinishedRoute() const
+{
+    return route != nullptr && routeProgress >= route->length();
+}
+
+void Car::setPosition(float newX, float newY, float newDir)
+{
+    x = newX;
+    y = newY;
+    dir = newDir;
+    updateSprite();
+}
+
+void Car::updateSprite()
+{
+    sprite.setPosition(x, y);
+    sprite.setRotation(spriteRotationFor(dir));
 }
 
 // draw method definition
 void Car::draw(sf::RenderWindow *window)
 {
+    if (sprite.getTexture() == nullptr)
+    {
+        sprite.setTexture(textureFor(vehicleType));
+        sprite.setOrigin(sprite.getLocalBounds().width / 6, sprite.getLocalBounds().height / 6);
+    }
     window->draw(sprite);
 }
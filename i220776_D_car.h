@@ -13,12 +13,19 @@
 #include <sys/time.h>
 #include "i220776_D_roadtile.h"
 #include "i220776_D_trafficlightgroup.h"
+#include "i220776_D_vehicleTraits.h"
+#include "i220776_D_plates.h"
+#include "i220776_D_simTick.h"
+#include "i220776_D_signalPlan.h"
+#include "i220776_D_memoryAccounting.h"
 
 // Add breakdown probability constants
 const float BREAKDOWN_BASE_PROBABILITY = 0.001f; // Base probability per update
 const float MINIMUBREAKDOWNS = 1;                // Minimum number of breakdowns per simulation
 // Conversion factor from km/h to pixels per move (assuming 1 pixel = 1 meter)
 const float KMH_TO_PIXELS = 2.0;
+// Vehicle slots of a simulation; recordings and checkpoints never hold more
+const int MAX_SIMULATION_CARS = 50000;
 // C
 using namespace std;
 using namespace sf;
@@ -27,76 +34,139 @@ using namespace sf;
 struct LaneConfig
 {
     float currentSpeed; // Current speed for all cars in this lane
-    Clock speedClock;   // Timer for speed updates
     float spawnInterval;
     float car5Probability;
     float car5Interval;
+    float car6Interval; // Seconds between CAR6 convoys, INFINITY when heavy vehicles are kept out
 };
 
 // Car data structure
 struct CarData
 {
-    string numberPlate;
+    PlateId plate; // Format with plates().format() only for display
     float speed; // in km/h
     bool challanStatus = false;
     int laneIndex; // Track which lane the car is in
-    Clock speedUpdateClock;
     bool isBroken; // New field for breakdown status
     Vector2f breakdownPosition;
     bool hasSpawnedRescueVehicle = false; // New flag to track rescue vehicle spawn
     bool markedForDeletion;
 
-    bool canMove(const TrafficLight *trafficLights)
+    bool canMove(SignalWord signals) const
     {
+        return signalLight(signals, laneIndex) == GREEN;
+    }
 
-        return trafficLights[laneIndex].getState() == GREEN;
+    // Charged to vehicles wherever it is created
+    static void *operator new(size_t size)
+    {
+        MemoryScope scope(MEMORY_VEHICLES);
+        return ::operator new(size);
     }
 };
 
-// Remove duplicate enum and keep only one
-enum tVehicleType
+struct Route; // i220776_D_routes.h
+class Car;
+
+// The cars whose speed changed since the last take(), each listed once. Owned by whoever runs
+// the cars (Simulation), so two runs in one process never see each other's changes.
+class SpeedChangeList
 {
-    CAR1,
-    CAR2,
-    CAR3,
-    CAR4,
-    CAR5,
-    CAR6,
-    CAR7
+    vector<Car *> queued;
+    vector<Car *> taken; // Keeps its capacity between ticks
+
+public:
+    SpeedChangeList() {}
+    SpeedChangeList(const SpeedChangeList &) = delete;
+    SpeedChangeList &operator=(const SpeedChangeList &) = delete;
+    ~SpeedChangeList();
+
+    // Does nothing for a car already queued
+    void add(Car *car);
+    void remove(Car *car);
+    // Empties the list and returns what it held, valid until the next take()
+    const vector<Car *> &take();
 };
 
+// Car is the only kind of vehicle, so nothing here is virtual: drawing and moving a car never
+// go through a vtable
 class Vehicle
 {
 protected:
     float x, y, dir;
     float speed;
-    sf::Texture texture;
-    sf::Sprite sprite;
+    sf::Sprite sprite; // Texture is bound lazily on first draw, see Car::textureFor
 
 public:
     Vehicle() : x(0), y(0), dir(0), speed(1.0f) {}
     Vehicle(float x, float y, float dir) : x(x), y(y), dir(dir), speed(1.0f) {}
-    virtual void draw(sf::RenderWindow *window) = 0;
-    virtual ~Vehicle() {}
 };
 
-class Car : public Vehicle
+class Car final : public Vehicle
 {
 private:
+    unsigned id; // Unique per car, used to follow a vehicle across recorded frames
     tVehicleType vehicleType;
     bool isBroken;
     sf::Color originalColor;
     bool challanStatus = false;
+    CarData *data;           // Record in the parallel carData array, set by whoever creates the pair
+    SpeedChangeList *speedChanges; // List the car is queued in, nullptr when not queued
+    int speedChangeSlot;           // Position in speedChanges
+    const Route *route;      // Path through the intersection, nullptr for cars driven by move2
+    float routeProgress;     // Pixels travelled along route
+    int routeSegment;        // Segment of route containing routeProgress
+    unsigned heldTicks;      // Ticks spent waiting at a red light on the route
+
+    friend class SpeedChangeList;
+
+    void updateSprite();
+    void placeOnRoute();
 
 public:
     Car(tVehicleType type, float x, float y, float dir);
+    ~Car();
+    // Charged to vehicles wherever it is created
+    static void *operator new(size_t size)
+    {
+        MemoryScope scope(MEMORY_VEHICLES);
+        return ::operator new(size);
+    }
     void move2();
-    void draw(sf::RenderWindow *window) override;
-    void setSpeed(float newSpeed) { speed = newSpeed; }
+    // Puts the car on a route at the given distance along it
+    void setRoute(const Route *newRoute, float progress = 0.0f);
+    const Route *getRoute() const { return route; }
+    float getRouteProgress() const { return routeProgress; }
+    // Advances along the route by the same distance move2 covers in a tick
+    void followRoute();
+    bool hasFinishedRoute() const;
+    // Counts a tick the car had to wait for its light
+    void holdOnRoute() { heldTicks++; }
+    unsigned getHeldTicks() const { return heldTicks; }
+    // Places the car directly, used when replaying a recorded run
+    void setPosition(float newX, float newY, float newDir);
+    void draw(sf::RenderWindow *window);
+    // Shared texture per vehicle type, loaded on first use so headless runs never create a GL context
+    static const sf::Texture &textureFor(tVehicleType type);
+    static const char *imagePathFor(tVehicleType type);
+    // Sprite rotation for a heading; the origin is a sixth of the image size, see draw()
+    static float spriteRotationFor(float dir);
+    // A change is queued on changes, when given, so speed violations are only checked for cars whose speed moved
+    void setSpeed(float newSpeed, SpeedChangeList *changes = nullptr)
+    {
+        if (newSpeed == speed)
+            return;
+        speed = newSpeed;
+        if (changes != nullptr)
+            changes->add(this);
+    }
+    void setData(CarData *carData) { data = carData; }
+    CarData *getData() const { return data; }
     float getX() const { return x; }
     float getY() const { return y; }
     float getDir() const { return dir; }
     tVehicleType getType() const { return vehicleType; } // Inline definition
+    unsigned getId() const { return id; }
     float getSpeed() const { return speed; }
     void setBreakdownState(bool broken)
     {
@@ -129,19 +199,9 @@ public:
     {
         return challanStatus;
     }
-    // Generate random number plate
-    string generateNumberPlate()
-    {
-        static int plateNumber = 1000;
-        stringstream ss;
-        ss << "ABC-" << plateNumber++;
-        return ss.str();
-    }
-
-    // Add this function to check if a lane is valid for CAR6
-    bool isValidCar6Lane(int laneIndex)
+    // Next plate of the series, safe to call from any thread
+    PlateId generateNumberPlate()
     {
-        // Only allow CAR6 in even-numbered lanes (lane2, lane4, lane6, lane8)
-        return laneIndex % 2 == 1; // Index is 0-based, so odd index = even lane number
+        return plates().generate();
     }
 };
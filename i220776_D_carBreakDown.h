@@ -1,3 +1,4 @@
+#pragma once
 #include <SFML/Window.hpp>
 #include <SFML/Graphics.hpp>
 #include <iostream>
@@ -6,6 +7,8 @@
 #include <ctime>
 #include <pthread.h>
 #include <queue>
+#include <vector>
+#include <unordered_map>
 #include "i220776_D_roadtile.h"
 #include "i220776_D_trafficlightgroup.h"
 #include "i220776_D_car.h"
@@ -18,151 +21,177 @@
 struct SimulationStats
 {
     int totalBreakdowns;
-    Clock simulationTimer;
     bool hasStarted;
 
     SimulationStats() : totalBreakdowns(0), hasStarted(false) {}
 };
 
-// Thread argument structure for breakdown check
-struct BreakdownCheckArgs
-{
-    Car **cars;
-    CarData **carData;
-    SimulationStats *stats;
-    int startIndex;
-    int endIndex;
-    mt19937 *gen; // Pass random generator by pointer
-    uniform_real_distribution<> *dis;
-};
+// Chance that a running car breaks down during one simulation tick
+const double BREAKDOWN_PROBABILITY_PER_TICK = 0.00001;
 
-// Thread function for breakdown check
-void *checkBreakdownsThread(void *args)
+// Spawns a CAR7 rescue vehicle behind a broken-down car, on the same route when it has one.
+// Returns false when the car array is full.
+bool spawnRescueVehicle(Car *brokenCar, CarData *brokenData, Car *cars[], CarData *carData[], int &carCount, int maxCars, int *carsInLane)
 {
-    BreakdownCheckArgs *threadArgs = static_cast<BreakdownCheckArgs *>(args);
+    // Spawn rescue vehicle behind the broken car
+    float spawnX = brokenData->breakdownPosition.x;
+    float spawnY = brokenData->breakdownPosition.y;
+    float direction = brokenCar->getDir();
 
-    for (int i = threadArgs->startIndex; i < threadArgs->endIndex; i++)
+    // Adjust spawn position based on car's direction
+    switch (static_cast<int>(direction))
     {
-        if (threadArgs->cars[i] != nullptr &&
-            threadArgs->carData[i] != nullptr &&
-            !threadArgs->carData[i]->isBroken)
-        {
-
-            float currentBreakdownProb = 0.00001f;
-
-            // Ensure at least minimum breakdowns
-            if (threadArgs->stats->totalBreakdowns < 1)
-            {
-                currentBreakdownProb = max(currentBreakdownProb, 0.000005f);
-            }
-
-            // Probabilistic breakdown (use thread-safe random generation)
-            if ((*threadArgs->dis)(*threadArgs->gen) < currentBreakdownProb)
-            {
-                threadArgs->carData[i]->isBroken = true;
-                threadArgs->carData[i]->breakdownPosition = Vector2f(
-                    threadArgs->cars[i]->getX(),
-                    threadArgs->cars[i]->getY());
-
-                // Atomic increment for thread safety
-                __sync_fetch_and_add(&threadArgs->stats->totalBreakdowns, 1);
-
-                cout << "Car " << threadArgs->carData[i]->numberPlate
-                     << " broke down at (" << threadArgs->carData[i]->breakdownPosition.x
-                     << ", " << threadArgs->carData[i]->breakdownPosition.y << ")" << endl;
-
-                threadArgs->cars[i]->setBreakdownState(true);
-            }
-        }
+    case 0: // South-moving
+        spawnY += 50;
+        break;
+    case 90: // East-moving
+        spawnX += 50;
+        break;
+    case 180: // West-moving
+        spawnY -= 50;
+        break;
+    case 270: // North-moving
+        spawnX -= 50;
+        break;
     }
 
-    return nullptr;
+    // Check if we have space to spawn a new vehicle
+    if (carCount >= maxCars)
+        return false;
+
+    cars[carCount] = new Car(CAR7, spawnX, spawnY, direction);
+    // Follows the broken car's route from 50 px back, so it leaves the map (and its lane) with the
+    // route instead of depending on an exit rule matching its coordinates
+    if (brokenCar->getRoute() != nullptr)
+        cars[carCount]->setRoute(brokenCar->getRoute(), max(0.0f, brokenCar->getRouteProgress() - 50));
+
+    // Initialize car data for the new CAR7 (rescue vehicle)
+    carData[carCount] = new CarData();
+    cars[carCount]->setData(carData[carCount]);
+    carData[carCount]->plate = cars[carCount]->generateNumberPlate();
+    carData[carCount]->laneIndex = brokenData->laneIndex;
+    carData[carCount]->challanStatus = false;
+    carData[carCount]->isBroken = false;
+
+    // Set the speed of the rescue vehicle to match the broken-down car
+    cars[carCount]->setSpeed(brokenCar->getSpeed());
+
+    carCount++;
+    carsInLane[brokenData->laneIndex]++;
+
+    // Mark that a rescue vehicle has been spawned for this broken down car
+    brokenData->hasSpawnedRescueVehicle = true;
+    return true;
 }
 
-// Threaded breakdown check function
-void checkBreakdownsMultiThreaded(Car *cars[], CarData *carData[], int carCount, SimulationStats &stats)
+// Event-driven breakdowns.
+// Instead of rolling a die for every car on every tick, each car's breakdown tick is drawn
+// once from the equivalent exponential distribution when it enters the simulation, and kept
+// in a min-heap. Each tick only the events that are due are handled, so the cost is
+// O(breakdowns) per tick rather than O(vehicles). Because the distribution is memoryless,
+// re-drawing the schedule (e.g. after restoring a checkpoint) does not change the statistics.
+class BreakdownScheduler
 {
-    const int NUM_THREADS = 4;
-    pthread_t threads[NUM_THREADS];
-    BreakdownCheckArgs threadArgs[NUM_THREADS];
-
-    random_device rd;
-    mt19937 gen(rd());
-    uniform_real_distribution<> dis(0, 1);
-
-    int carsPerThread = carCount / NUM_THREADS;
-
-    for (int i = 0; i < NUM_THREADS; i++)
+    struct BreakdownEvent
     {
-        threadArgs[i].cars = cars;
-        threadArgs[i].carData = carData;
-        threadArgs[i].stats = &stats;
-        threadArgs[i].startIndex = i * carsPerThread;
-        threadArgs[i].endIndex = (i == NUM_THREADS - 1) ? carCount : (i + 1) * carsPerThread;
-        threadArgs[i].gen = &gen;
-        threadArgs[i].dis = &dis;
-
-        pthread_create(&threads[i], nullptr, checkBreakdownsThread, &threadArgs[i]);
-    }
+        unsigned long long tick;
+        unsigned carId;
+        Car *car;
+        CarData *data;
+    };
 
-    // Wait for all threads to complete
-    for (int i = 0; i < NUM_THREADS; i++)
+    struct LaterFirst
     {
-        pthread_join(threads[i], nullptr);
+        bool operator()(const BreakdownEvent &a, const BreakdownEvent &b) const { return a.tick > b.tick; }
+    };
+
+    priority_queue<BreakdownEvent, vector<BreakdownEvent>, LaterFirst> events;
+    unordered_map<unsigned, unsigned long long> pending; // Car id -> scheduled tick; cancelled cars are absent
+    vector<pair<Car *, CarData *>> awaitingRescue;     // Broken cars whose rescue did not fit yet
+    mt19937 &rng;
+    exponential_distribution<double> ticksUntilBreakdown;
+
+public:
+    // rng is shared with the rest of the simulation so checkpoints capture it
+    BreakdownScheduler(mt19937 &rng, double probabilityPerTick = BREAKDOWN_PROBABILITY_PER_TICK)
+        : rng(rng), ticksUntilBreakdown(-log1p(-probabilityPerTick)) {}
+
+    // Draws the breakdown tick for a car that just entered the simulation
+    void schedule(Car *car, CarData *data, unsigned long long now)
+    {
+        if (data->isBroken)
+            return;
+
+        unsigned long long tick = now + (unsigned long long)ceil(ticksUntilBreakdown(rng));
+        events.push({tick, car->getId(), car, data});
+        pending[car->getId()] = tick;
     }
-}
 
-void spawnRescueVehiclesForBrokenDownCars(Car *cars[], CarData *carData[], int &carCount, int maxCars, int *carsInLane)
-{
-    for (int i = 0; i < carCount; i++)
+    // The car left the simulation; its event is dropped when it surfaces
+    void cancel(Car *car)
     {
-        if (carData[i]->isBroken && !carData[i]->hasSpawnedRescueVehicle)
+        pending.erase(car->getId());
+        for (size_t i = 0; i < awaitingRescue.size(); i++)
         {
-            // Spawn rescue vehicle behind the broken car
-            float spawnX = carData[i]->breakdownPosition.x;
-            float spawnY = carData[i]->breakdownPosition.y;
-            float direction = cars[i]->getDir();
-
-            // Adjust spawn position based on car's direction
-            switch (static_cast<int>(direction))
+            if (awaitingRescue[i].first == car)
             {
-            case 0: // South-moving
-                spawnY += 50;
-                break;
-            case 90: // East-moving
-                spawnX += 50;
-                break;
-            case 180: // West-moving
-                spawnY -= 50;
-                break;
-            case 270: // North-moving
-                spawnX -= 50;
+                awaitingRescue.erase(awaitingRescue.begin() + i);
                 break;
             }
+        }
+    }
 
-            // Check if we have space to spawn a new vehicle
-            if (carCount < maxCars)
-            {
-                cars[carCount] = new Car(CAR7, spawnX, spawnY, direction);
-
-                // Initialize car data for the new CAR7 (rescue vehicle)
-                carData[carCount] = new CarData();
-                carData[carCount]->numberPlate = cars[carCount]->generateNumberPlate();
-                carData[carCount]->laneIndex = carData[i]->laneIndex;
-                carData[carCount]->challanStatus = false;
-                carData[carCount]->isBroken = false;
-                carData[carCount]->speedUpdateClock.restart();
-
-                // Set the speed of the rescue vehicle to match the broken-down car
-                float currentSpeed = cars[i]->getSpeed();
-                cars[carCount]->setSpeed(currentSpeed);
+    void clear()
+    {
+        events = decltype(events)();
+        pending.clear();
+        awaitingRescue.clear();
+    }
 
-                carCount++;
-                carsInLane[carData[i]->laneIndex]++;
+    size_t pendingCount() const { return pending.size(); }
 
-                // Mark that a rescue vehicle has been spawned for this broken down car
-                carData[i]->hasSpawnedRescueVehicle = true;
+    // Breaks down every car whose tick has come and spawns its rescue vehicle.
+    // Returns the number of breakdowns handled this tick.
+    int processDue(unsigned long long now, Car *cars[], CarData *carData[], int &carCount, int maxCars, int *carsInLane, SimulationStats &stats)
+    {
+        // Rescues that did not fit last time get another chance first
+        for (size_t i = 0; i < awaitingRescue.size();)
+        {
+            if (spawnRescueVehicle(awaitingRescue[i].first, awaitingRescue[i].second, cars, carData, carCount, maxCars, carsInLane))
+            {
+                schedule(cars[carCount - 1], carData[carCount - 1], now);
+                awaitingRescue.erase(awaitingRescue.begin() + i);
             }
+            else
+                i++;
         }
+
+        int handled = 0;
+        while (!events.empty() && events.top().tick <= now)
+        {
+            BreakdownEvent event = events.top();
+            events.pop();
+
+            auto it = pending.find(event.carId);
+            if (it == pending.end() || it->second != event.tick)
+                continue; // Car left the simulation or was rescheduled
+            pending.erase(it);
+
+            event.data->isBroken = true;
+            event.data->breakdownPosition = Vector2f(event.car->getX(), event.car->getY());
+            event.car->setBreakdownState(true);
+            stats.totalBreakdowns++;
+            handled++;
+
+            cout << "Car " << plates().format(event.data->plate)
+                 << " broke down at (" << event.data->breakdownPosition.x
+                 << ", " << event.data->breakdownPosition.y << ")" << endl;
+
+            if (spawnRescueVehicle(event.car, event.data, cars, carData, carCount, maxCars, carsInLane))
+                schedule(cars[carCount - 1], carData[carCount - 1], now);
+            else
+                awaitingRescue.push_back({event.car, event.data});
+        }
+        return handled;
     }
-}
\ No newline at end of file
+};
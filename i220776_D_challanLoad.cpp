@@ -0,0 +1,498 @@
+#include <SFML/Window.hpp>
+#include <SFML/Graphics.hpp>
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <random>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <thread>
+#include <pthread.h>
+#include <sys/prctl.h>
+#include "i220776_D_SmartTraffix.h"
+
+// Challan store load generator.
+// Worker threads drive one ChallanGenerator with a mix of the three operations the deployed
+// subsystem serves: issuing challans (generateChallan), looking a vehicle up
+// (findChallansByVehicleNumber) and paying a challan (payChallan). Challans are issued without
+// printing them and payments skip StripPayment's receipt, so only the store is timed. Plates are
+// drawn from a pool with a configurable reuse distribution, and the ledger can be pre-filled to
+// the size a city would reach. Throughput and latency percentiles are reported per operation.
+//
+// Usage: ./challanload [--threads N] [--duration seconds] [--ops N] [--prefill N]
+//                      [--mix issue:lookup:pay] [--issue-rate R] [--lookup-rate R] [--pay-rate R]
+//                      [--plates N] [--reuse fresh|uniform|zipf] [--zipf-s s] [--seed N] [--csv]
+//
+// Without rates the workers run closed-loop, one operation after the other as fast as they can,
+// picking operations by the --mix weights. With rates (operations per second over all workers)
+// each worker keeps an open-loop schedule per operation and latency is measured from the time an
+// operation was due, so a stalled store shows up as queueing delay instead of a lower rate.
+
+using namespace std;
+
+enum LoadOperation
+{
+    LOAD_ISSUE,
+    LOAD_LOOKUP,
+    LOAD_PAY
+};
+
+const int LOAD_OPERATIONS = LOAD_PAY + 1;
+const char *const LOAD_OPERATION_NAMES[LOAD_OPERATIONS] = {"generateChallan", "findChallansByVehicleNumber", "payChallan"};
+
+enum PlateReuse
+{
+    REUSE_FRESH,   // Every violation by a vehicle never seen before
+    REUSE_UNIFORM, // Any plate of the pool equally likely
+    REUSE_ZIPF     // A few plates commit most violations
+};
+
+struct LoadOptions
+{
+    int threads = 4;
+    double duration = 10.0;
+    long maxOps = 0; // 0 runs for the whole duration
+    long prefill = 0;
+    double mix[LOAD_OPERATIONS] = {80, 15, 5};
+    double rates[LOAD_OPERATIONS] = {0, 0, 0}; // Operations per second over all workers, all 0 for closed-loop
+    int plates = 100000;
+    PlateReuse reuse = REUSE_ZIPF;
+    double zipfS = 1.1;
+    unsigned seed = 1;
+    bool csv = false;
+};
+
+// Latencies in nanoseconds, bucketed log-linearly: 16 buckets per power of two, so a percentile
+// is exact to within 1/16 of its value and a histogram has a fixed size however long the run
+class LatencyHistogram
+{
+    static const int SUB_BUCKETS = 16;
+    static const int BUCKETS = 64 * SUB_BUCKETS;
+    vector<uint64_t> counts;
+    uint64_t total;
+    uint64_t maximum;
+
+    static int bucketOf(uint64_t ns)
+    {
+        if (ns < SUB_BUCKETS)
+            return ns;
+        int exponent = 63 - __builtin_clzll(ns);
+        int sub = (ns >> (exponent - 4)) & (SUB_BUCKETS - 1);
+        return (exponent - 3) * SUB_BUCKETS + sub;
+    }
+
+    // Lowest value that falls into bucket
+    static uint64_t valueOf(int bucket)
+    {
+        if (bucket < SUB_BUCKETS)
+            return bucket;
+        int exponent = bucket / SUB_BUCKETS + 3;
+        return (uint64_t)(SUB_BUCKETS + bucket % SUB_BUCKETS) << (exponent - 4);
+    }
+
+public:
+    LatencyHistogram() : counts(BUCKETS, 0), total(0), maximum(0) {}
+
+    void record(uint64_t ns)
+    {
+        counts[bucketOf(ns)]++;
+        total++;
+        maximum = std::max(maximum, ns);
+    }
+
+    void merge(const LatencyHistogram &other)
+    {
+        for (int i = 0; i < BUCKETS; i++)
+            counts[i] += other.counts[i];
+        total += other.total;
+        maximum = std::max(maximum, other.maximum);
+    }
+
+    uint64_t count() const { return total; }
+    uint64_t highest() const { return maximum; }
+
+    uint64_t percentile(double p) const
+    {
+        if (total == 0)
+            return 0;
+        uint64_t rank = (uint64_t)ceil(p / 100.0 * total);
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKETS; i++)
+        {
+            seen += counts[i];
+            if (seen >= std::max<uint64_t>(rank, 1))
+                return std::min(valueOf(i), maximum);
+        }
+        return maximum;
+    }
+};
+
+// Draws plates by the configured reuse distribution; shared read-only by the workers
+class PlateSource
+{
+    vector<PlateId> pool;
+    vector<double> zipfCdf;
+    PlateReuse reuse;
+
+public:
+    PlateSource(const LoadOptions &options) : reuse(options.reuse)
+    {
+        pool.resize(max(1, options.plates));
+        for (size_t i = 0; i < pool.size(); i++)
+            pool[i] = plates().intern("LOAD-" + to_string(i));
+
+        if (reuse == REUSE_ZIPF)
+        {
+            // P(rank k) proportional to 1 / k^s
+            zipfCdf.resize(pool.size());
+            double sum = 0;
+            for (size_t k = 0; k < pool.size(); k++)
+            {
+                sum += 1.0 / pow(k + 1, options.zipfS);
+                zipfCdf[k] = sum;
+            }
+            for (double &value : zipfCdf)
+                value /= sum;
+        }
+    }
+
+    // A plate of the pool: the offender of a violation or the vehicle of a lookup
+    PlateId pick(mt19937_64 &rng) const
+    {
+        double u = uniform_real_distribution<double>(0, 1)(rng);
+        if (reuse == REUSE_ZIPF)
+            return pool[min(pool.size() - 1, (size_t)(lower_bound(zipfCdf.begin(), zipfCdf.end(), u) - zipfCdf.begin()))];
+        return pool[(size_t)(u * pool.size()) % pool.size()];
+    }
+
+    // Offender of a new violation
+    PlateId offender(mt19937_64 &rng, int worker, long &freshCount) const
+    {
+        if (reuse != REUSE_FRESH)
+            return pick(rng);
+        return plates().intern("NEW-" + to_string(worker) + "-" + to_string(freshCount++));
+    }
+};
+
+// Vehicle types that can be fined; emergency vehicles are exempt
+const tVehicleType FINED_TYPES[] = {CAR1, CAR2, CAR3, CAR4, CAR6, CAR7};
+
+struct OwedChallan
+{
+    int challanId;
+    PlateId plate;
+    float amount;
+};
+
+struct LoadWorker
+{
+    int index;
+    const LoadOptions *options;
+    const PlateSource *plateSource;
+    ChallanGenerator *generator;
+    pthread_barrier_t *start;
+    chrono::steady_clock::time_point begin, deadline;
+    long opsLimit; // This worker's share of --ops, 0 for none
+    LatencyHistogram latency[LOAD_OPERATIONS];
+    long failures[LOAD_OPERATIONS];
+    vector<OwedChallan> owed; // Issued by this worker and not paid yet
+    vector<PlateId> freshPlates; // Plates this worker fined under --reuse fresh, the pool its lookups draw from
+    long freshCount;
+};
+
+// Runs one operation and returns whether it succeeded.
+// plate (the offender or the vehicle looked up) is drawn by the caller, outside the timed part.
+bool runOperation(LoadWorker &worker, LoadOperation operation, PlateId plate, mt19937_64 &rng)
+{
+    switch (operation)
+    {
+    case LOAD_ISSUE:
+    {
+        tVehicleType type = FINED_TYPES[rng() % (sizeof(FINED_TYPES) / sizeof(FINED_TYPES[0]))];
+        ChallanRecord challan = worker.generator->generateChallan(plate, type, traitsOf(type).speedLimit + 10, false);
+        worker.owed.push_back({challan.challanId, plate, challan.totalAmount});
+        return true;
+    }
+    case LOAD_LOOKUP:
+    {
+        const int MAX_CHALLANS = 10;
+        ChallanRecord found[MAX_CHALLANS];
+        int resultCount = 0;
+        worker.generator->findChallansByVehicleNumber(plate, found, resultCount, MAX_CHALLANS);
+        return true; // A clean record is a valid answer
+    }
+    case LOAD_PAY:
+    {
+        if (worker.owed.empty())
+            return false;
+        // Pay a random outstanding challan
+        size_t pick = rng() % worker.owed.size();
+        OwedChallan challan = worker.owed[pick];
+        worker.owed[pick] = worker.owed.back();
+        worker.owed.pop_back();
+        return worker.generator->payChallan(challan.challanId, challan.plate, challan.amount);
+    }
+    }
+    return false;
+}
+
+void *loadWorkerThread(void *arg)
+{
+    LoadWorker &worker = *static_cast<LoadWorker *>(arg);
+    const LoadOptions &options = *worker.options;
+    using clock = chrono::steady_clock;
+    mt19937_64 rng(options.seed * 7919 + worker.index);
+    prctl(PR_SET_TIMERSLACK, 1); // The default 50 us of sleep slack would show up as latency when paced
+
+    bool paced = false;
+    double intervalNs[LOAD_OPERATIONS];
+    clock::time_point due[LOAD_OPERATIONS];
+    for (int op = 0; op < LOAD_OPERATIONS; op++)
+    {
+        paced |= options.rates[op] > 0;
+        intervalNs[op] = options.rates[op] > 0 ? 1e9 * options.threads / options.rates[op] : INFINITY;
+    }
+    discrete_distribution<int> pickOperation(options.mix, options.mix + LOAD_OPERATIONS);
+    auto drawPlate = [&](LoadOperation operation)
+    {
+        bool fresh = options.reuse == REUSE_FRESH;
+        if (operation == LOAD_ISSUE)
+        {
+            PlateId offender = worker.plateSource->offender(rng, worker.index, worker.freshCount);
+            if (fresh)
+                worker.freshPlates.push_back(offender);
+            return offender;
+        }
+        if (operation != LOAD_LOOKUP)
+            return NO_PLATE;
+        // Fresh plates never reach the pool, so look up the ones this worker has already fined
+        if (fresh && !worker.freshPlates.empty())
+            return worker.freshPlates[rng() % worker.freshPlates.size()];
+        return worker.plateSource->pick(rng);
+    };
+
+    pthread_barrier_wait(worker.start);
+    for (int op = 0; op < LOAD_OPERATIONS; op++)
+    {
+        // Workers start a fraction of an interval apart so their operations do not arrive in bursts
+        double offset = isinf(intervalNs[op]) ? 0 : intervalNs[op] * worker.index / options.threads;
+        due[op] = worker.begin + chrono::nanoseconds((long)offset);
+    }
+
+    for (long done = 0; worker.opsLimit == 0 || done < worker.opsLimit; done++)
+    {
+        LoadOperation operation;
+        PlateId plate;
+        clock::time_point started;
+        if (paced)
+        {
+            int next = -1;
+            for (int op = 0; op < LOAD_OPERATIONS; op++)
+            {
+                if (!isinf(intervalNs[op]) && (next == -1 || due[op] < due[next]))
+                    next = op;
+            }
+            operation = static_cast<LoadOperation>(next);
+            plate = drawPlate(operation);
+            started = due[next];
+            due[next] += chrono::nanoseconds((long)intervalNs[next]);
+            if (started >= worker.deadline)
+                break;
+            if (clock::now() < started)
+                this_thread::sleep_until(started);
+        }
+        else
+        {
+            operation = static_cast<LoadOperation>(pickOperation(rng));
+            plate = drawPlate(operation);
+            started = clock::now();
+            if (started >= worker.deadline)
+                break;
+        }
+
+        bool ok = runOperation(worker, operation, plate, rng);
+        worker.latency[operation].record(chrono::duration_cast<chrono::nanoseconds>(clock::now() - started).count());
+        worker.failures[operation] += !ok;
+    }
+    return nullptr;
+}
+
+bool parseMix(const string &text, double mix[LOAD_OPERATIONS])
+{
+    char separator1, separator2;
+    stringstream ss(text);
+    if (!(ss >> mix[0] >> separator1 >> mix[1] >> separator2 >> mix[2]) || separator1 != ':' || separator2 != ':')
+    {
+        cerr << "--mix expects issue:lookup:pay weights, e.g. 80:15:5\n";
+        return false;
+    }
+    return true;
+}
+
+bool parseReuse(const string &text, PlateReuse &reuse)
+{
+    if (text == "fresh")
+        reuse = REUSE_FRESH;
+    else if (text == "uniform")
+        reuse = REUSE_UNIFORM;
+    else if (text == "zipf")
+        reuse = REUSE_ZIPF;
+    else
+    {
+        cerr << "--reuse expects fresh, uniform or zipf\n";
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    LoadOptions options;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc)
+            options.threads = max(1, atoi(argv[++i]));
+        else if (arg == "--duration" && i + 1 < argc)
+            options.duration = atof(argv[++i]);
+        else if (arg == "--ops" && i + 1 < argc)
+            options.maxOps = atol(argv[++i]);
+        else if (arg == "--prefill" && i + 1 < argc)
+            options.prefill = atol(argv[++i]);
+        else if (arg == "--mix" && i + 1 < argc)
+        {
+            if (!parseMix(argv[++i], options.mix))
+                return 1;
+        }
+        else if (arg == "--issue-rate" && i + 1 < argc)
+            options.rates[LOAD_ISSUE] = atof(argv[++i]);
+        else if (arg == "--lookup-rate" && i + 1 < argc)
+            options.rates[LOAD_LOOKUP] = atof(argv[++i]);
+        else if (arg == "--pay-rate" && i + 1 < argc)
+            options.rates[LOAD_PAY] = atof(argv[++i]);
+        else if (arg == "--plates" && i + 1 < argc)
+            options.plates = atoi(argv[++i]);
+        else if (arg == "--reuse" && i + 1 < argc)
+        {
+            if (!parseReuse(argv[++i], options.reuse))
+                return 1;
+        }
+        else if (arg == "--zipf-s" && i + 1 < argc)
+            options.zipfS = atof(argv[++i]);
+        else if (arg == "--seed" && i + 1 < argc)
+            options.seed = strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--csv")
+            options.csv = true;
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [--threads N] [--duration seconds] [--ops N] [--prefill N]\n"
+                 << "       [--mix issue:lookup:pay] [--issue-rate R] [--lookup-rate R] [--pay-rate R]\n"
+                 << "       [--plates N] [--reuse fresh|uniform|zipf] [--zipf-s s] [--seed N] [--csv]\n";
+            return 1;
+        }
+    }
+
+    using clock = chrono::steady_clock;
+    PlateSource plateSource(options);
+    ChallanGenerator generator;
+
+    // Ledger the run starts from, issued like any other challan but not measured
+    mt19937_64 prefillRng(options.seed);
+    long prefillFresh = 0;
+    for (long i = 0; i < options.prefill; i++)
+    {
+        tVehicleType type = FINED_TYPES[prefillRng() % (sizeof(FINED_TYPES) / sizeof(FINED_TYPES[0]))];
+        generator.generateChallan(plateSource.offender(prefillRng, -1, prefillFresh), type, traitsOf(type).speedLimit + 10, false);
+    }
+
+    vector<LoadWorker> workers(options.threads);
+    vector<pthread_t> threads(options.threads);
+    pthread_barrier_t start;
+    pthread_barrier_init(&start, nullptr, options.threads + 1);
+    for (int i = 0; i < options.threads; i++)
+    {
+        LoadWorker &worker = workers[i];
+        worker.index = i;
+        worker.options = &options;
+        worker.plateSource = &plateSource;
+        worker.generator = &generator;
+        worker.start = &start;
+        worker.opsLimit = options.maxOps > 0 ? max(1L, options.maxOps / options.threads) : 0;
+        fill(worker.failures, worker.failures + LOAD_OPERATIONS, 0);
+        worker.freshCount = 0;
+        pthread_create(&threads[i], nullptr, loadWorkerThread, &worker);
+    }
+
+    // Every worker gets the same start and deadline once they are all ready
+    clock::time_point begin = clock::now() + chrono::milliseconds(10);
+    for (LoadWorker &worker : workers)
+    {
+        worker.begin = begin;
+        worker.deadline = begin + chrono::nanoseconds((long)(options.duration * 1e9));
+    }
+    pthread_barrier_wait(&start);
+    for (int i = 0; i < options.threads; i++)
+    {
+        pthread_join(threads[i], nullptr);
+    }
+    double elapsed = chrono::duration<double>(clock::now() - begin).count();
+    pthread_barrier_destroy(&start);
+
+    LatencyHistogram latency[LOAD_OPERATIONS];
+    long failures[LOAD_OPERATIONS] = {};
+    for (const LoadWorker &worker : workers)
+    {
+        for (int op = 0; op < LOAD_OPERATIONS; op++)
+        {
+            latency[op].merge(worker.latency[op]);
+            failures[op] += worker.failures[op];
+        }
+    }
+
+    if (options.csv)
+        cout << "operation,count,failures,ops_per_second,p50_us,p90_us,p99_us,p999_us,max_us\n";
+    else
+    {
+        cout << "Ledger: " << options.prefill << " challans before the run, " << generator.getTotalChallanCount()
+             << " after (" << generator.getUnpaidCount() << " unpaid); " << options.threads << " threads, "
+             << fixed << setprecision(2) << elapsed << " s\n";
+        cout << left << setw(30) << "operation" << right << setw(10) << "count" << setw(9) << "failed"
+             << setw(12) << "ops/s" << setw(10) << "p50 us" << setw(10) << "p90 us" << setw(10) << "p99 us"
+             << setw(11) << "p99.9 us" << setw(11) << "max us" << "\n";
+    }
+    for (int op = 0; op < LOAD_OPERATIONS; op++)
+    {
+        const LatencyHistogram &h = latency[op];
+        double values[] = {h.percentile(50) / 1e3, h.percentile(90) / 1e3, h.percentile(99) / 1e3,
+                           h.percentile(99.9) / 1e3, h.highest() / 1e3};
+        if (options.csv)
+        {
+            cout << LOAD_OPERATION_NAMES[op] << "," << h.count() << "," << failures[op] << ","
+                 << fixed << setprecision(1) << h.count() / elapsed;
+            for (double value : values)
+                cout << "," << setprecision(2) << value;
+            cout << "\n";
+        }
+        else
+        {
+            cout << left << setw(30) << LOAD_OPERATION_NAMES[op] << right << setw(10) << h.count()
+                 << setw(9) << failures[op] << setw(12) << setprecision(0) << h.count() / elapsed << setprecision(1);
+            for (int i = 0; i < 5; i++)
+                cout << setw(i < 3 ? 10 : 11) << values[i];
+            cout << "\n";
+        }
+    }
+    if (!options.csv)
+    {
+        // Includes the unused rows of the last 4096-row column chunk and the spare capacity of
+        // the per-plate row chain, which grows by doubling
+        MemoryUsage ledger = memoryUsage(MEMORY_CHALLANS);
+        int challans = generator.getTotalChallanCount();
+        cout << "Challan memory: " << formatBytes(ledger.liveBytes) << " live, " << formatBytes(ledger.peakBytes)
+             << " peak, " << setprecision(1) << (challans > 0 ? (double)ledger.liveBytes / challans : 0.0)
+             << " bytes per challan\n";
+    }
+    return 0;
+}
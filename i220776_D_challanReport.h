@@ -0,0 +1,456 @@
+#pragma once
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+#include <cstdint>
+#include <ctime>
+#include <pthread.h>
+#include "i220776_D_plates.h"
+#include "i220776_D_vehicleTraits.h"
+#include "i220776_D_memoryAccounting.h"
+
+using namespace std;
+
+// Columnar challan ledger and its reports.
+// ChallanGenerator keeps every challan as one row of ChallanColumns: one array per field, in
+// issue order, allocated in fixed chunks. A report reads only the columns it needs, front to
+// back, so a month of tens of millions of challans streams through the cache instead of chasing
+// one heap node per record.
+// buildChallanReport splits the rows between threads; each thread scans its range into its
+// own partial totals and plate histogram, and the partials are summed afterwards.
+
+enum PaymentStatus
+{
+    PAID,
+    UNPAID,
+    OVERDUE
+};
+
+class ChallanRecord
+{
+public:
+    int challanId;
+    PlateId plate;
+    VehicleCategory vehicleCategory;
+    float baseAmount;
+    float totalAmount;
+    time_t issueDate;
+    time_t dueDate;
+    PaymentStatus status;
+};
+
+const int CHALLAN_CATEGORIES = UNKNOWN + 1;
+
+inline const char *challanCategoryName(VehicleCategory category)
+{
+    switch (category)
+    {
+    case REGULAR:
+        return "Regular";
+    case EMERGENCY:
+        return "Emergency";
+    case HEAVY:
+        return "Heavy";
+    default:
+        return "Unknown";
+    }
+}
+const int DEFAULT_REPORT_THREADS = 4;
+const int REPORT_TOP_OFFENDERS = 10;
+const size_t REPORT_ROWS_PER_THREAD = 1 << 18; // Smaller ledgers use fewer threads than asked for
+
+const size_t CHALLAN_CHUNK_ROWS = 1 << 12;
+
+// CHALLAN_CHUNK_ROWS rows of every column. A chunk never moves once allocated, so the rows
+// already in it can be read while later rows are appended.
+struct ChallanChunk
+{
+    int32_t ids[CHALLAN_CHUNK_ROWS];
+    PlateId plates[CHALLAN_CHUNK_ROWS];
+    uint8_t categories[CHALLAN_CHUNK_ROWS];
+    atomic<uint8_t> statuses[CHALLAN_CHUNK_ROWS]; // The only field that changes, when a challan is paid
+    float baseAmounts[CHALLAN_CHUNK_ROWS];
+    float totalAmounts[CHALLAN_CHUNK_ROWS];
+    int64_t issueDates[CHALLAN_CHUNK_ROWS];
+    int64_t dueDates[CHALLAN_CHUNK_ROWS];
+};
+
+// Rows are appended in issue order, so ids ascend.
+// Copying the columns copies the chunk table only and shares the chunks: the copy sees the rows
+// as of the copy, and a report can scan it without the ledger's mutex while rows are added.
+struct ChallanColumns
+{
+    vector<shared_ptr<ChallanChunk>> chunks;
+    size_t rows = 0;
+    // Range of the plate ids in plates, which sizes the report's plate histogram
+    PlateId minPlate = UINT32_MAX;
+    PlateId maxPlate = NO_PLATE;
+
+    size_t size() const { return rows; }
+
+    ChallanChunk &chunkOf(size_t row) const { return *chunks[row / CHALLAN_CHUNK_ROWS]; }
+
+    void push(const ChallanRecord &challan)
+    {
+        if (rows == chunks.size() * CHALLAN_CHUNK_ROWS)
+            chunks.push_back(make_shared<ChallanChunk>());
+        ChallanChunk &chunk = chunkOf(rows);
+        size_t i = rows % CHALLAN_CHUNK_ROWS;
+        chunk.ids[i] = challan.challanId;
+        chunk.plates[i] = challan.plate;
+        chunk.categories[i] = challan.vehicleCategory;
+        chunk.statuses[i].store(challan.status, memory_order_relaxed);
+        chunk.baseAmounts[i] = challan.baseAmount;
+        chunk.totalAmounts[i] = challan.totalAmount;
+        chunk.issueDates[i] = challan.issueDate;
+        chunk.dueDates[i] = challan.dueDate;
+        minPlate = min(minPlate, challan.plate);
+        maxPlate = max(maxPlate, challan.plate);
+        rows++;
+    }
+
+    ChallanRecord row(size_t row) const
+    {
+        const ChallanChunk &chunk = chunkOf(row);
+        size_t i = row % CHALLAN_CHUNK_ROWS;
+        ChallanRecord challan;
+        challan.challanId = chunk.ids[i];
+        challan.plate = chunk.plates[i];
+        challan.vehicleCategory = static_cast<VehicleCategory>(chunk.categories[i]);
+        challan.status = static_cast<PaymentStatus>(chunk.statuses[i].load(memory_order_relaxed));
+        challan.baseAmount = chunk.baseAmounts[i];
+        challan.totalAmount = chunk.totalAmounts[i];
+        challan.issueDate = chunk.issueDates[i];
+        challan.dueDate = chunk.dueDates[i];
+        return challan;
+    }
+
+    // Seen by copies taken before the change too; a report scanning one counts the row either way
+    void setStatus(size_t row, PaymentStatus status)
+    {
+        chunkOf(row).statuses[row % CHALLAN_CHUNK_ROWS].store(status, memory_order_relaxed);
+    }
+
+    // Row of a challan id, -1 if there is none
+    long find(int challanId) const
+    {
+        size_t low = 0, high = rows;
+        while (low < high)
+        {
+            size_t middle = low + (high - low) / 2;
+            if (chunkOf(middle).ids[middle % CHALLAN_CHUNK_ROWS] < challanId)
+                low = middle + 1;
+            else
+                high = middle;
+        }
+        return low < rows && chunkOf(low).ids[low % CHALLAN_CHUNK_ROWS] == challanId ? (long)low : -1;
+    }
+
+    void clear()
+    {
+        // swap rather than clear() so a dropped ledger gives its memory back once no copy holds it
+        vector<shared_ptr<ChallanChunk>>().swap(chunks);
+        rows = 0;
+        minPlate = UINT32_MAX;
+        maxPlate = NO_PLATE;
+    }
+};
+
+// Which challans a report covers: issued in [from, to), judged overdue as of asOf
+struct ChallanReportQuery
+{
+    time_t from;
+    time_t to;
+    time_t asOf;
+    int minRepeat; // Challans in the period that make a plate a repeat offender
+};
+
+// The period of a calendar month (local time), overdue as of its last second or now, whichever is earlier
+inline ChallanReportQuery monthQuery(int year, int month)
+{
+    tm start = {};
+    start.tm_year = year - 1900;
+    start.tm_mon = month - 1;
+    start.tm_mday = 1;
+    start.tm_isdst = -1;
+    tm end = start;
+    end.tm_mon++;
+    time_t from = mktime(&start), to = mktime(&end);
+    return {from, to, min(to, time(nullptr)), 2};
+}
+
+struct ChallanReport
+{
+    ChallanReportQuery query;
+    long challans;
+    long challansByCategory[CHALLAN_CATEGORIES];
+    double revenueByCategory[CHALLAN_CATEGORIES]; // Paid challans, PKR
+    double unpaidByCategory[CHALLAN_CATEGORIES];  // Unpaid challans, PKR
+    long unpaidCount;
+    long overdueCount; // Unpaid past their due date
+    double overdueAmount;
+    long plates;          // Distinct plates with a challan in the period
+    long repeatOffenders; // Plates with at least query.minRepeat challans
+    vector<pair<PlateId, int>> topOffenders; // Most challans first, at most REPORT_TOP_OFFENDERS
+};
+
+// Everything one thread adds up over its rows
+struct ChallanReportSlice
+{
+    const ChallanColumns *columns;
+    const ChallanReportQuery *query;
+    size_t begin, end;
+    long challansByCategory[CHALLAN_CATEGORIES];
+    double revenueByCategory[CHALLAN_CATEGORIES];
+    double unpaidByCategory[CHALLAN_CATEGORIES];
+    long unpaidCount;
+    long overdueCount;
+    double overdueAmount;
+    PlateId firstPlate;        // Plate id of perPlate[0]
+    vector<uint32_t> perPlate; // Challans per plate in the period
+};
+
+// Second pass: one thread per range of plate ids sums the slices' histograms over it
+struct PlateRangeSlice
+{
+    const vector<ChallanReportSlice> *slices;
+    int minRepeat;
+    size_t begin, end; // Histogram indices, plate id minus firstPlate
+    long plates, repeatOffenders;
+    vector<pair<PlateId, int>> topOffenders;
+};
+
+inline bool moreChallans(const pair<PlateId, int> &a, const pair<PlateId, int> &b)
+{
+    return a.second != b.second ? a.second > b.second : a.first < b.first;
+}
+
+// Keeps the REPORT_TOP_OFFENDERS first entries of offenders by moreChallans, sorted
+inline void keepTopOffenders(vector<pair<PlateId, int>> &offenders)
+{
+    size_t keep = min(offenders.size(), (size_t)REPORT_TOP_OFFENDERS);
+    partial_sort(offenders.begin(), offenders.begin() + keep, offenders.end(), moreChallans);
+    offenders.resize(keep);
+}
+
+// Counts and sums of one slice of rows.
+// The first loop works LANES rows at a time into LANES independent accumulators and selects
+// instead of branching, so the compiler can keep the lanes in vector registers.
+inline void *scanChallanSliceThread(void *arg)
+{
+    ChallanReportSlice &slice = *static_cast<ChallanReportSlice *>(arg);
+    const ChallanColumns &columns = *slice.columns;
+    const int64_t from = slice.query->from, to = slice.query->to, asOf = slice.query->asOf;
+    // Columns of the chunk being scanned; rows below index into it
+    const uint8_t *categories = nullptr;
+    const atomic<uint8_t> *statuses = nullptr;
+    const float *amounts = nullptr;
+    const int64_t *issued = nullptr;
+    const int64_t *due = nullptr;
+
+    const int LANES = 8;
+    int64_t count[CHALLAN_CATEGORIES][LANES] = {};
+    double revenue[CHALLAN_CATEGORIES][LANES] = {};
+    double unpaid[CHALLAN_CATEGORIES][LANES] = {};
+    int64_t unpaidCount[LANES] = {};
+    int64_t overdue[LANES] = {};
+    double overdueAmount[LANES] = {};
+
+    // Masks are 0 or 1 and amounts are multiplied by them, which is exact
+    auto scanRow = [&](size_t row, int lane)
+    {
+        int64_t inPeriod = (issued[row] >= from) & (issued[row] < to);
+        int64_t open = inPeriod & (statuses[row].load(memory_order_relaxed) != PAID);
+        int64_t late = open & (due[row] < asOf);
+        double amount = amounts[row];
+        for (int category = 0; category < CHALLAN_CATEGORIES; category++)
+        {
+            int64_t is = inPeriod & (categories[row] == category);
+            count[category][lane] += is;
+            revenue[category][lane] += amount * (is & !open);
+            unpaid[category][lane] += amount * (is & open);
+        }
+        unpaidCount[lane] += open;
+        overdue[lane] += late;
+        overdueAmount[lane] += amount * late;
+    };
+
+    for (size_t first = slice.begin; first < slice.end;)
+    {
+        const ChallanChunk &chunk = columns.chunkOf(first);
+        size_t begin = first % CHALLAN_CHUNK_ROWS;
+        size_t end = min(CHALLAN_CHUNK_ROWS, begin + (slice.end - first));
+        first += end - begin;
+        categories = chunk.categories;
+        statuses = chunk.statuses;
+        amounts = chunk.totalAmounts;
+        issued = chunk.issueDates;
+        due = chunk.dueDates;
+
+        size_t row = begin;
+        for (; row + LANES <= end; row += LANES)
+        {
+            for (int lane = 0; lane < LANES; lane++)
+                scanRow(row + lane, lane);
+        }
+        for (int lane = 0; row < end; row++, lane++)
+            scanRow(row, lane);
+
+        // Plate ids are dense, so the histogram is a plain array indexed by id
+        for (size_t i = begin; i < end; i++)
+            slice.perPlate[chunk.plates[i] - slice.firstPlate] += issued[i] >= from && issued[i] < to;
+    }
+
+    for (int category = 0; category < CHALLAN_CATEGORIES; category++)
+    {
+        slice.challansByCategory[category] = 0;
+        slice.revenueByCategory[category] = 0;
+        slice.unpaidByCategory[category] = 0;
+        for (int lane = 0; lane < LANES; lane++)
+        {
+            slice.challansByCategory[category] += count[category][lane];
+            slice.revenueByCategory[category] += revenue[category][lane];
+            slice.unpaidByCategory[category] += unpaid[category][lane];
+        }
+    }
+    slice.unpaidCount = 0;
+    slice.overdueCount = 0;
+    slice.overdueAmount = 0;
+    for (int lane = 0; lane < LANES; lane++)
+    {
+        slice.unpaidCount += unpaidCount[lane];
+        slice.overdueCount += overdue[lane];
+        slice.overdueAmount += overdueAmount[lane];
+    }
+    return nullptr;
+}
+
+inline void *mergePlateRangeThread(void *arg)
+{
+    PlateRangeSlice &range = *static_cast<PlateRangeSlice *>(arg);
+    MemoryScope scope(MEMORY_CHALLANS);
+    range.plates = 0;
+    range.repeatOffenders = 0;
+    range.topOffenders.clear();
+    for (size_t plate = range.begin; plate < range.end; plate++)
+    {
+        int challans = 0;
+        for (const ChallanReportSlice &slice : *range.slices)
+            challans += slice.perPlate[plate];
+        range.plates += challans > 0;
+        if (challans < range.minRepeat || challans == 0)
+            continue;
+        range.repeatOffenders++;
+        range.topOffenders.push_back({(*range.slices)[0].firstPlate + (PlateId)plate, challans});
+        // Trim now and then so a period full of repeat offenders does not grow the list unbounded
+        if (range.topOffenders.size() >= (size_t)REPORT_TOP_OFFENDERS * 64)
+            keepTopOffenders(range.topOffenders);
+    }
+    keepTopOffenders(range.topOffenders);
+    return nullptr;
+}
+
+// Runs body once per slice, each on its own thread; a single slice runs on the caller's thread
+template <typename Slice>
+void runReportThreads(void *(*body)(void *), vector<Slice> &slices)
+{
+    if (slices.size() == 1)
+    {
+        body(&slices[0]);
+        return;
+    }
+    vector<pthread_t> threads(slices.size());
+    for (size_t i = 0; i < slices.size(); i++)
+        pthread_create(&threads[i], nullptr, body, &slices[i]);
+    for (size_t i = 0; i < slices.size(); i++)
+        pthread_join(threads[i], nullptr);
+}
+
+// Aggregates the rows of columns matched by query on numThreads threads
+inline ChallanReport buildChallanReport(const ChallanColumns &columns, const ChallanReportQuery &query, int numThreads = DEFAULT_REPORT_THREADS)
+{
+    size_t rows = columns.size();
+    numThreads = max(1, min(numThreads, (int)(rows / REPORT_ROWS_PER_THREAD)));
+    PlateId firstPlate = rows > 0 ? columns.minPlate : 0;
+    size_t plateCount = rows > 0 ? (size_t)columns.maxPlate - firstPlate + 1 : 0;
+    size_t perThread = rows / numThreads;
+    size_t platesPerThread = plateCount / numThreads;
+
+    vector<ChallanReportSlice> slices(numThreads);
+    vector<PlateRangeSlice> ranges(numThreads);
+    for (int i = 0; i < numThreads; i++)
+    {
+        slices[i].columns = &columns;
+        slices[i].query = &query;
+        slices[i].begin = i * perThread;
+        slices[i].end = (i == numThreads - 1) ? rows : (i + 1) * perThread;
+        slices[i].firstPlate = firstPlate;
+        slices[i].perPlate.assign(plateCount, 0);
+    }
+    runReportThreads(scanChallanSliceThread, slices);
+
+    for (int i = 0; i < numThreads; i++)
+    {
+        ranges[i].slices = &slices;
+        ranges[i].minRepeat = query.minRepeat;
+        ranges[i].begin = i * platesPerThread;
+        ranges[i].end = (i == numThreads - 1) ? plateCount : (i + 1) * platesPerThread;
+    }
+    runReportThreads(mergePlateRangeThread, ranges);
+
+    ChallanReport report = {};
+    report.query = query;
+    for (const ChallanReportSlice &slice : slices)
+    {
+        for (int category = 0; category < CHALLAN_CATEGORIES; category++)
+        {
+            report.challans += slice.challansByCategory[category];
+            report.challansByCategory[category] += slice.challansByCategory[category];
+            report.revenueByCategory[category] += slice.revenueByCategory[category];
+            report.unpaidByCategory[category] += slice.unpaidByCategory[category];
+        }
+        report.unpaidCount += slice.unpaidCount;
+        report.overdueCount += slice.overdueCount;
+        report.overdueAmount += slice.overdueAmount;
+    }
+    for (const PlateRangeSlice &range : ranges)
+    {
+        report.plates += range.plates;
+        report.repeatOffenders += range.repeatOffenders;
+        report.topOffenders.insert(report.topOffenders.end(), range.topOffenders.begin(), range.topOffenders.end());
+    }
+    keepTopOffenders(report.topOffenders);
+    return report;
+}
+
+inline void printChallanReport(ostream &out, const ChallanReport &report)
+{
+    char from[32], to[32];
+    tm local;
+    strftime(from, sizeof(from), "%Y-%m-%d", localtime_r(&report.query.from, &local));
+    strftime(to, sizeof(to), "%Y-%m-%d", localtime_r(&report.query.to, &local));
+
+    double revenue = 0, unpaid = 0;
+    out << fixed << setprecision(0);
+    out << "Challans issued " << from << " to " << to << " (exclusive): " << report.challans << "\n";
+    for (int category = 0; category < CHALLAN_CATEGORIES; category++)
+    {
+        if (report.challansByCategory[category] == 0)
+            continue;
+        out << "  " << challanCategoryName(static_cast<VehicleCategory>(category)) << ": " << report.challansByCategory[category] << " challans, "
+            << report.revenueByCategory[category] << " PKR collected, "
+            << report.unpaidByCategory[category] << " PKR unpaid\n";
+        revenue += report.revenueByCategory[category];
+        unpaid += report.unpaidByCategory[category];
+    }
+    out << "Collected: " << revenue << " PKR\n";
+    out << "Unpaid: " << report.unpaidCount << " challans, " << unpaid << " PKR\n";
+    out << "Overdue: " << report.overdueCount << " challans, " << report.overdueAmount << " PKR\n";
+    out << "Plates: " << report.plates << ", " << report.repeatOffenders << " with " << report.query.minRepeat << " or more challans\n";
+    for (const pair<PlateId, int> &offender : report.topOffenders)
+        out << "  " << ::plates().format(offender.first) << ": " << offender.second << " challans\n";
+    out << defaultfloat << setprecision(6);
+}
@@ -0,0 +1,211 @@
+#pragma once
+#include <SFML/System.hpp>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <random>
+#include <cstdint>
+#include "i220776_D_car.h"
+#include "i220776_D_SmartTraffix.h"
+#include "i220776_D_carBreakDown.h"
+#include "i220776_D_checkpointStream.h"
+#include "i220776_D_simClock.h"
+#include "i220776_D_routes.h"
+#include "i220776_D_spawnCars.h"
+
+using namespace std;
+
+// Whole-simulation checkpoints.
+// Captures vehicles, CarData, lane counters, SmartTraffix state, the spawn RNG, the
+// simulated time of day, each vehicle's place on its route, the spawn, speed and signal timers
+// and the challan ledger so an experiment can start from a warmed-up intersection. Timers are
+// ticks, so a restored run continues exactly where the saved one stood.
+
+const uint32_t CHECKPOINT_MAGIC = 0x43585453; // "STXC"
+const uint32_t CHECKPOINT_VERSION = 6;
+const int CHECKPOINT_LANES = 8;
+
+// Everything the main loop owns that a checkpoint captures
+struct SimulationState
+{
+    Car **cars;
+    CarData **carData;
+    int *carCount;
+    int maxCars;
+    int *carsInLane; // CHECKPOINT_LANES entries
+    SmartTraffix *trafficController;
+    ChallanGenerator *challanGenerator;
+    SimulationStats *stats;
+    mt19937 *rng;
+    int *speedStep; // Lane speed increment applied once a second in main()
+    unsigned *tick;
+    SpawnTimers *spawnTimers;
+    TickTimer *speedTimer;
+    SimClock *clock;
+    const RouteTable *routes; // Routes are stored as (entry lane, movement) and looked up again on restore
+};
+
+bool saveCheckpoint(const string &path, const SimulationState &state)
+{
+    CheckpointWriter writer;
+    writer.put(CHECKPOINT_MAGIC);
+    writer.put(CHECKPOINT_VERSION);
+
+    writer.put<uint32_t>(*state.tick);
+    writer.put<int32_t>(*state.speedStep);
+    writer.put<int32_t>(state.stats->totalBreakdowns);
+    writer.put<int32_t>(plates().getNextNumber());
+    writer.put(state.clock->getSecondsOfDay());
+    writer.put<uint32_t>(state.clock->getDay());
+
+    stringstream rngState;
+    rngState << *state.rng;
+    writer.putString(rngState.str());
+    writer.put(*state.spawnTimers);
+    writer.put(*state.speedTimer);
+
+    writer.putBytes(state.carsInLane, sizeof(int) * CHECKPOINT_LANES);
+
+    int carCount = *state.carCount;
+    writer.put<int32_t>(carCount);
+    for (int i = 0; i < carCount; i++)
+    {
+        Car *car = state.cars[i];
+        CarData *data = state.carData[i];
+
+        writer.put<int32_t>(car->getType());
+        writer.put(car->getX());
+        writer.put(car->getY());
+        writer.put(car->getDir());
+        writer.put(car->getSpeed());
+        writer.put<bool>(car->isInBrokenState());
+        writer.put<bool>(car->getChallanStatus());
+        const Route *route = car->getRoute();
+        writer.put<int32_t>(route != nullptr ? route->entryLane : -1);
+        writer.put<int32_t>(route != nullptr ? route->movement : 0);
+        writer.put(car->getRouteProgress());
+
+        writer.putString(plates().format(data->plate)); // Plate ids are per process
+        writer.put(data->speed);
+        writer.put<bool>(data->challanStatus);
+        writer.put<int32_t>(data->laneIndex);
+        writer.put<bool>(data->isBroken);
+        writer.put(data->breakdownPosition.x);
+        writer.put(data->breakdownPosition.y);
+        writer.put<bool>(data->hasSpawnedRescueVehicle);
+        writer.put<bool>(data->markedForDeletion);
+    }
+
+    state.trafficController->saveState(writer);
+    state.challanGenerator->saveState(writer);
+
+    if (!writer.saveToFile(path))
+    {
+        cerr << "Checkpoint: cannot write " << path << "\n";
+        return false;
+    }
+    cout << "Checkpoint: saved " << carCount << " vehicles (" << writer.size() << " bytes) to " << path << "\n";
+    return true;
+}
+
+// Replaces the current simulation state with the checkpoint at path.
+// Existing vehicles are deleted first.
+bool loadCheckpoint(const string &path, SimulationState &state)
+{
+    CheckpointReader reader;
+    if (!reader.loadFromFile(path))
+    {
+        cerr << "Checkpoint: cannot read " << path << "\n";
+        return false;
+    }
+    if (reader.get<uint32_t>() != CHECKPOINT_MAGIC || reader.get<uint32_t>() != CHECKPOINT_VERSION)
+    {
+        cerr << "Checkpoint: " << path << " is not a version " << CHECKPOINT_VERSION << " checkpoint\n";
+        return false;
+    }
+
+    *state.tick = reader.get<uint32_t>();
+    *state.speedStep = reader.get<int32_t>();
+    state.stats->totalBreakdowns = reader.get<int32_t>();
+    plates().setNextNumber(reader.get<int32_t>());
+    double secondsOfDay = reader.get<double>();
+    state.clock->set(secondsOfDay, reader.get<uint32_t>());
+
+    stringstream rngState(reader.getString());
+    rngState >> *state.rng;
+    *state.spawnTimers = reader.get<SpawnTimers>();
+    *state.speedTimer = reader.get<TickTimer>();
+
+    reader.getBytes(state.carsInLane, sizeof(int) * CHECKPOINT_LANES);
+
+    for (int i = 0; i < *state.carCount; i++)
+    {
+        delete state.cars[i];
+        delete state.carData[i];
+        state.cars[i] = nullptr;
+        state.carData[i] = nullptr;
+    }
+    *state.carCount = 0;
+
+    int carCount = reader.get<int32_t>();
+    if (carCount < 0 || carCount > state.maxCars)
+    {
+        cerr << "Checkpoint: " << path << " holds " << carCount << " vehicles, more than the " << state.maxCars << " supported\n";
+        return false;
+    }
+
+    for (int i = 0; i < carCount && !reader.fail(); i++)
+    {
+        int type = reader.get<int32_t>();
+        if (type < 0 || type >= VEHICLE_TYPE_COUNT)
+        {
+            cerr << "Checkpoint: " << path << " is truncated or does not match this scenario\n";
+            return false;
+        }
+        float x = reader.get<float>();
+        float y = reader.get<float>();
+        float dir = reader.get<float>();
+        Car *car = new Car(static_cast<tVehicleType>(type), x, y, dir);
+        car->setSpeed(reader.get<float>());
+        car->setBreakdownState(reader.get<bool>());
+        car->setChallanStatus(reader.get<bool>());
+        int routeLane = reader.get<int32_t>();
+        int movement = reader.get<int32_t>();
+        float progress = reader.get<float>();
+        if (routeLane >= 0 && routeLane < SCENARIO_LANES && movement >= MOVE_LEFT && movement <= MOVE_RIGHT)
+            car->setRoute(&state.routes->get(routeLane, static_cast<tMovement>(movement)), progress);
+
+        CarData *data = new CarData();
+        data->plate = plates().intern(reader.getString());
+        data->speed = reader.get<float>();
+        data->challanStatus = reader.get<bool>();
+        data->laneIndex = reader.get<int32_t>();
+        data->isBroken = reader.get<bool>();
+        data->breakdownPosition.x = reader.get<float>();
+        data->breakdownPosition.y = reader.get<float>();
+        data->hasSpawnedRescueVehicle = reader.get<bool>();
+        data->markedForDeletion = reader.get<bool>();
+
+        car->setData(data);
+        // The lane indexes carsInLane and the scenario's lanes
+        if (data->laneIndex < 0 || data->laneIndex >= SCENARIO_LANES / 2)
+        {
+            delete car;
+            delete data;
+            cerr << "Checkpoint: " << path << " is truncated or does not match this scenario\n";
+            return false;
+        }
+        state.cars[i] = car;
+        state.carData[i] = data;
+        *state.carCount = i + 1;
+    }
+
+    if (!state.trafficController->loadState(reader) || !state.challanGenerator->loadState(reader) || reader.fail())
+    {
+        cerr << "Checkpoint: " << path << " is truncated or does not match this scenario\n";
+        return false;
+    }
+
+    cout << "Checkpoint: restored " << *state.carCount << " vehicles from " << path << "\n";
+    return true;
+}
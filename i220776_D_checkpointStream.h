@@ -0,0 +1,108 @@
+#pragma once
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+using namespace std;
+
+// Binary streams used by checkpoints. Values are written in native byte order, so a
+// checkpoint is only meant to be restored on the machine type that wrote it.
+
+class CheckpointWriter
+{
+    vector<char> buffer;
+
+public:
+    template <typename T>
+    void put(const T &value)
+    {
+        static_assert(is_trivially_copyable<T>::value, "put() only takes plain values");
+        const char *bytes = reinterpret_cast<const char *>(&value);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+    }
+
+    void putBytes(const void *data, size_t length)
+    {
+        const char *bytes = static_cast<const char *>(data);
+        buffer.insert(buffer.end(), bytes, bytes + length);
+    }
+
+    void putString(const string &value)
+    {
+        put<uint32_t>(value.size());
+        putBytes(value.data(), value.size());
+    }
+
+    size_t size() const { return buffer.size(); }
+
+    // Writes everything in one go
+    bool saveToFile(const string &path) const
+    {
+        ofstream file(path, ios::binary | ios::trunc);
+        file.write(buffer.data(), buffer.size());
+        return static_cast<bool>(file);
+    }
+};
+
+class CheckpointReader
+{
+    vector<char> buffer;
+    size_t position = 0;
+    bool failed = false;
+
+public:
+    bool loadFromFile(const string &path)
+    {
+        ifstream file(path, ios::binary | ios::ate);
+        if (!file)
+            return false;
+
+        streamsize length = file.tellg();
+        file.seekg(0);
+        buffer.resize(length);
+        position = 0;
+        failed = !file.read(buffer.data(), length);
+        return !failed;
+    }
+
+    template <typename T>
+    T get()
+    {
+        static_assert(is_trivially_copyable<T>::value, "get() only returns plain values");
+        T value{};
+        getBytes(&value, sizeof(T));
+        return value;
+    }
+
+    void getBytes(void *data, size_t length)
+    {
+        if (failed || buffer.size() - position < length)
+        {
+            failed = true;
+            return;
+        }
+        memcpy(data, buffer.data() + position, length);
+        position += length;
+    }
+
+    string getString()
+    {
+        uint32_t length = get<uint32_t>();
+        if (failed || buffer.size() - position < length)
+        {
+            failed = true;
+            return "";
+        }
+        string value(buffer.data() + position, length);
+        position += length;
+        return value;
+    }
+
+    // True once any read ran past the end of the data
+    bool fail() const { return failed; }
+    bool atEnd() const { return position == buffer.size(); }
+};
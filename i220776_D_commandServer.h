@@ -0,0 +1,338 @@
+#pragma once
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <ctime>
+#include <cstring>
+#include <pthread.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "i220776_D_SmartTraffix.h"
+#include "i220776_D_worldSnapshot.h"
+#include "i220776_D_memoryAccounting.h"
+
+using namespace std;
+
+// Operator commands over a local Unix domain socket.
+// The server runs on its own thread and answers any number of clients (see
+// i220776_D_portalClient.cpp), one text line per command. Lookups and payments go straight to the
+// challan ledger, which locks itself, and the status comes from the published WorldSnapshot, so
+// the simulation keeps running at full rate while an operator works. pause, resume and step
+// only set the flags the simulation thread checks between ticks.
+//
+// Every reply is some lines of text followed by a line starting with "OK" or "ERR".
+
+#define DEFAULT_COMMAND_SOCKET "smarttraffix.sock"
+
+const int COMMAND_POLL_MS = 200;        // How often the server thread checks for stop()
+const int COMMAND_WAIT_MS = 10000;      // Longest a pause or step waits for the simulation thread
+const size_t COMMAND_MAX_LINE = 1024;   // Longer lines drop the client
+
+// Flags shared with the simulation loop in main()
+struct SimulationControls
+{
+    atomic<bool> *pauseRequested;
+    atomic<bool> *simPaused;   // The simulation thread has seen pauseRequested and stopped ticking
+    atomic<int> *stepsRequested; // Ticks to run while paused
+};
+
+class CommandServer
+{
+    struct Client
+    {
+        int fd;
+        string input; // Received bytes not yet ending in a newline
+    };
+
+    UserPortal &portal;
+    const Seqlock<WorldSnapshot> &world;
+    int lightCount;
+    SimulationControls controls;
+    string path;
+    int listenFd;
+    vector<Client> clients;
+    pthread_t thread;
+    atomic<bool> running;
+
+    static void *serverThread(void *arg)
+    {
+        static_cast<CommandServer *>(arg)->serve();
+        return nullptr;
+    }
+
+    static bool sendAll(int fd, const string &text)
+    {
+        size_t sent = 0;
+        while (sent < text.size())
+        {
+            ssize_t written = send(fd, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+            if (written <= 0)
+                return false;
+            sent += written;
+        }
+        return true;
+    }
+
+    // Polls sim until done() or COMMAND_WAIT_MS pass
+    template <typename Done>
+    static bool waitFor(Done done)
+    {
+        for (int waited = 0; waited < COMMAND_WAIT_MS; waited++)
+        {
+            if (done())
+                return true;
+            usleep(1000);
+        }
+        return done();
+    }
+
+    void serve()
+    {
+        while (running)
+        {
+            vector<pollfd> fds;
+            fds.push_back({listenFd, POLLIN, 0});
+            for (const Client &client : clients)
+                fds.push_back({client.fd, POLLIN, 0});
+
+            if (poll(fds.data(), fds.size(), COMMAND_POLL_MS) <= 0)
+                continue;
+
+            if (fds[0].revents & POLLIN)
+            {
+                int fd = accept(listenFd, nullptr, nullptr);
+                if (fd >= 0)
+                    clients.push_back({fd, ""});
+            }
+
+            // Newly accepted clients have no pollfd yet, only the first fds.size() - 1 are checked
+            vector<int> closed;
+            for (size_t i = 1; i < fds.size(); i++)
+            {
+                if (fds[i].revents == 0)
+                    continue;
+                if (!readClient(clients[i - 1]))
+                    closed.push_back(i - 1);
+            }
+            for (size_t i = closed.size(); i-- > 0;)
+            {
+                close(clients[closed[i]].fd);
+                clients.erase(clients.begin() + closed[i]);
+            }
+        }
+    }
+
+    // Runs every complete line the client sent; false when the client is gone or said quit
+    bool readClient(Client &client)
+    {
+        char buffer[512];
+        ssize_t received = recv(client.fd, buffer, sizeof(buffer), 0);
+        if (received <= 0)
+            return false;
+        client.input.append(buffer, received);
+
+        size_t newline;
+        while ((newline = client.input.find('\n')) != string::npos)
+        {
+            string line = client.input.substr(0, newline);
+            client.input.erase(0, newline + 1);
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+
+            ostringstream reply;
+            bool keepOpen = execute(line, reply);
+            if (!sendAll(client.fd, reply.str()) || !keepOpen)
+                return false;
+        }
+        return client.input.size() <= COMMAND_MAX_LINE;
+    }
+
+    // Writes the reply to one command; false when the connection should close
+    bool execute(const string &line, ostream &out)
+    {
+        istringstream in(line);
+        string command;
+        in >> command;
+
+        if (command == "lookup")
+        {
+            string vehicleNumber, issueDateText;
+            if (!(in >> vehicleNumber))
+            {
+                out << "ERR usage: lookup <plate> [YYYY-MM-DD]\n";
+                return true;
+            }
+            time_t issueDate = 0;
+            if (in >> issueDateText)
+            {
+                tm date = {};
+                if (strptime(issueDateText.c_str(), "%Y-%m-%d", &date) == nullptr)
+                {
+                    out << "ERR invalid date, expected YYYY-MM-DD\n";
+                    return true;
+                }
+                issueDate = mktime(&date);
+            }
+            int found = portal.lookup(vehicleNumber, issueDate, out);
+            out << "OK " << found << " challans\n";
+        }
+        else if (command == "pay")
+        {
+            int challanId;
+            string vehicleNumber;
+            float amount;
+            if (!(in >> challanId >> vehicleNumber >> amount))
+            {
+                out << "ERR usage: pay <challan id> <plate> <amount>\n";
+                return true;
+            }
+            out << (portal.pay(challanId, vehicleNumber, amount, out) ? "OK paid\n" : "ERR not paid\n");
+        }
+        else if (command == "pause")
+        {
+            *controls.pauseRequested = true;
+            if (waitFor([&]() { return controls.simPaused->load(); }))
+                out << "OK paused at tick " << world.read().tick << "\n";
+            else
+                out << "ERR the simulation did not pause\n";
+        }
+        else if (command == "resume")
+        {
+            *controls.stepsRequested = 0;
+            *controls.pauseRequested = false;
+            out << "OK resumed\n";
+        }
+        else if (command == "step")
+        {
+            int steps = 1;
+            in >> steps;
+            if (!*controls.pauseRequested)
+                out << "ERR pause first\n";
+            else if (steps < 1)
+                out << "ERR usage: step [ticks]\n";
+            else
+            {
+                *controls.stepsRequested += steps;
+                if (waitFor([&]() { return controls.stepsRequested->load() == 0; }))
+                    out << "OK at tick " << world.read().tick << "\n";
+                else
+                    out << "ERR still stepping\n";
+            }
+        }
+        else if (command == "report")
+        {
+            time_t now = time(nullptr);
+            tm month;
+            localtime_r(&now, &month);
+            string monthText;
+            if (in >> monthText && strptime(monthText.c_str(), "%Y-%m", &month) == nullptr)
+            {
+                out << "ERR usage: report [YYYY-MM]\n";
+                return true;
+            }
+            portal.showReport(month.tm_year + 1900, month.tm_mon + 1, out);
+            out << "OK\n";
+        }
+        else if (command == "status")
+        {
+            portal.showStatus(lightCount, out);
+            out << "OK\n";
+        }
+        else if (command == "memory")
+        {
+            printMemoryReport(out);
+            out << "OK\n";
+        }
+        else if (command == "help")
+        {
+            out << "lookup <plate> [YYYY-MM-DD]   challans of a vehicle\n"
+                << "pay <challan id> <plate> <amount>\n"
+                << "report [YYYY-MM]              challan totals of a month, this one by default\n"
+                << "status                        counters of the last tick\n"
+                << "memory                        live and peak bytes per subsystem\n"
+                << "pause | resume | step [ticks]\n"
+                << "quit\n"
+                << "OK\n";
+        }
+        else if (command == "quit")
+        {
+            out << "OK bye\n";
+            return false;
+        }
+        else if (!command.empty())
+            out << "ERR unknown command " << command << ", try help\n";
+        else
+            out << "OK\n";
+        return true;
+    }
+
+public:
+    CommandServer(UserPortal &portal, const Seqlock<WorldSnapshot> &world, int lightCount, SimulationControls controls)
+        : portal(portal), world(world), lightCount(lightCount), controls(controls), listenFd(-1), running(false) {}
+
+    CommandServer(const CommandServer &) = delete;
+    CommandServer &operator=(const CommandServer &) = delete;
+
+    ~CommandServer()
+    {
+        stop();
+    }
+
+    // Binds socketPath and starts the server thread. A socket file left by a run that is gone
+    // is replaced; one a running simulator still answers on is not.
+    bool start(const string &socketPath)
+    {
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if (socketPath.size() >= sizeof(address.sun_path))
+        {
+            cerr << "Command server: socket path " << socketPath << " is too long\n";
+            return false;
+        }
+        strcpy(address.sun_path, socketPath.c_str());
+
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool inUse = probe >= 0 && connect(probe, (sockaddr *)&address, sizeof(address)) == 0;
+        if (probe >= 0)
+            close(probe);
+        if (inUse)
+        {
+            cerr << "Command server: " << socketPath << " is in use by another simulator\n";
+            return false;
+        }
+        unlink(socketPath.c_str());
+
+        listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listenFd < 0 || bind(listenFd, (sockaddr *)&address, sizeof(address)) != 0 || listen(listenFd, 8) != 0)
+        {
+            cerr << "Command server: cannot listen on " << socketPath << ": " << strerror(errno) << "\n";
+            if (listenFd >= 0)
+                close(listenFd);
+            listenFd = -1;
+            return false;
+        }
+
+        path = socketPath;
+        running = true;
+        pthread_create(&thread, nullptr, serverThread, this);
+        cout << "Command server listening on " << path << "\n";
+        return true;
+    }
+
+    void stop()
+    {
+        if (!running.exchange(false))
+            return;
+        pthread_join(thread, nullptr);
+        for (const Client &client : clients)
+            close(client.fd);
+        clients.clear();
+        close(listenFd);
+        listenFd = -1;
+        unlink(path.c_str());
+    }
+};
@@ -0,0 +1,255 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include "i220776_D_roadtile.h"
+#include "i220776_D_scenario.h"
+#include "i220776_D_trajectory.h"
+#include "i220776_D_vehicleTraits.h"
+
+using namespace std;
+
+// Conflict detection inside the intersection box.
+// Every vehicle whose position lies in a CROSS tile gets a footprint box, its type's length
+// along its heading and width across (VEHICLE_TRAITS). Boxes are sorted by horizontal band (CONFLICT_BAND
+// pixels of y, so a box only ever meets boxes of its own band and the two beside it) and by
+// x within a band. The order is kept from one tick to the next and vehicles only move a few
+// pixels per tick, so an insertion sort restores it in close to linear time. Each band is then
+// swept along x against itself and the band below, and only pairs whose x ranges come within
+// the near-miss gap are measured. Intersecting boxes are an overlap, boxes closer than the gap
+// a near miss. An event is reported when a pair starts to conflict or escalates from near
+// miss to overlap, not again for every tick the conflict lasts.
+
+const float NEAR_MISS_GAP = 8.0f;
+const float MAX_NEAR_MISS_GAP = 32.0f; // Larger gaps would break the band rule below
+const float CONFLICT_BAND = maxVehicleLength() + MAX_NEAR_MISS_GAP; // Taller than any box plus gap
+
+enum tConflictKind
+{
+    CONFLICT_NEAR_MISS = 0,
+    CONFLICT_OVERLAP = 1
+};
+
+struct ConflictEvent
+{
+    uint32_t tick;
+    uint32_t first, second; // Vehicle ids, first < second
+    tConflictKind kind;
+    bool crossing; // The vehicles were heading in different directions
+    float x, y;    // Midpoint between the two vehicles
+    float gap;     // Pixels between the boxes, negative for the depth of an overlap
+};
+
+// Bounds of the scenario's CROSS tiles
+inline vector<sf::FloatRect> intersectionZones(const ScenarioBlob &scenario)
+{
+    vector<sf::FloatRect> zones;
+    for (int i = 0; i < scenario.tileCount; i++)
+    {
+        const ScenarioTile &tile = scenario.tiles[i];
+        if (tile.type == CROSS)
+            zones.push_back(sf::FloatRect(tile.col * TILEWIDTH, tile.row * TILEHEIGHT, TILEWIDTH, TILEHEIGHT));
+    }
+    return zones;
+}
+
+class ConflictDetector
+{
+    struct Box
+    {
+        uint32_t id;
+        int band; // minY / CONFLICT_BAND
+        float minX, maxX, minY, maxY;
+        float dir;
+    };
+
+    vector<sf::FloatRect> zones;
+    float nearMissGap;
+
+    vector<Box> boxes;                   // Sorted by band, then minX
+    unordered_map<uint32_t, int> inZone; // Vehicle id -> index in the frame
+    vector<char> placed;                 // Per frame index: already in boxes
+    unordered_map<uint64_t, tConflictKind> active, nextActive; // Conflicting pairs of the last tick
+    vector<ConflictEvent> events;        // Reported by the last observe()
+
+    uint64_t counts[2][2]; // [kind][crossing]
+    ofstream log;
+
+public:
+    ConflictDetector(const vector<sf::FloatRect> &zones, float nearMissGap = NEAR_MISS_GAP)
+        : zones(zones), nearMissGap(min(nearMissGap, MAX_NEAR_MISS_GAP)), counts() {}
+
+    // Writes every event as a CSV row
+    bool openLog(const string &path)
+    {
+        log.open(path, ios::trunc);
+        if (!log)
+        {
+            cerr << "Conflicts: cannot write " << path << "\n";
+            return false;
+        }
+        log << "tick,kind,first,second,crossing,x,y,gap\n";
+        return true;
+    }
+
+    uint64_t getCount(tConflictKind kind, bool crossing) const { return counts[kind][crossing]; }
+    uint64_t getCount(tConflictKind kind) const { return counts[kind][0] + counts[kind][1]; }
+
+    // Finds the conflicts of one tick; returns the events that started this tick
+    const vector<ConflictEvent> &observe(const TrajectoryFrame &frame)
+    {
+        events.clear();
+
+        inZone.clear();
+        for (size_t i = 0; i < frame.vehicles.size(); i++)
+        {
+            if (insideZone(frame.vehicles[i].x, frame.vehicles[i].y))
+                inZone[frame.vehicles[i].id] = i;
+        }
+
+        // Move the boxes in their previous order and drop vehicles that left, then add the
+        // newcomers at the end
+        placed.assign(frame.vehicles.size(), 0);
+        size_t kept = 0;
+        for (const Box &box : boxes)
+        {
+            auto it = inZone.find(box.id);
+            if (it == inZone.end())
+                continue;
+            boxes[kept++] = boxFor(frame.vehicles[it->second]);
+            placed[it->second] = 1;
+        }
+        boxes.resize(kept);
+        for (size_t i = 0; i < frame.vehicles.size(); i++)
+        {
+            if (!placed[i] && inZone.find(frame.vehicles[i].id) != inZone.end())
+                boxes.push_back(boxFor(frame.vehicles[i]));
+        }
+        insertionSort();
+
+        // Sweep each band against itself and the band below
+        for (size_t start = 0, end; start < boxes.size(); start = end)
+        {
+            end = start;
+            while (end < boxes.size() && boxes[end].band == boxes[start].band)
+                end++;
+            size_t next = end;
+            while (next < boxes.size() && boxes[next].band == boxes[start].band + 1)
+                next++;
+            sweepBand(start, end, frame.tick);
+            sweepBands(start, end, end, next, frame.tick);
+        }
+
+        active.swap(nextActive);
+        nextActive.clear();
+
+        for (const ConflictEvent &event : events)
+        {
+            counts[event.kind][event.crossing]++;
+            if (log.is_open())
+                log << event.tick << "," << (event.kind == CONFLICT_OVERLAP ? "overlap" : "near_miss") << ","
+                    << event.first << "," << event.second << "," << event.crossing << ","
+                    << event.x << "," << event.y << "," << event.gap << "\n";
+        }
+        return events;
+    }
+
+    void printSummary() const
+    {
+        cout << "Conflicts: " << getCount(CONFLICT_OVERLAP) << " overlaps (" << counts[CONFLICT_OVERLAP][1]
+             << " crossing), " << getCount(CONFLICT_NEAR_MISS) << " near misses (" << counts[CONFLICT_NEAR_MISS][1]
+             << " crossing) in the intersection\n";
+    }
+
+private:
+    bool insideZone(float x, float y) const
+    {
+        for (const sf::FloatRect &zone : zones)
+        {
+            if (zone.contains(x, y))
+                return true;
+        }
+        return false;
+    }
+
+    static Box boxFor(const VehicleSample &vehicle)
+    {
+        const VehicleTraits &traits = VEHICLE_TRAITS[vehicle.type];
+        bool vertical = vehicle.dir == 0 || vehicle.dir == 180;
+        float halfX = (vertical ? traits.width : traits.length) / 2;
+        float halfY = (vertical ? traits.length : traits.width) / 2;
+        float minY = vehicle.y - halfY;
+        return {vehicle.id, (int)floor(minY / CONFLICT_BAND), vehicle.x - halfX, vehicle.x + halfX, minY, vehicle.y + halfY, vehicle.dir};
+    }
+
+    static bool before(const Box &a, const Box &b)
+    {
+        return a.band < b.band || (a.band == b.band && a.minX < b.minX);
+    }
+
+    void insertionSort()
+    {
+        for (size_t i = 1; i < boxes.size(); i++)
+        {
+            Box box = boxes[i];
+            size_t j = i;
+            while (j > 0 && before(box, boxes[j - 1]))
+            {
+                boxes[j] = boxes[j - 1];
+                j--;
+            }
+            boxes[j] = box;
+        }
+    }
+
+    // Pairs within boxes[start, end)
+    void sweepBand(size_t start, size_t end, uint32_t tick)
+    {
+        for (size_t i = start; i < end; i++)
+        {
+            for (size_t j = i + 1; j < end && boxes[j].minX < boxes[i].maxX + nearMissGap; j++)
+                measure(boxes[i], boxes[j], tick);
+        }
+    }
+
+    // Pairs between boxes[start, end) and the next band, boxes[next, last)
+    void sweepBands(size_t start, size_t end, size_t next, size_t last, uint32_t tick)
+    {
+        size_t first = next;
+        for (size_t i = start; i < end; i++)
+        {
+            // Both bands are sorted by minX, so the window start only moves forward
+            while (first < last && boxes[first].minX < boxes[i].minX - maxVehicleLength() - nearMissGap)
+                first++;
+            for (size_t j = first; j < last && boxes[j].minX < boxes[i].maxX + nearMissGap; j++)
+                measure(boxes[i], boxes[j], tick);
+        }
+    }
+
+    void measure(const Box &a, const Box &b, uint32_t tick)
+    {
+        float gapX = max(a.minX - b.maxX, b.minX - a.maxX);
+        float gapY = max(a.minY - b.maxY, b.minY - a.maxY);
+        float gap = max(gapX, gapY);
+        if (gap >= nearMissGap)
+            return;
+
+        tConflictKind kind = gap < 0 ? CONFLICT_OVERLAP : CONFLICT_NEAR_MISS;
+        uint32_t first = min(a.id, b.id), second = max(a.id, b.id);
+        uint64_t key = (uint64_t)first << 32 | second;
+        nextActive[key] = kind;
+
+        auto previous = active.find(key);
+        if (previous != active.end() && previous->second >= kind)
+            return; // Already reported
+
+        events.push_back({tick, first, second, kind, a.dir != b.dir,
+                          (a.minX + a.maxX + b.minX + b.maxX) / 4, (a.minY + a.maxY + b.minY + b.maxY) / 4, gap});
+    }
+};
@@ -0,0 +1,189 @@
+#pragma once
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include "i220776_D_car.h"
+#include "i220776_D_SmartTraffix.h"
+#include "i220776_D_scenario.h"
+#include "i220776_D_routes.h"
+
+using namespace std;
+
+// Emergency-vehicle preemption.
+// EmergencyIndex keeps, for every approach (traffic light), the CAR5s heading towards it,
+// updated when they spawn and when they leave the map. Each tick only those vehicles have
+// their distance and ETA to the stop line refreshed, so the cost is O(emergency vehicles).
+// The ETAs go to the light controllers, which raise a priority request once an ambulance is
+// within PREEMPTION_LOOKAHEAD_TICKS of their stop line; PreemptionScheduler then asks
+// SmartTraffix for green on the requesting approach whose ambulance will arrive first.
+
+// Distance covered per tick at speed 1, matches Car::move2
+const float CAR_MOVE_PER_TICK = 0.05f;
+
+struct EmergencyVehicle
+{
+    Car *car;
+    float distance; // Pixels to the stop line, <= 0 once past it
+    float etaTicks; // Ticks until it reaches the stop line at its current speed
+};
+
+class EmergencyIndex
+{
+    const ScenarioBlob &scenario;
+    vector<EmergencyVehicle> approaches[SCENARIO_MAX_LIGHTS];
+
+public:
+    EmergencyIndex(const ScenarioBlob &scenario) : scenario(scenario) {}
+
+    // Registers a newly spawned vehicle; anything other than CAR5 is ignored
+    void add(Car *car)
+    {
+        if (car->getType() != CAR5)
+            return;
+
+        int approach = scenario.lightForDirection(car->getDir());
+        if (approach < 0)
+            return;
+
+        approaches[approach].push_back({car, 0.0f, 0.0f});
+        refresh(approaches[approach].back());
+    }
+
+    // The vehicle left the map
+    void remove(Car *car)
+    {
+        if (car->getType() != CAR5)
+            return;
+
+        for (vector<EmergencyVehicle> &approach : approaches)
+        {
+            for (size_t i = 0; i < approach.size(); i++)
+            {
+                if (approach[i].car == car)
+                {
+                    approach[i] = approach.back();
+                    approach.pop_back();
+                    return;
+                }
+            }
+        }
+    }
+
+    void clear()
+    {
+        for (vector<EmergencyVehicle> &approach : approaches)
+            approach.clear();
+    }
+
+    // Recomputes distance and ETA of every indexed vehicle
+    void refreshAll()
+    {
+        for (vector<EmergencyVehicle> &approach : approaches)
+        {
+            for (EmergencyVehicle &vehicle : approach)
+                refresh(vehicle);
+        }
+    }
+
+    // Closest vehicle on an approach that has not yet reached its stop line, or nullptr
+    const EmergencyVehicle *nextArrival(int approach) const
+    {
+        const EmergencyVehicle *best = nullptr;
+        for (const EmergencyVehicle &vehicle : approaches[approach])
+        {
+            if (vehicle.distance > 0 && (best == nullptr || vehicle.etaTicks < best->etaTicks))
+                best = &vehicle;
+        }
+        return best;
+    }
+
+    const vector<EmergencyVehicle> &vehiclesOn(int approach) const { return approaches[approach]; }
+
+    // ETA of the next arrival on each approach, INFINITY where there is none
+    void arrivalEtas(float etas[], int lightCount) const
+    {
+        for (int approach = 0; approach < lightCount; approach++)
+        {
+            const EmergencyVehicle *next = nextArrival(approach);
+            etas[approach] = next != nullptr ? next->etaTicks : INFINITY;
+        }
+    }
+
+    int size() const
+    {
+        int total = 0;
+        for (const vector<EmergencyVehicle> &approach : approaches)
+            total += approach.size();
+        return total;
+    }
+
+private:
+    void refresh(EmergencyVehicle &vehicle)
+    {
+        float distance;
+        const Route *route = vehicle.car->getRoute();
+        if (route != nullptr)
+        {
+            // Routed cars leave the approach axis once their turn curves, so measure along the route
+            distance = route->stopProgress > 0 ? max(0.0f, route->stopProgress - vehicle.car->getRouteProgress()) : 0.0f;
+        }
+        else if (!scenario.distanceToStopLine(vehicle.car->getX(), vehicle.car->getY(), distance))
+            distance = 0.0f; // Not in a lane with a stop line, nothing to preempt
+        vehicle.distance = distance;
+
+        float perTick = vehicle.car->getSpeed() * CAR_MOVE_PER_TICK;
+        vehicle.etaTicks = perTick > 0 ? distance / perTick : INFINITY;
+    }
+};
+
+// Arbitrates the light controllers' priority requests.
+// The approach holding priority keeps it while its controller still requests it, that is until
+// its ambulance is past the stop line; then the earliest remaining request takes over. With no
+// request left, priority is released and the normal rotation resumes.
+class PreemptionScheduler
+{
+    int holder;
+
+public:
+    PreemptionScheduler() : holder(-1) {}
+
+    void update(SmartTraffix &trafficController, int lightCount)
+    {
+        // SmartTraffix may have timed the priority out on its own
+        if (holder != -1 && trafficController.getCar5PriorityLight() != holder)
+            holder = -1;
+
+        if (holder != -1 && trafficController.priorityRequest(holder) != INFINITY)
+        {
+            trafficController.handleCar5Priority(holder); // Keep holding
+            return;
+        }
+
+        int earliest = -1;
+        float earliestEta = PREEMPTION_LOOKAHEAD_TICKS;
+        for (int approach = 0; approach < lightCount; approach++)
+        {
+            float eta = trafficController.priorityRequest(approach);
+            if (eta != INFINITY && eta <= earliestEta)
+            {
+                earliest = approach;
+                earliestEta = eta;
+            }
+        }
+
+        if (earliest != -1)
+        {
+            if (earliest != holder)
+                cout << "Preempting light " << earliest << " for an ambulance arriving in " << earliestEta << " ticks\n";
+            trafficController.handleCar5Priority(earliest);
+            holder = earliest;
+        }
+        else if (holder != -1)
+        {
+            trafficController.releaseCar5Priority();
+            holder = -1;
+        }
+    }
+
+    int currentHolder() const { return holder; }
+};
@@ -0,0 +1,375 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "i220776_D_roadtile.h"
+#include "i220776_D_trafficlight.h"
+#include "i220776_D_car.h"
+#include "i220776_D_scenario.h"
+#include "i220776_D_trajectory.h"
+#include "i220776_D_memoryAccounting.h"
+
+using namespace std;
+
+// CPU-only frame capture.
+// SoftwareRasterizer draws road tiles, lights and vehicles into a framebuffer in main
+// memory with the same placement rules as the SFML sprites (position, rotation, origin,
+// tint). Assets are decoded with sf::Image, which never touches OpenGL, so this works on
+// machines without a GPU or display. The framebuffer is split into square tiles that worker
+// threads claim one at a time; each tile draws only the sprites overlapping it.
+// Missing image files are replaced by flat placeholders of a typical size.
+
+const int RASTER_TILE_SIZE = 64;
+const int DEFAULT_CAPTURE_THREADS = 4;
+
+enum CaptureFormat
+{
+    CAPTURE_PPM, // One binary PPM per frame in a directory
+    CAPTURE_PNG, // One PNG per frame in a directory
+    CAPTURE_RAW  // All frames appended to one rgb24 stream (ffmpeg -f rawvideo -pix_fmt rgb24)
+};
+
+// Decoded RGBA pixels of one asset
+struct RasterImage
+{
+    int width = 0;
+    int height = 0;
+    vector<uint8_t> rgba;
+
+    void load(const string &path, int fallbackWidth, int fallbackHeight, Color fallback)
+    {
+        sf::Image image;
+        if (!path.empty() && image.loadFromFile(path))
+        {
+            width = image.getSize().x;
+            height = image.getSize().y;
+            const uint8_t *pixels = image.getPixelsPtr();
+            rgba.assign(pixels, pixels + width * height * 4);
+            return;
+        }
+
+        cerr << "Capture: cannot load " << path << ", using a placeholder\n";
+        width = fallbackWidth;
+        height = fallbackHeight;
+        rgba.resize(width * height * 4);
+        for (int i = 0; i < width * height; i++)
+        {
+            rgba[i * 4] = fallback.r;
+            rgba[i * 4 + 1] = fallback.g;
+            rgba[i * 4 + 2] = fallback.b;
+            rgba[i * 4 + 3] = fallback.a;
+        }
+    }
+};
+
+// One placed image, with its screen-space bounding box
+struct RasterSprite
+{
+    const RasterImage *image;
+    float x, y;             // Position
+    float cosR, sinR;       // Rotation
+    float originX, originY; // Local point placed at (x, y)
+    Color tint;
+    int minX, minY, maxX, maxY; // Inclusive-exclusive pixel bounds
+};
+
+class SoftwareRasterizer
+{
+    int width, height;
+    int numThreads;
+    int tilesAcross, tileCount;
+
+    RasterImage tileImages[CROSS + 1];
+    RasterImage lightImages[2];
+    RasterImage vehicleImages[VEHICLE_TYPE_COUNT];
+
+    vector<RasterSprite> roadSprites; // Fixed for a scenario
+    vector<RasterSprite> sprites;     // Rebuilt every frame, drawn in order
+    vector<uint8_t> framebuffer;      // RGB, width * height * 3
+    atomic<int> nextTile;
+
+public:
+    SoftwareRasterizer(const ScenarioBlob &scenario, int numThreads = DEFAULT_CAPTURE_THREADS)
+        : width(scenario.windowWidth), height(scenario.windowHeight), numThreads(max(1, numThreads)), nextTile(0)
+    {
+        tilesAcross = (width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+        tileCount = tilesAcross * ((height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE);
+        framebuffer.resize(width * height * 3);
+
+        for (int i = 0; i < scenario.tileCount; i++)
+        {
+            const ScenarioTile &tile = scenario.tiles[i];
+            if (tile.type == NONE)
+                continue;
+            RasterImage &image = tileImages[tile.type];
+            if (image.rgba.empty())
+                image.load(roadTileImagePath(static_cast<tRoadTileType>(tile.type)), TILEWIDTH, TILEHEIGHT, Color(90, 90, 90));
+            roadSprites.push_back(place(image, tile.col * TILEWIDTH, tile.row * TILEHEIGHT, 0, 0, 0, Color::White));
+        }
+
+        lightImages[GREEN].load(TrafficLight::imagePathFor(GREEN), 20, 50, Color(0, 200, 0));
+        lightImages[RED].load(TrafficLight::imagePathFor(RED), 20, 50, Color(220, 0, 0));
+        for (int type = CAR1; type <= CAR7; type++)
+        {
+            const VehicleTraits &traits = traitsOf(static_cast<tVehicleType>(type));
+            vehicleImages[type].load(traits.imagePath, traits.textureLength, traits.textureWidth, Color(40, 60, 160));
+        }
+    }
+
+    SoftwareRasterizer(const SoftwareRasterizer &) = delete;
+    SoftwareRasterizer &operator=(const SoftwareRasterizer &) = delete;
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+    // Draws frame over a white background; lights come from the scenario, their states from the frame
+    const vector<uint8_t> &render(const TrajectoryFrame &frame, const ScenarioBlob &scenario)
+    {
+        sprites = roadSprites;
+        for (int i = 0; i < scenario.lightCount; i++)
+        {
+            const ScenarioLight &light = scenario.lights[i];
+            tLightState state = i < (int)frame.lightCount ? static_cast<tLightState>((frame.lightStates >> i) & 1)
+                                                          : static_cast<tLightState>(light.state);
+            sprites.push_back(place(lightImages[state], light.x, light.y, light.rotation, 0, 0, Color::White));
+        }
+        for (const VehicleSample &vehicle : frame.vehicles)
+        {
+            const RasterImage &image = vehicleImages[vehicle.type];
+            // Car::draw puts the origin at a sixth of the image and tints broken cars red
+            sprites.push_back(place(image, vehicle.x, vehicle.y, Car::spriteRotationFor(vehicle.dir),
+                                    image.width / 6.0f, image.height / 6.0f,
+                                    vehicle.broken ? Color::Red : Color::White));
+        }
+
+        nextTile = 0;
+        vector<pthread_t> threads(numThreads - 1);
+        for (pthread_t &thread : threads)
+            pthread_create(&thread, nullptr, renderTilesThread, this);
+        renderTiles();
+        for (pthread_t &thread : threads)
+            pthread_join(thread, nullptr);
+
+        return framebuffer;
+    }
+
+private:
+    RasterSprite place(const RasterImage &image, float x, float y, float rotation, float originX, float originY, Color tint) const
+    {
+        RasterSprite sprite;
+        sprite.image = &image;
+        sprite.x = x;
+        sprite.y = y;
+        float radians = rotation * 3.14159265f / 180.0f;
+        sprite.cosR = cos(radians);
+        sprite.sinR = sin(radians);
+        sprite.originX = originX;
+        sprite.originY = originY;
+        sprite.tint = tint;
+
+        // Bounding box of the four transformed corners
+        float minX = INFINITY, minY = INFINITY, maxX = -INFINITY, maxY = -INFINITY;
+        const float corners[4][2] = {{0, 0}, {(float)image.width, 0}, {0, (float)image.height}, {(float)image.width, (float)image.height}};
+        for (const float *corner : corners)
+        {
+            float lx = corner[0] - originX;
+            float ly = corner[1] - originY;
+            float wx = x + sprite.cosR * lx - sprite.sinR * ly;
+            float wy = y + sprite.sinR * lx + sprite.cosR * ly;
+            minX = min(minX, wx);
+            minY = min(minY, wy);
+            maxX = max(maxX, wx);
+            maxY = max(maxY, wy);
+        }
+        sprite.minX = max(0, (int)floor(minX));
+        sprite.minY = max(0, (int)floor(minY));
+        sprite.maxX = min(width, (int)ceil(maxX));
+        sprite.maxY = min(height, (int)ceil(maxY));
+        return sprite;
+    }
+
+    static void *renderTilesThread(void *rasterizer)
+    {
+        MemoryScope scope(MEMORY_RENDERING);
+        static_cast<SoftwareRasterizer *>(rasterizer)->renderTiles();
+        return nullptr;
+    }
+
+    // Claims tiles until none are left
+    void renderTiles()
+    {
+        for (int tile = nextTile++; tile < tileCount; tile = nextTile++)
+        {
+            int x0 = (tile % tilesAcross) * RASTER_TILE_SIZE;
+            int y0 = (tile / tilesAcross) * RASTER_TILE_SIZE;
+            int x1 = min(width, x0 + RASTER_TILE_SIZE);
+            int y1 = min(height, y0 + RASTER_TILE_SIZE);
+
+            for (int y = y0; y < y1; y++)
+                memset(&framebuffer[(y * width + x0) * 3], 255, (x1 - x0) * 3);
+
+            for (const RasterSprite &sprite : sprites)
+            {
+                if (sprite.maxX > x0 && sprite.minX < x1 && sprite.maxY > y0 && sprite.minY < y1)
+                    drawSprite(sprite, max(x0, sprite.minX), max(y0, sprite.minY), min(x1, sprite.maxX), min(y1, sprite.maxY));
+            }
+        }
+    }
+
+    // Inverse-maps every pixel centre in the rectangle into the image (nearest texel) and blends it
+    void drawSprite(const RasterSprite &sprite, int x0, int y0, int x1, int y1)
+    {
+        const RasterImage &image = *sprite.image;
+        for (int y = y0; y < y1; y++)
+        {
+            uint8_t *out = &framebuffer[(y * width + x0) * 3];
+            for (int x = x0; x < x1; x++, out += 3)
+            {
+                float dx = x + 0.5f - sprite.x;
+                float dy = y + 0.5f - sprite.y;
+                int u = (int)floor(sprite.cosR * dx + sprite.sinR * dy + sprite.originX);
+                int v = (int)floor(-sprite.sinR * dx + sprite.cosR * dy + sprite.originY);
+                if (u < 0 || v < 0 || u >= image.width || v >= image.height)
+                    continue;
+
+                const uint8_t *texel = &image.rgba[(v * image.width + u) * 4];
+                int alpha = texel[3] * sprite.tint.a / 255;
+                if (alpha == 0)
+                    continue;
+                int r = texel[0] * sprite.tint.r / 255;
+                int g = texel[1] * sprite.tint.g / 255;
+                int b = texel[2] * sprite.tint.b / 255;
+                out[0] = out[0] + (r - out[0]) * alpha / 255;
+                out[1] = out[1] + (g - out[1]) * alpha / 255;
+                out[2] = out[2] + (b - out[2]) * alpha / 255;
+            }
+        }
+    }
+};
+
+// Renders every interval-th tick and writes it out in the chosen format
+class FrameCapture
+{
+    const ScenarioBlob &scenario;
+    SoftwareRasterizer rasterizer;
+    CaptureFormat format;
+    string path;
+    unsigned interval;
+    ofstream rawStream;
+    unsigned framesWritten;
+    bool opened;
+
+public:
+    FrameCapture(const ScenarioBlob &scenario, int numThreads = DEFAULT_CAPTURE_THREADS)
+        : scenario(scenario), rasterizer(scenario, numThreads), format(CAPTURE_PPM), interval(1), framesWritten(0), opened(false) {}
+
+    // path is a directory for PPM/PNG (created if missing) or a file for the raw stream
+    bool open(const string &capturePath, CaptureFormat captureFormat, unsigned captureInterval)
+    {
+        path = capturePath;
+        format = captureFormat;
+        interval = max(1u, captureInterval);
+
+        if (format == CAPTURE_RAW)
+        {
+            rawStream.open(path, ios::binary | ios::trunc);
+            if (!rawStream)
+            {
+                cerr << "Capture: cannot write " << path << "\n";
+                return false;
+            }
+        }
+        else if (mkdir(path.c_str(), 0755) != 0 && errno != EEXIST)
+        {
+            cerr << "Capture: cannot create directory " << path << "\n";
+            return false;
+        }
+
+        opened = true;
+        cout << "Capture: " << rasterizer.getWidth() << "x" << rasterizer.getHeight() << " every " << interval
+             << " ticks to " << path << "\n";
+        return true;
+    }
+
+    bool isOpen() const { return opened; }
+
+    void capture(const TrajectoryFrame &frame)
+    {
+        if (!opened || frame.tick % interval != 0)
+            return;
+
+        const vector<uint8_t> &pixels = rasterizer.render(frame, scenario);
+        int width = rasterizer.getWidth();
+        int height = rasterizer.getHeight();
+
+        if (format == CAPTURE_RAW)
+        {
+            rawStream.write(reinterpret_cast<const char *>(pixels.data()), pixels.size());
+        }
+        else
+        {
+            char name[32];
+            snprintf(name, sizeof(name), "/frame_%08u.%s", frame.tick, format == CAPTURE_PNG ? "png" : "ppm");
+            string file = path + name;
+            bool ok;
+            if (format == CAPTURE_PNG)
+            {
+                vector<uint8_t> rgba(width * height * 4, 255);
+                for (int i = 0; i < width * height; i++)
+                    memcpy(&rgba[i * 4], &pixels[i * 3], 3);
+                sf::Image image;
+                image.create(width, height, rgba.data());
+                ok = image.saveToFile(file);
+            }
+            else
+            {
+                ofstream out(file, ios::binary | ios::trunc);
+                out << "P6\n"
+                    << width << " " << height << "\n255\n";
+                out.write(reinterpret_cast<const char *>(pixels.data()), pixels.size());
+                ok = static_cast<bool>(out);
+            }
+            if (!ok)
+                cerr << "Capture: cannot write " << file << "\n";
+        }
+        framesWritten++;
+    }
+
+    void close()
+    {
+        if (!opened)
+            return;
+        rawStream.close();
+        opened = false;
+        cout << "Capture: wrote " << framesWritten << " frames to " << path << "\n";
+    }
+
+    ~FrameCapture() { close(); }
+};
+
+// "ppm", "png" or "raw"
+bool parseCaptureFormat(const string &text, CaptureFormat &format)
+{
+    if (text == "ppm")
+        format = CAPTURE_PPM;
+    else if (text == "png")
+        format = CAPTURE_PNG;
+    else if (text == "raw")
+        format = CAPTURE_RAW;
+    else
+    {
+        cerr << "Unknown capture format '" << text << "', expected ppm, png or raw\n";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,225 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <pthread.h>
+#include "i220776_D_roadtile.h"
+#include "i220776_D_scenario.h"
+#include "i220776_D_trajectory.h"
+#include "i220776_D_memoryAccounting.h"
+
+using namespace std;
+
+// Occupancy heatmap.
+// Every tick the vehicles of a snapshot are binned into a grid aligned to the road tiles,
+// subdivision x subdivision cells per tile. Threads bin slices of the vehicle list into their
+// own partial grids, which are then summed, so no cell is ever shared between threads.
+// Two maps accumulate over the run:
+//   occupancy - mean number of vehicles in the cell per tick
+//   dwell     - mean ticks a vehicle stays in the cell per visit (a visit starts when a
+//               vehicle is first seen in the cell)
+// Both are written as CSV grids so long runs can be searched for hotspots without keeping
+// trajectories around.
+
+const int DEFAULT_HEATMAP_SUBDIVISION = 4;
+const int DEFAULT_HEATMAP_THREADS = 4;
+
+class OccupancyHeatmap
+{
+    struct Slice
+    {
+        OccupancyHeatmap *heatmap;
+        const TrajectoryFrame *frame;
+        int begin, end;
+        vector<uint32_t> counts;  // Vehicles per cell this tick
+        vector<uint32_t> entries; // Visits starting this tick
+    };
+
+    float cellWidth, cellHeight;
+    int cols, rows;
+    int numThreads;
+    vector<Slice> slices;
+
+    vector<int> cellOf;                 // Cell of each vehicle of the current frame, -1 off the map
+    vector<pair<uint32_t, int>> seen;   // (vehicle id, cell) of the previous frame, sorted by id
+    vector<pair<uint32_t, int>> seenNext;
+
+    vector<uint64_t> occupancySum; // Vehicle-ticks per cell
+    vector<uint64_t> visitCount;   // Visits per cell
+    uint64_t ticks;
+
+public:
+    OccupancyHeatmap(const ScenarioBlob &scenario, int subdivision = DEFAULT_HEATMAP_SUBDIVISION, int numThreads = DEFAULT_HEATMAP_THREADS)
+        : numThreads(max(1, numThreads)), ticks(0)
+    {
+        subdivision = max(1, subdivision);
+        cellWidth = (float)TILEWIDTH / subdivision;
+        cellHeight = (float)TILEHEIGHT / subdivision;
+        cols = (int)ceil(scenario.windowWidth / cellWidth);
+        rows = (int)ceil(scenario.windowHeight / cellHeight);
+
+        slices.resize(this->numThreads);
+        for (Slice &slice : slices)
+        {
+            slice.heatmap = this;
+            slice.counts.assign(cols * rows, 0);
+            slice.entries.assign(cols * rows, 0);
+        }
+        occupancySum.assign(cols * rows, 0);
+        visitCount.assign(cols * rows, 0);
+    }
+
+    int getCols() const { return cols; }
+    int getRows() const { return rows; }
+    float getCellWidth() const { return cellWidth; }
+    float getCellHeight() const { return cellHeight; }
+    uint64_t getTicks() const { return ticks; }
+
+    // Bins one tick of vehicles
+    void accumulate(const TrajectoryFrame &frame)
+    {
+        int count = frame.vehicles.size();
+        cellOf.resize(count);
+
+        int perThread = count / numThreads;
+        vector<pthread_t> threads(numThreads);
+        for (int i = 0; i < numThreads; i++)
+        {
+            slices[i].frame = &frame;
+            slices[i].begin = i * perThread;
+            slices[i].end = (i == numThreads - 1) ? count : (i + 1) * perThread;
+            pthread_create(&threads[i], nullptr, binSliceThread, &slices[i]);
+        }
+        for (int i = 0; i < numThreads; i++)
+        {
+            pthread_join(threads[i], nullptr);
+        }
+
+        // Reduce the partial grids
+        for (Slice &slice : slices)
+        {
+            for (int cell = 0; cell < cols * rows; cell++)
+            {
+                occupancySum[cell] += slice.counts[cell];
+                visitCount[cell] += slice.entries[cell];
+            }
+        }
+        ticks++;
+
+        // Remember where each vehicle was for the next tick's visit detection
+        seenNext.clear();
+        for (int i = 0; i < count; i++)
+        {
+            seenNext.push_back({frame.vehicles[i].id, cellOf[i]});
+        }
+        if (!is_sorted(seenNext.begin(), seenNext.end()))
+            sort(seenNext.begin(), seenNext.end());
+        seen.swap(seenNext);
+    }
+
+    // Mean vehicles per tick in a cell
+    float occupancy(int cell) const { return ticks == 0 ? 0.0f : (float)occupancySum[cell] / ticks; }
+
+    // Mean ticks per visit in a cell
+    float dwell(int cell) const { return visitCount[cell] == 0 ? 0.0f : (float)occupancySum[cell] / visitCount[cell]; }
+
+    // Writes <prefix>_occupancy.csv and <prefix>_dwell.csv, one grid row per line.
+    // Dwell is converted to seconds with the given tick length.
+    bool exportCsv(const string &prefix, float secondsPerTick) const
+    {
+        ofstream occupancyFile(prefix + "_occupancy.csv");
+        ofstream dwellFile(prefix + "_dwell.csv");
+        if (!occupancyFile || !dwellFile)
+        {
+            cerr << "Heatmap: cannot write " << prefix << "_*.csv\n";
+            return false;
+        }
+
+        occupancyFile << "# mean vehicles per tick, " << cols << "x" << rows << " cells of "
+                      << cellWidth << "x" << cellHeight << " px over " << ticks << " ticks\n";
+        dwellFile << "# mean seconds per visit, " << cols << "x" << rows << " cells of "
+                  << cellWidth << "x" << cellHeight << " px over " << ticks << " ticks\n";
+        for (int row = 0; row < rows; row++)
+        {
+            for (int col = 0; col < cols; col++)
+            {
+                int cell = row * cols + col;
+                const char *separator = col + 1 < cols ? "," : "\n";
+                occupancyFile << occupancy(cell) << separator;
+                dwellFile << dwell(cell) * secondsPerTick << separator;
+            }
+        }
+
+        cout << "Heatmap: wrote " << prefix << "_occupancy.csv and " << prefix << "_dwell.csv\n";
+        return static_cast<bool>(occupancyFile) && static_cast<bool>(dwellFile);
+    }
+
+    // Copies the running-average occupancy, row-major, for drawing on another thread
+    void snapshotOccupancy(vector<float> &out) const
+    {
+        out.resize(cols * rows);
+        for (int cell = 0; cell < cols * rows; cell++)
+            out[cell] = occupancy(cell);
+    }
+
+private:
+    static void *binSliceThread(void *args)
+    {
+        Slice *slice = static_cast<Slice *>(args);
+        MemoryScope scope(MEMORY_ANALYTICS);
+        slice->heatmap->binSlice(*slice);
+        return nullptr;
+    }
+
+    void binSlice(Slice &slice)
+    {
+        fill(slice.counts.begin(), slice.counts.end(), 0);
+        fill(slice.entries.begin(), slice.entries.end(), 0);
+
+        for (int i = slice.begin; i < slice.end; i++)
+        {
+            const VehicleSample &vehicle = slice.frame->vehicles[i];
+            int col = (int)floor(vehicle.x / cellWidth);
+            int row = (int)floor(vehicle.y / cellHeight);
+            if (col < 0 || row < 0 || col >= cols || row >= rows)
+            {
+                cellOf[i] = -1;
+                continue;
+            }
+
+            int cell = row * cols + col;
+            cellOf[i] = cell;
+            slice.counts[cell]++;
+
+            // A visit starts when the vehicle was elsewhere (or absent) last tick
+            auto previous = lower_bound(seen.begin(), seen.end(), make_pair(vehicle.id, INT32_MIN));
+            if (previous == seen.end() || previous->first != vehicle.id || previous->second != cell)
+                slice.entries[cell]++;
+        }
+    }
+};
+
+// Draws per-cell occupancy as translucent red, scaled to the busiest cell
+inline void drawHeatmapOverlay(RenderWindow &window, const vector<float> &occupancy, int cols, float cellWidth, float cellHeight)
+{
+    if (occupancy.empty())
+        return;
+
+    float busiest = *max_element(occupancy.begin(), occupancy.end());
+    if (busiest <= 0)
+        return;
+
+    RectangleShape cellShape(Vector2f(cellWidth, cellHeight));
+    for (size_t cell = 0; cell < occupancy.size(); cell++)
+    {
+        if (occupancy[cell] <= 0)
+            continue;
+        cellShape.setPosition((cell % cols) * cellWidth, (cell / cols) * cellHeight);
+        cellShape.setFillColor(Color(255, 0, 0, (Uint8)(40 + 160 * occupancy[cell] / busiest)));
+        window.draw(cellShape);
+    }
+}
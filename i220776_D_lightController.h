@@ -0,0 +1,292 @@
+#pragma once
+#include <iostream>
+#include <atomic>
+#include <cmath>
+#include <climits>
+#include <cstdint>
+#include <ctime>
+#include <new>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <linux/futex.h>
+#include "i220776_D_scenario.h"
+#include "i220776_D_signalPlan.h"
+#include "i220776_D_simTick.h"
+
+using namespace std;
+
+// Per-light controller processes.
+// Every light of the intersection has a child process that makes that light's own decisions:
+// actuation (is anyone still coming on the green, is anyone waiting at the red), ambulance
+// priority requests and the starvation check. The simulation talks to them through one shared
+// anonymous mapping with a mailbox per light: at the end of a tick it posts each light's
+// detector counts and wakes the child with a futex, then goes on with the next tick's spawning
+// and the frame capture while the children decide. SmartTraffix::update collects the decisions,
+// sleeping on a second futex only if a child is not done yet.
+//
+// decideLight is a pure function of the posted input, so when a child dies or stops answering
+// the simulation evaluates it in-process for that light and the run carries on exactly as it
+// would have, only without the parallelism. Batch runs (replicas, the timing optimizer) ask for
+// that from the start: a decision costs far less than the round trip to a child, and a batch
+// already keeps every core busy with whole runs.
+
+// Ticks of lookahead: an ambulance expected at its stop line within this many ticks gets green
+const float PREEMPTION_LOOKAHEAD_TICKS = 300.0f;
+const float MIN_GREEN_SECONDS = 3.0f;  // A green is never cut short before this
+const int CONTROLLER_TIMEOUT_MS = 500; // A child that takes longer is given up on
+
+// Filled by updateCars, one entry per light
+struct DetectorCounts
+{
+    int approaching[SCENARIO_MAX_LIGHTS]; // Vehicles on the approach that have not passed its stop line
+    int waiting[SCENARIO_MAX_LIGHTS];     // Of those, held by the light this tick
+};
+
+struct LightInput
+{
+    uint32_t tick;
+    SignalWord signals;
+    uint32_t sinceChange; // Ticks since this light last changed colour
+    uint32_t minGreen;    // Ticks a green lasts before it may gap out
+    uint32_t maxRed;      // Ticks of red with vehicles waiting before the light counts as starved
+    int32_t approaching;
+    int32_t waiting;
+    float emergencyEta; // Ticks until the next CAR5 on the approach reaches the stop line, INFINITY for none
+};
+
+struct LightDecision
+{
+    uint32_t tick;     // Tick of the input it answers
+    bool demand;       // Red with vehicles waiting for it
+    bool gapOut;       // Green for at least minGreen with nobody left to serve
+    bool starved;      // Red for longer than maxRed with vehicles waiting
+    float priorityEta; // Priority request: ETA of an ambulance inside the lookahead, INFINITY for none
+};
+
+// A light's decision for one tick; runs in the light's child, or in-process as the fallback
+inline LightDecision decideLight(const LightInput &input, int light)
+{
+    LightDecision decision;
+    decision.tick = input.tick;
+    bool green = signalLight(input.signals, light) == GREEN;
+    decision.demand = !green && input.waiting > 0;
+    decision.gapOut = green && input.sinceChange >= input.minGreen && input.approaching == 0;
+    decision.starved = decision.demand && input.sinceChange > input.maxRed;
+    decision.priorityEta = input.emergencyEta <= PREEMPTION_LOOKAHEAD_TICKS ? input.emergencyEta : INFINITY;
+    return decision;
+}
+
+static_assert(sizeof(atomic<uint32_t>) == sizeof(uint32_t) && atomic<uint32_t>::is_always_lock_free,
+              "futex words must be plain lock-free 32-bit atomics");
+
+// Shared futexes (no FUTEX_PRIVATE_FLAG): the words live in a mapping shared across fork
+inline void futexWait(atomic<uint32_t> &word, uint32_t expected, const timespec *timeout)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAIT, expected, timeout, nullptr, 0);
+}
+
+inline void futexWake(atomic<uint32_t> &word)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+// One light's slot in the shared mapping, on its own cache line
+struct alignas(64) LightMailbox
+{
+    atomic<uint32_t> posted;   // Sequence of the last input; the child sleeps on it
+    atomic<uint32_t> answered; // Sequence of the last decision; the simulation sleeps on it
+    atomic<uint32_t> stop;
+    LightInput input;
+    LightDecision decision;
+};
+
+class LightControllers
+{
+    LightMailbox *mailboxes; // Shared mapping, one per light
+    int lightCount;
+    pid_t pids[SCENARIO_MAX_LIGHTS]; // 0 once a light is decided in-process
+    uint32_t sequence;               // Of the last post
+    bool awaiting;                   // Decisions for the last post not collected yet
+    LightInput inputs[SCENARIO_MAX_LIGHTS];
+    LightDecision decisions[SCENARIO_MAX_LIGHTS];
+
+    // Body of a light's child: answer every post until told to stop
+    [[noreturn]] static void controllerMain(LightMailbox &mailbox, int light)
+    {
+        prctl(PR_SET_PDEATHSIG, SIGKILL); // Never outlive the simulation
+        uint32_t seen = 0; // Not the current value: the first post may already be there
+        while (true)
+        {
+            uint32_t current;
+            while ((current = mailbox.posted.load(memory_order_acquire)) == seen)
+                futexWait(mailbox.posted, seen, nullptr);
+            if (mailbox.stop.load(memory_order_acquire))
+                _exit(0);
+
+            mailbox.decision = decideLight(mailbox.input, light);
+            mailbox.answered.store(current, memory_order_release);
+            futexWake(mailbox.answered);
+            seen = current;
+        }
+    }
+
+    // The light's child is gone or hung; from now on its decisions are made here
+    void abandon(int light, const char *reason)
+    {
+        cerr << "Light controller " << light << " " << reason << ", deciding it in-process\n";
+        kill(pids[light], SIGKILL);
+        waitpid(pids[light], nullptr, 0);
+        pids[light] = 0;
+    }
+
+    // Waits for the child's answer to the last post; false when it never comes
+    bool awaitAnswer(int light)
+    {
+        LightMailbox &mailbox = mailboxes[light];
+        timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += CONTROLLER_TIMEOUT_MS / 1000;
+        deadline.tv_nsec += (CONTROLLER_TIMEOUT_MS % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+
+        uint32_t answered;
+        while ((answered = mailbox.answered.load(memory_order_acquire)) != sequence)
+        {
+            if (waitpid(pids[light], nullptr, WNOHANG) == pids[light])
+            {
+                pids[light] = 0;
+                cerr << "Light controller " << light << " exited, deciding it in-process\n";
+                return false;
+            }
+            timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            long remainingNs = (deadline.tv_sec - now.tv_sec) * 1000000000L + (deadline.tv_nsec - now.tv_nsec);
+            if (remainingNs <= 0)
+            {
+                abandon(light, "stopped answering");
+                return false;
+            }
+            // Short slices, so a child that dies mid-wait is noticed without the full timeout
+            timespec slice = {0, min(remainingNs, 10000000L)};
+            futexWait(mailbox.answered, answered, &slice);
+        }
+        return true;
+    }
+
+public:
+    // Without processes every light is decided in-process and nothing is mapped or forked
+    LightControllers(int count, bool processes = true) : mailboxes(nullptr), lightCount(count), pids(), sequence(0), awaiting(false)
+    {
+        for (int i = 0; i < SCENARIO_MAX_LIGHTS; i++)
+            decisions[i] = {0, false, false, false, INFINITY};
+        if (!processes)
+            return;
+
+        void *mapped = mmap(nullptr, sizeof(LightMailbox) * lightCount, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (mapped == MAP_FAILED)
+        {
+            cerr << "Light controllers: cannot map the mailboxes, deciding every light in-process\n";
+            return;
+        }
+        mailboxes = static_cast<LightMailbox *>(mapped);
+        memoryAccount(MEMORY_CONTROLLER, sizeof(LightMailbox) * lightCount);
+        for (int i = 0; i < lightCount; i++)
+            new (&mailboxes[i]) LightMailbox();
+
+        for (int i = 0; i < lightCount; i++)
+        {
+            pid_t pid = fork();
+            if (pid < 0)
+            {
+                cerr << "Fork failed for light " << i << ", deciding it in-process\n";
+                continue;
+            }
+            if (pid == 0)
+                controllerMain(mailboxes[i], i);
+            pids[i] = pid;
+        }
+    }
+
+    LightControllers(const LightControllers &) = delete;
+    LightControllers &operator=(const LightControllers &) = delete;
+
+    ~LightControllers()
+    {
+        for (int i = 0; i < lightCount; i++)
+        {
+            if (pids[i] == 0)
+                continue;
+            mailboxes[i].stop.store(1, memory_order_release);
+            mailboxes[i].posted.fetch_add(1, memory_order_acq_rel);
+            futexWake(mailboxes[i].posted);
+        }
+        for (int i = 0; i < lightCount; i++)
+        {
+            if (pids[i] != 0)
+                waitpid(pids[i], nullptr, 0);
+        }
+        if (mailboxes != nullptr)
+        {
+            munmap(mailboxes, sizeof(LightMailbox) * lightCount);
+            memoryRelease(MEMORY_CONTROLLER, sizeof(LightMailbox) * lightCount);
+        }
+    }
+
+    // Hands one input per light to the controllers; the decisions are picked up by collect()
+    void post(const LightInput lightInputs[])
+    {
+        if (awaiting)
+            collect(); // Never overwrite an input a child may still be reading
+
+        sequence++;
+        for (int i = 0; i < lightCount; i++)
+        {
+            inputs[i] = lightInputs[i];
+            if (pids[i] == 0)
+                continue;
+            mailboxes[i].input = inputs[i];
+            mailboxes[i].posted.store(sequence, memory_order_release);
+            futexWake(mailboxes[i].posted);
+        }
+        awaiting = true;
+    }
+
+    // Decisions for the last post, one per light; the same array until the next post
+    const LightDecision *collect()
+    {
+        if (!awaiting)
+            return decisions;
+
+        for (int i = 0; i < lightCount; i++)
+        {
+            if (pids[i] != 0 && awaitAnswer(i))
+                decisions[i] = mailboxes[i].decision;
+            else
+                decisions[i] = decideLight(inputs[i], i);
+        }
+        awaiting = false;
+        return decisions;
+    }
+
+    // Checkpoint support: an uncollected post is stored as its inputs and posted again on load,
+    // so the restored run gets the decisions the saved one was about to receive
+    bool hasPending() const { return awaiting; }
+    const LightInput *pendingInputs() const { return inputs; }
+
+    int running() const
+    {
+        int count = 0;
+        for (int i = 0; i < lightCount; i++)
+            count += pids[i] != 0;
+        return count;
+    }
+};
@@ -15,6 +15,25 @@
 #include <sys/time.h>
 #include "i220776_D_carBreakDown.h"
 #include "i220776_D_spawnCars.h"
+#include "i220776_D_scenario.h"
+#include "i220776_D_trajectory.h"
+#include "i220776_D_checkpoint.h"
+#include "i220776_D_emergency.h"
+#include "i220776_D_simClock.h"
+#include "i220776_D_snapshot.h"
+#include "i220776_D_frameCapture.h"
+#include "i220776_D_heatmap.h"
+#include "i220776_D_conflicts.h"
+#include "i220776_D_routes.h"
+#include "i220776_D_simulation.h"
+#include "i220776_D_replicas.h"
+#include "i220776_D_timingOptimizer.h"
+#include "i220776_D_commandServer.h"
+#include "i220776_D_memoryAccounting.h"
+#include <csignal>
+#include <atomic>
+#include <functional>
+#include <thread>
 
 #define WIDTH 1200
 #define HEIGHT 1200
@@ -27,264 +46,408 @@
 using namespace std;
 using namespace sf;
 
-float INITIAL_LANE_SPEEDS[] = {
-    6.0f, // North lane
-    6.0f, // South lane
-    6.0f, // East lane
-    6.0f  // West lane
-};
+// Compiled scenario loaded when no path is given on the command line
+#define DEFAULT_SCENARIO_PATH "scenarios/default.bin"
 
-// Function to check if current time is during peak hours
-bool isPeakHour()
+// The simulation ticks on its own thread, paced to SIM_TICK_SECONDS of wall time per tick when
+// there is a window (or --realtime) and back to back otherwise; the window redraws at display rate
+const unsigned RENDER_FRAME_RATE = 60;
+
+// pthread entry point running a std::function
+void *runFunction(void *function)
 {
-    time_t now = time(0);
-    tm *ltm = localtime(&now);
+    (*static_cast<std::function<void()> *>(function))();
+    return nullptr;
+}
 
-    // Morning peak hours: 7:00 AM to 9:30 AM
-    if ((ltm->tm_hour == 7 && ltm->tm_min >= 0) ||
-        (ltm->tm_hour == 8) ||
-        (ltm->tm_hour == 9 && ltm->tm_min <= 30))
+// Set by Ctrl+C in headless runs so the simulation thread can stop and flush its output
+atomic<bool> interrupted(false);
+void onInterrupt(int) { interrupted = true; }
+
+// Checkpoint written when C is pressed, unless --checkpoint names another file
+#define DEFAULT_CHECKPOINT_PATH "checkpoint.stx"
+
+// Usage: smarttraffix [scenario.bin] [--record run.trj] [--replay run.trj] [--replay-speed factor]
+//                     [--restore checkpoint.stx] [--checkpoint checkpoint.stx]
+//                     [--start HH:MM] [--warp factor] [--headless] [--realtime] [--ticks N]
+//                     [--capture dir|file] [--capture-format ppm|png|raw] [--capture-every N] [--capture-threads N]
+//                     [--heatmap prefix] [--heatmap-cells N] [--heatmap-threads N] [--heatmap-overlay]
+//                     [--seed N] [--replicas N] [--replica-jobs N] [--replica-csv file]
+//                     [--optimize-timing out.txt] [--optimize-generations N] [--optimize-population N]
+//                     [--optimize-seeds N] [--timing-cache file] [--conflicts events.csv]
+//                     [--socket path] [--no-socket]
+int main(int argc, char *argv[])
+{
+    string scenarioPath = DEFAULT_SCENARIO_PATH;
+    bool scenarioGiven = false;
+    string recordPath, replayPath;
+    float replaySpeed = 1.0f;
+    string restorePath;
+    string checkpointPath = DEFAULT_CHECKPOINT_PATH;
+    double startTime = SimClock::localTimeOfDay();
+    float timeWarp = DEFAULT_TIME_WARP;
+    bool headless = false;
+    bool realtime = false; // Pace headless runs like windowed ones
+    unsigned maxTicks = 0; // 0 runs until the window is closed (or Ctrl+C when headless)
+    string capturePath;
+    CaptureFormat captureFormat = CAPTURE_PPM;
+    unsigned captureInterval = 1;
+    int captureThreads = DEFAULT_CAPTURE_THREADS;
+    string heatmapPrefix;
+    int heatmapSubdivision = DEFAULT_HEATMAP_SUBDIVISION;
+    int heatmapThreads = DEFAULT_HEATMAP_THREADS;
+    bool heatmapOverlay = false;
+    unsigned seed = random_device{}();
+    int replicas = 0; // > 0 runs that many headless replicas instead of the simulator
+    int replicaJobs = max(1u, thread::hardware_concurrency());
+    string replicaCsvPath;
+    string conflictsPath;
+    string socketPath = DEFAULT_COMMAND_SOCKET; // Empty runs without the command server
+    TimingOptimizerOptions optimizer = {"", "", DEFAULT_OPTIMIZER_GENERATIONS, DEFAULT_OPTIMIZER_POPULATION, DEFAULT_OPTIMIZER_SEEDS, {}};
+    for (int i = 1; i < argc; i++)
     {
-        return true;
+        string arg = argv[i];
+        if (arg == "--record" && i + 1 < argc)
+            recordPath = argv[++i];
+        else if (arg == "--replay" && i + 1 < argc)
+            replayPath = argv[++i];
+        else if (arg == "--replay-speed" && i + 1 < argc)
+            replaySpeed = atof(argv[++i]);
+        else if (arg == "--restore" && i + 1 < argc)
+            restorePath = argv[++i];
+        else if (arg == "--checkpoint" && i + 1 < argc)
+            checkpointPath = argv[++i];
+        else if (arg == "--start" && i + 1 < argc)
+        {
+            if (!parseTimeOfDay(argv[++i], startTime))
+                return 1;
+        }
+        else if (arg == "--warp" && i + 1 < argc)
+            timeWarp = atof(argv[++i]);
+        else if (arg == "--headless")
+            headless = true;
+        else if (arg == "--realtime")
+            realtime = true;
+        else if (arg == "--ticks" && i + 1 < argc)
+            maxTicks = atoi(argv[++i]);
+        else if (arg == "--capture" && i + 1 < argc)
+            capturePath = argv[++i];
+        else if (arg == "--capture-format" && i + 1 < argc)
+        {
+            if (!parseCaptureFormat(argv[++i], captureFormat))
+                return 1;
+        }
+        else if (arg == "--capture-every" && i + 1 < argc)
+            captureInterval = atoi(argv[++i]);
+        else if (arg == "--capture-threads" && i + 1 < argc)
+            captureThreads = atoi(argv[++i]);
+        else if (arg == "--heatmap" && i + 1 < argc)
+            heatmapPrefix = argv[++i];
+        else if (arg == "--heatmap-cells" && i + 1 < argc)
+            heatmapSubdivision = atoi(argv[++i]);
+        else if (arg == "--heatmap-threads" && i + 1 < argc)
+            heatmapThreads = atoi(argv[++i]);
+        else if (arg == "--heatmap-overlay")
+            heatmapOverlay = true;
+        else if (arg == "--seed" && i + 1 < argc)
+            seed = strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--replicas" && i + 1 < argc)
+            replicas = atoi(argv[++i]);
+        else if (arg == "--replica-jobs" && i + 1 < argc)
+            replicaJobs = atoi(argv[++i]);
+        else if (arg == "--replica-csv" && i + 1 < argc)
+            replicaCsvPath = argv[++i];
+        else if (arg == "--optimize-timing" && i + 1 < argc)
+            optimizer.outputPath = argv[++i];
+        else if (arg == "--optimize-generations" && i + 1 < argc)
+            optimizer.generations = atoi(argv[++i]);
+        else if (arg == "--optimize-population" && i + 1 < argc)
+            optimizer.population = atoi(argv[++i]);
+        else if (arg == "--optimize-seeds" && i + 1 < argc)
+            optimizer.seeds = max(1, atoi(argv[++i]));
+        else if (arg == "--timing-cache" && i + 1 < argc)
+            optimizer.cachePath = argv[++i];
+        else if (arg == "--conflicts" && i + 1 < argc)
+            conflictsPath = argv[++i];
+        else if (arg == "--socket" && i + 1 < argc)
+            socketPath = argv[++i];
+        else if (arg == "--no-socket")
+            socketPath.clear();
+        else
+        {
+            scenarioPath = arg;
+            scenarioGiven = true;
+        }
     }
 
-    // Evening peak hours: 4:30 PM to 8:30 PM
-    if ((ltm->tm_hour == 16 && ltm->tm_min >= 30) ||
-        (ltm->tm_hour == 17) ||
-        (ltm->tm_hour == 18) ||
-        (ltm->tm_hour == 20 && ltm->tm_min <= 30))
+    // Map the compiled scenario; fall back to the built-in layout when none is available
+    ScenarioFile scenarioFile;
+    ScenarioBlob builtinScenario = defaultScenario();
+    const ScenarioBlob *scenarioPtr = &builtinScenario;
+    if (scenarioFile.open(scenarioPath))
+        scenarioPtr = scenarioFile.get();
+    else if (scenarioGiven)
+        return 1;
+    else
+        cout << "Using built-in scenario\n";
+    const ScenarioBlob &scenario = *scenarioPtr;
+
+    // Monte Carlo mode: independent headless runs in worker processes, then statistics
+    if (replicas > 0)
     {
-        return true;
+        ReplicaOptions options = {replicas, replicaJobs, seed, maxTicks > 0 ? maxTicks : DEFAULT_REPLICA_TICKS,
+                                  SIM_TICK_SECONDS, startTime, timeWarp, replicaCsvPath};
+        return runReplicas(scenario, options) ? 0 : 1;
     }
 
-    return false;
-}
-
-
+    // Timing search: batches of short headless replicas per candidate plan, best plan per demand regime
+    if (!optimizer.outputPath.empty())
+    {
+        optimizer.replica = {0, replicaJobs, seed, maxTicks > 0 ? maxTicks : DEFAULT_OPTIMIZER_TICKS,
+                             SIM_TICK_SECONDS, startTime, 0.0f, ""};
+        TimingOptimizer timingOptimizer(scenario, optimizer);
+        return timingOptimizer.run() ? 0 : 1;
+    }
 
-int main()
-{
-    RenderWindow window(VideoMode(1000, 1000), "Traffic Simulator");
-
-    window.setPosition(Vector2i(20, 20));
-    SimulationStats stats;
-    stats.simulationTimer.restart();
-    stats.hasStarted = true;
-   
-
-    LaneConfig laneConfigs[] = {
-        // North lanes (lanes 0-1)
-        {INITIAL_LANE_SPEEDS[0], Clock(), 1.0f, 0.20f, 15.0f}, // 1 vehicle/sec, 20% CAR5 every 15s
-        {INITIAL_LANE_SPEEDS[1], Clock(), 1.0f, 0.20f, 15.0f}, // 1 vehicle/sec, 20% CAR5 every 15s
-
-        // South lanes (lanes 2-3)
-        {INITIAL_LANE_SPEEDS[2], Clock(), 2.0f, 0.05f, 15.0f}, // 1 vehicle/2sec, 5% CAR5
-        {INITIAL_LANE_SPEEDS[3], Clock(), 2.0f, 0.05f, 15.0f}, // 1 vehicle/2sec, 5% CAR5
-
-        // East lanes (lanes 4-5)
-        {INITIAL_LANE_SPEEDS[4], Clock(), 1.5f, 0.10f, 20.0f}, // 1 vehicle/1.5sec, 10% CAR5 every 20s
-        {INITIAL_LANE_SPEEDS[5], Clock(), 1.5f, 0.10f, 20.0f}, // 1 vehicle/1.5sec, 10% CAR5 every 20s
-
-        // West lanes (lanes 6-7)
-        {INITIAL_LANE_SPEEDS[6], Clock(), 2.0f, 0.30f, 15.0f}, // 1 vehicle/2sec, 30% CAR5
-        {INITIAL_LANE_SPEEDS[7], Clock(), 2.0f, 0.30f, 15.0f}  // 1 vehicle/2sec, 30% CAR5
-    };
+    if (headless && !replayPath.empty())
+    {
+        cerr << "--replay needs a window and cannot be combined with --headless\n";
+        return 1;
+    }
 
-    RoadTile roadtiles[] = {
-        {VER, 0, 2},
-        {VER, 1, 2},
-        {HOR, 2, 0},
-        {HOR, 2, 1},
-        {CROSS, 2, 2},
-        {HOR, 2, 3},
-        {HOR, 2, 4},
-        {HOR, 2, 5},
-        {VER, 4, 2},
-        {VER, 3, 2},
-        {VER, 5, 2},
-    };
+    // Headless runs never open a window nor create a GL context (no road tile textures either)
+    RenderWindow window;
+    if (!headless)
+    {
+        window.create(VideoMode(scenario.windowWidth, scenario.windowHeight), "Traffic Simulator");
+        window.setPosition(Vector2i(20, 20));
+    }
+    // Everything the run mutates lives in sim, touched only by the simulation thread once it starts
+    Simulation sim(scenario, startTime, timeWarp, seed);
+    if (headless)
+        sim.spawnCheckThreads = 1; // Nothing to keep responsive, and spawn checks cost less than the threads
 
-    TrafficLight tlights[] = {
-        {535, 500, 180, GREEN},
-        {510, 500, 90, RED},
-        {430, 500, 180, RED},
-        {500, 400, 90, GREEN},
-    };
-    bool move = true;
-    SmartTraffix trafficController(tlights, 4);
+    // Reserve up front: a RoadTile's sprite points at its own texture, so the tiles must not move
+    vector<RoadTile> roadtiles;
+    {
+        MemoryScope scope(MEMORY_RENDERING);
+        roadtiles.reserve(scenario.tileCount);
+        for (int i = 0; i < scenario.tileCount && !headless; i++)
+        {
+            const ScenarioTile &tile = scenario.tiles[i];
+            roadtiles.emplace_back(static_cast<tRoadTileType>(tile.type), tile.row, tile.col);
+        }
+    }
 
-    struct LaneConfig
+    // Replay mode draws a recorded run and never starts the simulation
+    if (!replayPath.empty())
     {
-        float spawnInterval;
-        float car5Probability;
-        float car5Interval;
-    };
+        replayTrajectory(window, replayPath, roadtiles, sim.tlights, scenario.lightCount, replaySpeed);
+        return 0;
+    }
 
-    const int maxCars = 50000;
-    Car *cars[maxCars] = {nullptr};
-    CarData *carData[maxCars] = {nullptr};
-    int carCount = 0;
-
-    // Track number of cars in each lane (8 lanes in total)
-    int carsInLane[8] = {};
-
-    // Define different speeds for each lane (pixels per move)
-    float laneSpeeds[8] = {1.0f, 1.0, 2.0, 2.0f, 1.5f, 1.5, 2.0f, 2.0};
-
-    // Initialize clocks for spawning
-    Clock globalSpawnClock; // Add this new clock for controlling overall spawn timing
-    Clock spawnClocks[8];
-    Clock specialSpawnClocks[8];
-    Clock car5SpawnClocks[8];
-    Clock speedtimer;
-    speedtimer.restart();
-    // Define fixed lane positions for spawning cars
-    float spawnPositions[][3] = {
-        {510, -80, 0},    // North-moving lane
-        {545, -80, 0},    // North-moving lane
-        {405, 1070, 180}, // South-moving lane
-        {445, 1070, 180}, // South-moving lane
-        {-80, 445, 90},   // East-moving lane
-        {-80, 407, 90},   // East-moving lane
-        {1070, 500, 270}, // West-moving lane
-        {1070, 545, 270}  // West-moving lane
+    TrajectoryWriter trajectoryWriter;
+    if (!recordPath.empty() && !trajectoryWriter.open(recordPath))
+        return 1;
+    // Software-rendered frames, available with or without a window
+    FrameCapture *frameCapture = nullptr;
+    if (!capturePath.empty())
+    {
+        MemoryScope scope(MEMORY_RENDERING);
+        frameCapture = new FrameCapture(scenario, captureThreads);
+        if (!frameCapture->open(capturePath, captureFormat, captureInterval))
+            return 1;
+    }
+    // Occupancy and dwell maps, exported when the run ends; H toggles the overlay
+    OccupancyHeatmap *heatmap = nullptr;
+    if (!heatmapPrefix.empty() || heatmapOverlay)
+    {
+        MemoryScope scope(MEMORY_ANALYTICS);
+        heatmap = new OccupancyHeatmap(scenario, heatmapSubdivision, heatmapThreads);
+    }
+    atomic<bool> overlayVisible(heatmapOverlay);
+    // Overlaps and near misses in the intersection box, logged as they start
+    ConflictDetector *conflicts = nullptr;
+    if (!conflictsPath.empty())
+    {
+        MemoryScope scope(MEMORY_ANALYTICS);
+        conflicts = new ConflictDetector(intersectionZones(scenario));
+        if (!conflicts->openLog(conflictsPath))
+            return 1;
+    }
+    UserPortal userPortal(sim.challanGenerator, &sim.world);
+
+    SimulationState simulationState = sim.checkpointState();
+    if (!restorePath.empty() && !loadCheckpoint(restorePath, simulationState))
+        return 1;
+    sim.adoptRestoredCars();
+
+    // Requests from the window thread and the command server, picked up by the simulation thread between ticks
+    atomic<bool> simRunning(true);
+    atomic<bool> pauseRequested(false);
+    atomic<bool> simPaused(false); // The simulation thread has seen pauseRequested and stopped ticking
+    atomic<int> stepsRequested(0); // Ticks to run while paused
+    atomic<bool> checkpointRequested(false);
+    TripleBuffer<SimulationSnapshot> snapshots;
+
+    // One simulation step. Everything it touches belongs to the simulation thread while it runs.
+    auto simulateTick = [&]()
+    {
+        sim.step();
+
+        // Publish this tick to the renderer, and to the recording when one is running
+        MemoryScope scope(MEMORY_RENDERING);
+        SimulationSnapshot &snapshot = snapshots.writeBuffer();
+        captureFrame(snapshot.frame, sim.tick - 1, Simulation::tickMs(sim.tick - 1),
+                     sim.cars.data(), sim.carData.data(), sim.carCount, sim.trafficController->signals(), scenario.lightCount);
+        snprintf(snapshot.timeOfDay, sizeof(snapshot.timeOfDay), "%s", sim.clock.timeOfDay().c_str());
+        if (trajectoryWriter.isOpen())
+            trajectoryWriter.submit(TrajectoryFrame(snapshot.frame));
+        if (frameCapture != nullptr)
+            frameCapture->capture(snapshot.frame);
+        if (heatmap != nullptr)
+        {
+            MemoryScope analyticsScope(MEMORY_ANALYTICS);
+            heatmap->accumulate(snapshot.frame);
+            if (overlayVisible)
+                heatmap->snapshotOccupancy(snapshot.heatmap);
+            else
+                snapshot.heatmap.clear();
+        }
+        if (conflicts != nullptr)
+        {
+            MemoryScope analyticsScope(MEMORY_ANALYTICS);
+            conflicts->observe(snapshot.frame);
+        }
+        snapshots.publish();
     };
-    ChallanGenerator challanGenerator;
-    UserPortal userPortal(challanGenerator);
-
-    int counter = 0;
-    bool isPaused = false; // Flag to control pause state
 
-    while (window.isOpen())
+    // Simulation loop, independent of how fast the window can display
+    bool paced = !headless || realtime;
+    function<void()> simulationLoop = [&]()
     {
-
-        Event event;
-        while (window.pollEvent(event))
+        Clock tickClock;
+        while (simRunning && !interrupted && (maxTicks == 0 || sim.tick < maxTicks))
         {
-            if (event.type == Event::Closed)
-                window.close();
-            if (event.type == Event::KeyPressed && event.key.code == Keyboard::P)
-            {
-                isPaused = !isPaused;
+            tickClock.restart();
+            if (checkpointRequested.exchange(false))
+                saveCheckpoint(checkpointPath, simulationState);
 
-                if (isPaused)
-                {
-                   
-                    // Loop to allow multiple payments
-                    char payChoice;
-                    do
-                    {
-                        cout << "Do you want to pay a challan? (y/n): ";
-                        cin >> payChoice;
-
-                        if (tolower(payChoice) == 'y')
-                        {
-                            string vehicleNumber;
-                            cout << "Enter Vehicle Number: ";
-                            cin >> vehicleNumber; 
-
-                            string issueDateStr;
-                            time_t issueDate = 0;
-                            cout << "Enter Issue Date (YYYY-MM-DD) or press Enter to skip: ";
-                            cin.ignore(); 
-                            getline(cin, issueDateStr);
-
-                            if (!issueDateStr.empty())
-                            {
-                                struct tm tm = {};
-                                if (strptime(issueDateStr.c_str(), "%Y-%m-%d", &tm) != nullptr)
-                                {
-                                    issueDate = mktime(&tm);
-                                }
-                                else
-                                {
-                                    cout << "Invalid date format. Showing all challans.\n";
-                                }
-                            }
-
-                            userPortal.accessChallanDetails(vehicleNumber, issueDate);
-                            
-                            int challanId;
-                            float amount;
-                            cout << "Enter Challan ID to pay: ";
-                            cin >> challanId;
-                            cout << "Enter Amount to Pay: ";
-                            cin >> amount;
-                            userPortal.payChallan(challanId, vehicleNumber, amount);
-                        }
-                        else if (tolower(payChoice) != 'n')
-                        {
-                            cout << "Invalid choice. Please enter 'y' or 'n'.\n";
-                        }
-                    } while (tolower(payChoice) != 'n'); 
-                }
-                else
+            if (pauseRequested)
+            {
+                simPaused = true;
+                if (stepsRequested > 0)
                 {
-                    window.setTitle("Traffic Simulator");
+                    simulateTick();
+                    stepsRequested--;
+                    continue; // Steps run back to back
                 }
             }
+            else
+            {
+                simPaused = false;
+                // A pause requested while simPaused was still set from the previous pause is caught here
+                if (!pauseRequested)
+                    simulateTick();
+            }
+
+            Time remaining = sf::seconds(SIM_TICK_SECONDS) - tickClock.getElapsedTime();
+            if ((paced || simPaused) && remaining > Time::Zero)
+                sf::sleep(remaining);
         }
+    };
+
+    // Lookups, payments, pause and step from smarttraffix-portal; started after the light
+    // controllers have forked so they do not inherit the socket
+    CommandServer commandServer(userPortal, sim.world, scenario.lightCount, {&pauseRequested, &simPaused, &stepsRequested});
+    if (!socketPath.empty())
+        commandServer.start(socketPath);
+
+    pthread_t simulationThread;
+    pthread_create(&simulationThread, nullptr, runFunction, &simulationLoop);
 
-        if (!isPaused)
+    if (headless)
+    {
+        // No window: wait for the simulation thread to reach --ticks or be interrupted
+        signal(SIGINT, onInterrupt);
+        signal(SIGTERM, onInterrupt);
+        pthread_join(simulationThread, nullptr);
+    }
+    else
+    {
+        // This thread only handles the window: it draws the newest snapshot at display rate.
+        // Lights are drawn from display copies so the simulation's TrafficLight objects are never shared.
+        MemoryScope scope(MEMORY_RENDERING);
+        window.setFramerateLimit(RENDER_FRAME_RATE);
+        TrafficLight displayLights[SCENARIO_MAX_LIGHTS];
+        for (int i = 0; i < scenario.lightCount; i++)
         {
-            spawnCars(cars, carData, carCount, carsInLane, spawnPositions, laneConfigs, globalSpawnClock, spawnClocks, car5SpawnClocks, maxCars);
-            trafficController.update();
+            displayLights[i] = sim.tlights[i];
+        }
+        FrameView view;
+        string shownTime;
 
-            if (speedtimer.getElapsedTime().asSeconds() >= 1.0f)
+        while (window.isOpen())
+        {
+            Event event;
+            while (window.pollEvent(event))
             {
-                counter++;
-                speedtimer.restart();
-                for (int temp = 0; temp < carCount; temp++)
+                if (event.type == Event::Closed)
+                    window.close();
+                if (event.type == Event::KeyPressed && event.key.code == Keyboard::C)
+                    checkpointRequested = true;
+                if (event.type == Event::KeyPressed && event.key.code == Keyboard::H && heatmap != nullptr)
+                    overlayVisible = !overlayVisible;
+                // Reads the published snapshot, so the simulation thread keeps running
+                if (event.type == Event::KeyPressed && event.key.code == Keyboard::A)
+                    sim.trafficController->displayAnalytics(sim.world);
+                if (event.type == Event::KeyPressed && event.key.code == Keyboard::M)
+                    printMemoryReport(cout);
+                // Only flips the flag: payments go through smarttraffix-portal while the window keeps drawing
+                if (event.type == Event::KeyPressed && event.key.code == Keyboard::P)
                 {
-                    if ((rand() % 2) == temp % 2)
+                    pauseRequested = !pauseRequested;
+                    stepsRequested = 0;
+                    if (pauseRequested)
                     {
-                        cars[temp]->setSpeed((INITIAL_LANE_SPEEDS[temp] + counter) * KMH_TO_PIXELS);
+                        cout << "Paused. Use smarttraffix-portal to look up and pay challans or step the simulation, P to resume.\n";
+                        userPortal.showStatus(scenario.lightCount);
                     }
                 }
             }
 
-            checkBreakdownsMultiThreaded(cars, carData, carCount, stats);
-            spawnRescueVehiclesForBrokenDownCars(cars, carData, carCount, maxCars, carsInLane);
-            window.clear(Color::White);
-
-            // Draw road tiles and traffic lights
-            for (auto &tile : roadtiles)
+            if (snapshots.update())
             {
-                tile.draw(&window);
-            }
-            for (auto &light : tlights)
-            {
-                light.draw(&window);
+                const SimulationSnapshot &snapshot = snapshots.readBuffer();
+                view.show(snapshot.frame, displayLights, scenario.lightCount);
+                if (shownTime != snapshot.timeOfDay)
+                {
+                    shownTime = snapshot.timeOfDay;
+                    window.setTitle("Traffic Simulator - " + shownTime);
+                }
             }
-
-            // Move and draw cars, with removal logic
-            int removeCount = 0;
-            int removeIndices[maxCars];
-
-            updateCars(&window, cars, tlights, carCount, carsInLane, trafficController);
-
-            // Check speed violations
-            checkSpeedViolationsMultiThreaded(cars, carData, carCount, challanGenerator, trafficController);
-            window.display();
-        }
-        else
-        {
-            // Keep window displaying as paused until resumed
+            view.draw(window, roadtiles, displayLights, scenario.lightCount);
+            if (overlayVisible && heatmap != nullptr)
+                drawHeatmapOverlay(window, snapshots.readBuffer().heatmap, heatmap->getCols(),
+                                   heatmap->getCellWidth(), heatmap->getCellHeight());
             window.display();
         }
 
-        // Small delay to avoid maxing out CPU usage
-        sleep(sf::seconds(0.01));
-    }
-
-    // Clean up memory
-    for (int i = 0; i < carCount; i++)
-    {
-        if (cars[i] != nullptr)
-        {
-            delete cars[i];
-        }
+        simRunning = false;
+        pthread_join(simulationThread, nullptr);
     }
+    commandServer.stop();
+    // Before the teardown below, so it shows what the run was holding
+    printMemoryReport(cout);
+
+    trajectoryWriter.close();
+    delete frameCapture;
+    if (heatmap != nullptr && !heatmapPrefix.empty())
+        heatmap->exportCsv(heatmapPrefix, SIM_TICK_SECONDS);
+    delete heatmap;
+    if (conflicts != nullptr)
+        conflicts->printSummary();
+    delete conflicts;
 
     return 0;
 }
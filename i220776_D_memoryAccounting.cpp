@@ -0,0 +1,64 @@
+#include <cstdlib>
+#include <cstddef>
+#include <new>
+#include "i220776_D_memoryAccounting.h"
+
+// Global operator new and delete with per-subsystem accounting, see i220776_D_memoryAccounting.h.
+// Every block is preceded by a header holding its size and subsystem. The header is 16 bytes, so
+// blocks keep malloc's alignment. Over-aligned types go through the aligned overloads, which are
+// not replaced and are not counted.
+
+namespace
+{
+struct alignas(16) BlockHeader
+{
+    uint64_t size;
+    uint32_t subsystem;
+};
+static_assert(sizeof(BlockHeader) == 16, "the header must keep malloc's 16-byte alignment");
+
+void *allocateBlock(size_t size)
+{
+    BlockHeader *header = static_cast<BlockHeader *>(malloc(sizeof(BlockHeader) + size));
+    if (header == nullptr)
+        return nullptr;
+    header->size = size;
+    header->subsystem = memoryTag;
+    memoryAccount(header->subsystem, size);
+    return header + 1;
+}
+
+void *allocateOrThrow(size_t size)
+{
+    void *block;
+    while ((block = allocateBlock(size)) == nullptr)
+    {
+        new_handler handler = get_new_handler();
+        if (handler == nullptr)
+            throw bad_alloc();
+        handler();
+    }
+    return block;
+}
+
+void freeBlock(void *block)
+{
+    if (block == nullptr)
+        return;
+    BlockHeader *header = static_cast<BlockHeader *>(block) - 1;
+    memoryRelease(header->subsystem, header->size);
+    free(header);
+}
+}
+
+void *operator new(size_t size) { return allocateOrThrow(size); }
+void *operator new[](size_t size) { return allocateOrThrow(size); }
+void *operator new(size_t size, const nothrow_t &) noexcept { return allocateBlock(size); }
+void *operator new[](size_t size, const nothrow_t &) noexcept { return allocateBlock(size); }
+
+void operator delete(void *block) noexcept { freeBlock(block); }
+void operator delete[](void *block) noexcept { freeBlock(block); }
+void operator delete(void *block, size_t) noexcept { freeBlock(block); }
+void operator delete[](void *block, size_t) noexcept { freeBlock(block); }
+void operator delete(void *block, const nothrow_t &) noexcept { freeBlock(block); }
+void operator delete[](void *block, const nothrow_t &) noexcept { freeBlock(block); }
@@ -0,0 +1,130 @@
+#pragma once
+#include <iostream>
+#include <iomanip>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+using namespace std;
+
+// Memory accounting per subsystem.
+// i220776_D_memoryAccounting.cpp replaces the global operator new and delete: every block carries
+// a small header naming the subsystem it was allocated for, so it is charged to that subsystem
+// when allocated and credited back when freed, whichever thread frees it. The subsystem of an
+// allocation is the innermost MemoryScope active on the allocating thread; code outside every
+// scope is charged to "other". Memory that does not come from operator new (the light
+// controllers' shared mapping) is charged with memoryAccount / memoryRelease directly.
+//
+// Binaries that do not link the .cpp keep the scopes but count nothing.
+
+enum MemorySubsystem
+{
+    MEMORY_OTHER,
+    MEMORY_VEHICLES,   // Car, CarData, the car slot arrays and the plate table
+    MEMORY_RENDERING,  // Snapshots, recordings, frame capture, textures and the window's drawing
+    MEMORY_CHALLANS,   // The challan ledger and its reports
+    MEMORY_CONTROLLER, // SmartTraffix, its phase plan and the light controllers
+    MEMORY_ANALYTICS   // Speed and vehicle queues, heatmap, conflict detection
+};
+
+const int MEMORY_SUBSYSTEMS = MEMORY_ANALYTICS + 1;
+const char *const MEMORY_SUBSYSTEM_NAMES[MEMORY_SUBSYSTEMS] = {"other", "vehicles", "rendering", "challans", "controller", "analytics"};
+
+// Counters of one subsystem, on their own cache line
+struct alignas(64) MemoryCounters
+{
+    atomic<int64_t> liveBytes;
+    atomic<int64_t> peakBytes;
+    atomic<int64_t> liveBlocks;
+    atomic<int64_t> peakBlocks;
+    atomic<int64_t> allocations; // Ever made
+};
+
+// Static storage, so zero before any allocation, static constructors included
+inline MemoryCounters memoryCounters[MEMORY_SUBSYSTEMS];
+inline thread_local uint8_t memoryTag = MEMORY_OTHER;
+
+inline void raiseTo(atomic<int64_t> &peak, int64_t value)
+{
+    int64_t seen = peak.load(memory_order_relaxed);
+    while (value > seen && !peak.compare_exchange_weak(seen, value, memory_order_relaxed))
+        ;
+}
+
+// One block of bytes allocated for subsystem
+inline void memoryAccount(int subsystem, int64_t bytes)
+{
+    MemoryCounters &counters = memoryCounters[subsystem];
+    raiseTo(counters.peakBytes, counters.liveBytes.fetch_add(bytes, memory_order_relaxed) + bytes);
+    raiseTo(counters.peakBlocks, counters.liveBlocks.fetch_add(1, memory_order_relaxed) + 1);
+    counters.allocations.fetch_add(1, memory_order_relaxed);
+}
+
+inline void memoryRelease(int subsystem, int64_t bytes)
+{
+    memoryCounters[subsystem].liveBytes.fetch_sub(bytes, memory_order_relaxed);
+    memoryCounters[subsystem].liveBlocks.fetch_sub(1, memory_order_relaxed);
+}
+
+// Charges this thread's allocations to subsystem until the scope ends; scopes nest
+class MemoryScope
+{
+    uint8_t previous;
+
+public:
+    MemoryScope(MemorySubsystem subsystem) : previous(memoryTag) { memoryTag = subsystem; }
+    ~MemoryScope() { memoryTag = previous; }
+    MemoryScope(const MemoryScope &) = delete;
+    MemoryScope &operator=(const MemoryScope &) = delete;
+};
+
+struct MemoryUsage
+{
+    int64_t liveBytes, peakBytes, liveBlocks, peakBlocks, allocations;
+};
+
+inline MemoryUsage memoryUsage(int subsystem)
+{
+    const MemoryCounters &counters = memoryCounters[subsystem];
+    return {counters.liveBytes.load(memory_order_relaxed), counters.peakBytes.load(memory_order_relaxed),
+            counters.liveBlocks.load(memory_order_relaxed), counters.peakBlocks.load(memory_order_relaxed),
+            counters.allocations.load(memory_order_relaxed)};
+}
+
+inline string formatBytes(int64_t bytes)
+{
+    const char *units[] = {"B", "KB", "MB", "GB"};
+    double value = bytes;
+    int unit = 0;
+    while (value >= 1024 && unit < 3)
+    {
+        value /= 1024;
+        unit++;
+    }
+    char text[32];
+    snprintf(text, sizeof(text), unit == 0 ? "%.0f %s" : "%.1f %s", value, units[unit]);
+    return text;
+}
+
+// Live and peak bytes and blocks of every subsystem; all zero when nothing is counted
+inline void printMemoryReport(ostream &out)
+{
+    out << "Memory by subsystem:\n";
+    out << left << setw(12) << "subsystem" << right << setw(12) << "live" << setw(12) << "peak"
+        << setw(12) << "blocks" << setw(12) << "peak blocks" << setw(14) << "allocations" << "\n";
+    MemoryUsage total = {};
+    for (int subsystem = 0; subsystem < MEMORY_SUBSYSTEMS; subsystem++)
+    {
+        MemoryUsage usage = memoryUsage(subsystem);
+        out << left << setw(12) << MEMORY_SUBSYSTEM_NAMES[subsystem] << right
+            << setw(12) << formatBytes(usage.liveBytes) << setw(12) << formatBytes(usage.peakBytes)
+            << setw(12) << usage.liveBlocks << setw(12) << usage.peakBlocks << setw(14) << usage.allocations << "\n";
+        total.liveBytes += usage.liveBytes;
+        total.liveBlocks += usage.liveBlocks;
+        total.allocations += usage.allocations;
+    }
+    // Peaks of different subsystems are reached at different times, so they are not summed
+    out << left << setw(12) << "total" << right << setw(12) << formatBytes(total.liveBytes) << setw(12) << ""
+        << setw(12) << total.liveBlocks << setw(12) << "" << setw(14) << total.allocations << "\n";
+}
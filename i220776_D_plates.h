@@ -0,0 +1,114 @@
+#pragma once
+#include <pthread.h>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "i220776_D_memoryAccounting.h"
+
+using namespace std;
+
+// Number plates.
+// Every plate string is stored once, in the process-wide PlateTable, and everything else
+// (CarData, challan records, the analytics queues) holds its 32-bit PlateId. Comparing plates is
+// comparing integers; the string is only produced where a plate is shown or written out
+// (console, portal, checkpoints). Generation and interning take the table's mutex, so spawn code,
+// portal threads and checkpoint loading may all use it at once. Ids are never reused: a challan
+// keeps referring to its plate after the car has left.
+
+typedef uint32_t PlateId;
+const PlateId NO_PLATE = 0; // Never assigned
+
+const int FIRST_PLATE_NUMBER = 1000;
+
+class PlateTable
+{
+    pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    deque<string> names;                     // names[id - 1]; a deque never moves its elements
+    unordered_map<string_view, PlateId> ids; // Views into names
+    int nextNumber = FIRST_PLATE_NUMBER;
+
+    PlateId internLocked(const string &name)
+    {
+        MemoryScope scope(MEMORY_VEHICLES);
+        auto it = ids.find(name);
+        if (it != ids.end())
+            return it->second;
+        names.push_back(name);
+        PlateId id = names.size();
+        ids.emplace(names.back(), id);
+        return id;
+    }
+
+public:
+    PlateTable() = default;
+    PlateTable(const PlateTable &) = delete;
+    PlateTable &operator=(const PlateTable &) = delete;
+
+    // Next plate in the ABC-<number> series
+    PlateId generate()
+    {
+        pthread_mutex_lock(&mutex);
+        PlateId id = internLocked("ABC-" + to_string(nextNumber++));
+        pthread_mutex_unlock(&mutex);
+        return id;
+    }
+
+    // Id of a plate string, added to the table if new
+    PlateId intern(const string &name)
+    {
+        pthread_mutex_lock(&mutex);
+        PlateId id = internLocked(name);
+        pthread_mutex_unlock(&mutex);
+        return id;
+    }
+
+    // Id of a plate string already in the table, NO_PLATE otherwise; never adds one
+    PlateId find(const string &name)
+    {
+        pthread_mutex_lock(&mutex);
+        auto it = ids.find(name);
+        PlateId id = it != ids.end() ? it->second : NO_PLATE;
+        pthread_mutex_unlock(&mutex);
+        return id;
+    }
+
+    string format(PlateId id)
+    {
+        pthread_mutex_lock(&mutex);
+        string name = id != NO_PLATE && id <= names.size() ? names[id - 1] : "";
+        pthread_mutex_unlock(&mutex);
+        return name;
+    }
+
+    size_t size()
+    {
+        pthread_mutex_lock(&mutex);
+        size_t count = names.size();
+        pthread_mutex_unlock(&mutex);
+        return count;
+    }
+
+    // Series counter, saved and restored with checkpoints so plates stay unique
+    int getNextNumber()
+    {
+        pthread_mutex_lock(&mutex);
+        int number = nextNumber;
+        pthread_mutex_unlock(&mutex);
+        return number;
+    }
+
+    void setNextNumber(int number)
+    {
+        pthread_mutex_lock(&mutex);
+        nextNumber = number;
+        pthread_mutex_unlock(&mutex);
+    }
+};
+
+inline PlateTable &plates()
+{
+    static PlateTable table;
+    return table;
+}
@@ -0,0 +1,117 @@
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Operator client for a running simulator's command server (i220776_D_commandServer.h).
+//
+// Usage: ./smarttraffix-portal [--socket path] [command words...]
+//
+// With a command, e.g. ./smarttraffix-portal pay 3 ABC-123 500, it sends that one line, prints
+// the reply and exits with 0 on OK and 1 on ERR. Without one it reads commands from stdin.
+
+using namespace std;
+
+// Must match DEFAULT_COMMAND_SOCKET in i220776_D_commandServer.h
+#define DEFAULT_SOCKET_PATH "smarttraffix.sock"
+
+int connectTo(const string &path)
+{
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+    {
+        cerr << "Socket path " << path << " is too long\n";
+        return -1;
+    }
+    strcpy(address.sun_path, path.c_str());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (sockaddr *)&address, sizeof(address)) != 0)
+    {
+        cerr << "Cannot connect to " << path << ": " << strerror(errno) << "\n"
+             << "Is smarttraffix running (without --no-socket)?\n";
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Sends one command and prints the reply up to its OK/ERR line; false on ERR or a lost connection
+bool runCommand(int fd, const string &command, bool &connected)
+{
+    string line = command + "\n";
+    if (send(fd, line.data(), line.size(), MSG_NOSIGNAL) != (ssize_t)line.size())
+    {
+        cerr << "Connection lost\n";
+        connected = false;
+        return false;
+    }
+
+    string received;
+    while (true)
+    {
+        size_t newline;
+        while ((newline = received.find('\n')) != string::npos)
+        {
+            string replyLine = received.substr(0, newline);
+            received.erase(0, newline + 1);
+            cout << replyLine << "\n";
+            if (replyLine.compare(0, 2, "OK") == 0)
+                return true;
+            if (replyLine.compare(0, 3, "ERR") == 0)
+                return false;
+        }
+
+        char buffer[512];
+        ssize_t count = recv(fd, buffer, sizeof(buffer), 0);
+        if (count <= 0)
+        {
+            cerr << "Connection lost\n";
+            connected = false;
+            return false;
+        }
+        received.append(buffer, count);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    string socketPath = DEFAULT_SOCKET_PATH;
+    string command;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--socket" && i + 1 < argc)
+            socketPath = argv[++i];
+        else
+            command += (command.empty() ? "" : " ") + arg;
+    }
+
+    int fd = connectTo(socketPath);
+    if (fd < 0)
+        return 1;
+
+    bool connected = true;
+    if (!command.empty())
+    {
+        bool ok = runCommand(fd, command, connected);
+        close(fd);
+        return ok ? 0 : 1;
+    }
+
+    cout << "Connected to " << socketPath << ", type help for the commands\n";
+    string line;
+    while (connected && (cout << "> " << flush, getline(cin, line)))
+    {
+        runCommand(fd, line, connected);
+        if (line == "quit")
+            break;
+    }
+    close(fd);
+    return 0;
+}
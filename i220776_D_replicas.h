@@ -0,0 +1,361 @@
+#pragma once
+#include <SFML/System.hpp>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <atomic>
+#include <new>
+#include <unordered_map>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "i220776_D_simulation.h"
+#include "i220776_D_trajectory.h"
+#include "i220776_D_conflicts.h"
+
+using namespace std;
+
+// Monte Carlo replicas.
+// One run says little on its own: vehicle types, CAR5 arrivals, turns and breakdowns are all
+// random. runReplicas forks worker processes that take replica numbers from a shared counter,
+// run each replica headless with its own seed and write one ReplicaResult into a shared
+// anonymous mapping. Being separate processes, workers never share the per-process statics
+// either (plate counter, texture caches), and a worker that crashes only loses its own rows.
+// The parent then reports every metric as a mean with a 95% confidence interval.
+// runReplicaBatch is the same machinery for arbitrary (scenario, seed, start) tasks, used by the
+// timing optimizer to score many candidate plans at once.
+
+const unsigned DEFAULT_REPLICA_TICKS = 6000; // One minute at the default tick length
+
+struct ReplicaOptions
+{
+    int replicas;
+    int jobs;          // Worker processes
+    unsigned baseSeed; // Replica i is seeded with baseSeed + i
+    unsigned ticks;
+    float tickSeconds;
+    double startTime;
+    float timeWarp;
+    string csvPath; // Per-replica rows, empty for none
+};
+
+// One headless run of a batch. Scenarios live in the parent and are inherited by the workers.
+struct ReplicaTask
+{
+    const ScenarioBlob *scenario;
+    uint32_t seed;
+    double startTime;
+};
+
+// One replica's totals, written by a worker straight into the shared mapping
+struct ReplicaResult
+{
+    uint32_t seed;
+    bool completed; // Set by the parent from ReplicaSlot::completed
+    uint32_t spawned;
+    uint32_t exited;
+    uint32_t routedExited;
+    double travelTicks; // Spawn to exit, summed over routed vehicles that left
+    double heldTicks;   // Waiting at red, summed over the same vehicles
+    uint32_t routedRemaining; // Routed vehicles still on the map at the end
+    double heldTicksRemaining; // Waiting at red so far, summed over those
+    uint32_t breakdowns;
+    uint32_t challans;
+    uint32_t overlaps;    // Conflict events in the intersection box
+    uint32_t nearMisses;
+};
+
+struct ReplicaSlot
+{
+    atomic<uint32_t> completed; // Stored by the worker once result is final, read by the parent meanwhile
+    ReplicaResult result;
+};
+
+struct ReplicaSegment
+{
+    atomic<int> nextTask;
+    ReplicaSlot slots[1]; // One per task
+};
+
+// Two-sided 95% Student t critical value for the given degrees of freedom
+inline double tCritical95(int df)
+{
+    static const double table[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                   2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                   2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    if (df < 1)
+        return NAN;
+    if (df <= 30)
+        return table[df - 1];
+    if (df <= 40)
+        return 2.021;
+    if (df <= 60)
+        return 2.000;
+    if (df <= 120)
+        return 1.980;
+    return 1.960;
+}
+
+// Runs one replica to completion as fast as the CPU allows; every timer counts ticks, so the
+// result does not depend on how long a tick takes to compute. The workers already keep every
+// core busy, so a replica creates no threads or processes of its own.
+inline void runReplica(const ReplicaTask &task, const ReplicaOptions &options, ReplicaResult &result)
+{
+    Simulation sim(*task.scenario, task.startTime, options.timeWarp, task.seed, false);
+    sim.spawnCheckThreads = 1;
+    unordered_map<unsigned, unsigned> enteredAt; // Car id -> spawn tick
+    ConflictDetector conflicts(intersectionZones(*task.scenario));
+    TrajectoryFrame frame;
+
+    while (sim.tick < options.ticks)
+    {
+        sim.step();
+
+        for (Car *car : sim.spawnedCars)
+            enteredAt[car->getId()] = sim.tick - 1;
+        result.spawned += sim.spawnedCars.size();
+        result.exited += sim.removedCars.size();
+        for (Car *car : sim.removedCars)
+        {
+            auto entered = enteredAt.find(car->getId());
+            if (entered == enteredAt.end())
+                continue;
+            if (car->getRoute() != nullptr)
+            {
+                result.routedExited++;
+                result.travelTicks += sim.tick - entered->second;
+                result.heldTicks += car->getHeldTicks();
+            }
+            enteredAt.erase(entered);
+        }
+
+        captureFrame(frame, sim.tick - 1, 0, sim.cars.data(), sim.carData.data(), sim.carCount, sim.trafficController->signals(), task.scenario->lightCount);
+        conflicts.observe(frame);
+    }
+
+    for (int i = 0; i < sim.carCount; i++)
+    {
+        if (sim.cars[i]->getRoute() != nullptr)
+        {
+            result.routedRemaining++;
+            result.heldTicksRemaining += sim.cars[i]->getHeldTicks();
+        }
+    }
+    result.breakdowns = sim.stats.totalBreakdowns;
+    result.challans = sim.challanGenerator.getTotalChallanCount();
+    result.overlaps = conflicts.getCount(CONFLICT_OVERLAP);
+    result.nearMisses = conflicts.getCount(CONFLICT_NEAR_MISS);
+}
+
+inline void replicaWorker(const vector<ReplicaTask> &tasks, const ReplicaOptions &options, ReplicaSegment *segment)
+{
+    // Challan and breakdown messages from hundreds of runs are of no use
+    if (freopen("/dev/null", "w", stdout) == nullptr)
+        cerr << "Replicas: cannot silence worker output\n";
+
+    int task;
+    while ((task = segment->nextTask.fetch_add(1)) < (int)tasks.size())
+    {
+        runReplica(tasks[task], options, segment->slots[task].result);
+        segment->slots[task].completed.store(1, memory_order_release);
+    }
+}
+
+// Runs every task across options.jobs worker processes; results[i] belongs to tasks[i] and is
+// marked completed unless its worker died. Progress goes to stderr unless quiet.
+inline bool runReplicaBatch(const vector<ReplicaTask> &tasks, const ReplicaOptions &options, vector<ReplicaResult> &results, bool quiet = false)
+{
+    int jobs = max(1, min(options.jobs, (int)tasks.size()));
+    size_t bytes = sizeof(ReplicaSegment) + sizeof(ReplicaSlot) * max<size_t>(tasks.size(), 1);
+    void *mapped = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mapped == MAP_FAILED)
+    {
+        cerr << "Replicas: cannot map " << bytes << " bytes of results\n";
+        return false;
+    }
+    ReplicaSegment *segment = new (mapped) ReplicaSegment();
+    segment->nextTask = 0;
+    for (size_t i = 0; i < tasks.size(); i++)
+    {
+        new (&segment->slots[i]) ReplicaSlot();
+        segment->slots[i].completed = 0;
+        segment->slots[i].result = {tasks[i].seed, false, 0, 0, 0, 0.0, 0.0, 0, 0.0, 0, 0, 0, 0};
+    }
+
+    cout.flush(); // Workers inherit the buffer otherwise
+    vector<pid_t> workers;
+    for (int i = 0; i < jobs; i++)
+    {
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            cerr << "Replicas: fork failed, continuing with " << workers.size() << " workers\n";
+            break;
+        }
+        if (pid == 0)
+        {
+            replicaWorker(tasks, options, segment);
+            _exit(0);
+        }
+        workers.push_back(pid);
+    }
+
+    // Wait for every worker, reporting progress as tasks complete
+    int reported = -1;
+    size_t running = workers.size();
+    while (running > 0)
+    {
+        for (pid_t &pid : workers)
+        {
+            if (pid > 0 && waitpid(pid, nullptr, WNOHANG) == pid)
+            {
+                pid = 0; // Reaped
+                running--;
+            }
+        }
+
+        int completed = 0;
+        for (size_t i = 0; i < tasks.size(); i++)
+            completed += segment->slots[i].completed.load(memory_order_acquire);
+        if (!quiet && completed != reported)
+        {
+            reported = completed;
+            cerr << "\rReplicas: " << completed << "/" << tasks.size() << " done" << flush;
+        }
+        if (running > 0)
+            sf::sleep(sf::milliseconds(200));
+    }
+    if (!quiet)
+        cerr << "\n";
+
+    results.resize(tasks.size());
+    for (size_t i = 0; i < tasks.size(); i++)
+    {
+        results[i] = segment->slots[i].result;
+        results[i].completed = segment->slots[i].completed.load(memory_order_acquire) != 0;
+    }
+    munmap(mapped, bytes);
+    return !workers.empty();
+}
+
+// Per-replica value of each reported metric
+struct ReplicaMetric
+{
+    const char *name;
+    double (*value)(const ReplicaResult &, const ReplicaOptions &);
+};
+
+inline double replicaThroughput(const ReplicaResult &r, const ReplicaOptions &o) { return r.exited / (o.ticks * o.tickSeconds / 3600.0); }
+inline double replicaTravelTime(const ReplicaResult &r, const ReplicaOptions &o) { return r.routedExited ? r.travelTicks / r.routedExited * o.tickSeconds : NAN; }
+inline double replicaDelay(const ReplicaResult &r, const ReplicaOptions &o) { return r.routedExited ? r.heldTicks / r.routedExited * o.tickSeconds : NAN; }
+inline double replicaSpawned(const ReplicaResult &r, const ReplicaOptions &) { return r.spawned; }
+inline double replicaBreakdowns(const ReplicaResult &r, const ReplicaOptions &) { return r.breakdowns; }
+inline double replicaChallans(const ReplicaResult &r, const ReplicaOptions &) { return r.challans; }
+inline double replicaOverlaps(const ReplicaResult &r, const ReplicaOptions &) { return r.overlaps; }
+inline double replicaNearMisses(const ReplicaResult &r, const ReplicaOptions &) { return r.nearMisses; }
+
+const ReplicaMetric REPLICA_METRICS[] = {
+    {"throughput (veh/h)", replicaThroughput},
+    {"travel time (s)", replicaTravelTime},
+    {"delay at red (s)", replicaDelay},
+    {"vehicles spawned", replicaSpawned},
+    {"breakdowns", replicaBreakdowns},
+    {"challans", replicaChallans},
+    {"overlaps", replicaOverlaps},
+    {"near misses", replicaNearMisses},
+};
+
+inline void reportReplicas(const ReplicaOptions &options, const ReplicaResult *results)
+{
+    int completed = 0;
+    for (int i = 0; i < options.replicas; i++)
+        completed += results[i].completed;
+
+    cout << "Replicas: " << completed << " of " << options.replicas << " completed, "
+         << options.ticks << " ticks each, seeds " << options.baseSeed << ".." << options.baseSeed + options.replicas - 1 << "\n";
+    cout << left << setw(22) << "metric" << right << setw(12) << "mean" << setw(12) << "95% CI +-"
+         << setw(12) << "stddev" << setw(12) << "min" << setw(12) << "max" << "\n";
+
+    for (const ReplicaMetric &metric : REPLICA_METRICS)
+    {
+        vector<double> values;
+        for (int i = 0; i < options.replicas; i++)
+        {
+            double value = results[i].completed ? metric.value(results[i], options) : NAN;
+            if (!std::isnan(value))
+                values.push_back(value);
+        }
+
+        double sum = 0, lowest = INFINITY, highest = -INFINITY;
+        for (double value : values)
+        {
+            sum += value;
+            lowest = min(lowest, value);
+            highest = max(highest, value);
+        }
+        int n = values.size();
+        double mean = n ? sum / n : NAN;
+        double squares = 0;
+        for (double value : values)
+            squares += (value - mean) * (value - mean);
+        double stddev = n > 1 ? sqrt(squares / (n - 1)) : NAN;
+        double halfWidth = n > 1 ? tCritical95(n - 1) * stddev / sqrt((double)n) : NAN;
+
+        cout << left << setw(22) << metric.name << right << fixed << setprecision(2)
+             << setw(12) << mean << setw(12) << halfWidth << setw(12) << stddev
+             << setw(12) << lowest << setw(12) << highest << "\n";
+        cout.unsetf(ios::fixed);
+    }
+}
+
+inline bool writeReplicaCsv(const ReplicaOptions &options, const ReplicaResult *results)
+{
+    ofstream csv(options.csvPath);
+    if (!csv)
+    {
+        cerr << "Replicas: cannot write " << options.csvPath << "\n";
+        return false;
+    }
+    csv << "replica,seed,completed";
+    for (const ReplicaMetric &metric : REPLICA_METRICS)
+        csv << "," << metric.name;
+    csv << "\n";
+    for (int i = 0; i < options.replicas; i++)
+    {
+        csv << i << "," << results[i].seed << "," << results[i].completed;
+        for (const ReplicaMetric &metric : REPLICA_METRICS)
+            csv << "," << (results[i].completed ? metric.value(results[i], options) : NAN);
+        csv << "\n";
+    }
+    cout << "Replicas: wrote " << options.csvPath << "\n";
+    return static_cast<bool>(csv);
+}
+
+// Runs every replica across options.jobs worker processes and reports the statistics.
+// Returns false when no replica completed.
+inline bool runReplicas(const ScenarioBlob &scenario, ReplicaOptions options)
+{
+    options.replicas = max(1, options.replicas);
+    vector<ReplicaTask> tasks;
+    for (int i = 0; i < options.replicas; i++)
+        tasks.push_back({&scenario, options.baseSeed + (uint32_t)i, options.startTime});
+
+    cout << "Replicas: running " << options.replicas << " replicas on "
+         << max(1, min(options.jobs, options.replicas)) << " workers\n";
+    vector<ReplicaResult> results;
+    if (!runReplicaBatch(tasks, options, results))
+        return false;
+
+    reportReplicas(options, results.data());
+    bool ok = false;
+    for (const ReplicaResult &result : results)
+        ok = ok || result.completed;
+    if (!options.csvPath.empty())
+        ok = writeReplicaCsv(options, results.data()) && ok;
+    return ok;
+}
@@ -5,44 +5,40 @@ RoadTile::RoadTile(tRoadTileType t, int row, int col) {
     this->x = col * TILEWIDTH; //Since every roadtile is 239x239, we converted coordinates to column/row number * 239
     this->y = row * TILEHEIGHT;
 
-    //Loading the textures for different types of roadtiles
+    //Loading the texture for this type of roadtile
+    if (t != NONE)
+        texture.loadFromFile(roadTileImagePath(t));
+    sprite.setTexture(texture); //Setting the texture to the sprite
+    sprite.setPosition(sf::Vector2f(this->x, this->y)); //Setting the position of the roadtile sprite
+}
+
+// Image file of each roadtile type, shared with the software rasterizer
+const char *roadTileImagePath(tRoadTileType t) {
     switch (t) {
         case CTL: //Corner top left
-            texture.loadFromFile("images/roadpieces/corner-topleft.png");
-            break;
+            return "images/roadpieces/corner-topleft.png";
         case TTOP: // T junction at top, etc..
-            texture.loadFromFile("images/roadpieces/t-top.png");
-            break;
+            return "images/roadpieces/t-top.png";
         case CTR:
-            texture.loadFromFile("images/roadpieces/corner-topright.png");
-            break;
+            return "images/roadpieces/corner-topright.png";
         case TLEFT:
-            texture.loadFromFile("images/roadpieces/t-left.png");
-            break;
+            return "images/roadpieces/t-left.png";
         case CROSS:
-            texture.loadFromFile("images/roadpieces/cross.png");
-            break;
+            return "images/roadpieces/cross.png";
         case TRIGHT:
-            texture.loadFromFile("images/roadpieces/t-right.png");
-            break;
+            return "images/roadpieces/t-right.png";
         case CBL:
-            texture.loadFromFile("images/roadpieces/corner-bottomleft.png");
-            break;
+            return "images/roadpieces/corner-bottomleft.png";
         case TBOT:
-            texture.loadFromFile("images/roadpieces/t-bottom.png");
-            break;
+            return "images/roadpieces/t-bottom.png";
         case CBR:
-            texture.loadFromFile("images/roadpieces/corner-bottomright.png");
-            break;
+            return "images/roadpieces/corner-bottomright.png";
         case HOR:
-            texture.loadFromFile("images/roadpieces/straight-horizontal.png");
-            break;
+            return "images/roadpieces/straight-horizontal.png";
         case VER:
-            texture.loadFromFile("images/roadpieces/straight-vertical.png");
-            break;
+            return "images/roadpieces/straight-vertical.png";
         case NONE:
             break;
     }
-    sprite.setTexture(texture); //Setting the texture to the sprite
-    sprite.setPosition(sf::Vector2f(this->x, this->y)); //Setting the position of the roadtile sprite
+    return "";
 }
@@ -23,6 +23,8 @@ typedef enum
     CROSS
 } tRoadTileType; // Road tile types
 
+const char *roadTileImagePath(tRoadTileType t); // Image file of a roadtile type, "" for NONE
+
 class RoadTile
 {
     float x, y; // Coordinates
@@ -0,0 +1,180 @@
+#pragma once
+#include <SFML/System.hpp>
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include "i220776_D_scenario.h"
+
+using namespace std;
+
+// Turning movements.
+// For every entry lane and movement (left, through, right) a polyline is built once from the
+// scenario: straight down the entry lane, a rounded corner onto a lane of the new heading, then
+// straight off the map. Lanes of a heading are the spawn lanes travelling that way. Traffic
+// keeps to the left, so left turns take the nearest lane of the new heading and right turns
+// the farthest. At runtime a car only walks its polyline (see Car::followRoute).
+
+enum tMovement
+{
+    MOVE_LEFT = 0, // Same order as ScenarioBlob::turnRatios
+    MOVE_THROUGH = 1,
+    MOVE_RIGHT = 2
+};
+
+const float ROUTE_TURN_RADIUS = 40.0f;  // Corner rounding, in pixels
+const int ROUTE_CURVE_POINTS = 8;       // Polyline points per corner
+const float ROUTE_EXIT_MARGIN = 100.0f; // Routes end this far outside the window
+
+struct Route
+{
+    int entryLane;
+    tMovement movement;
+    float entryDir;     // Heading on the approach; selects the traffic light
+    float stopProgress; // Distance along the route of the stop line; past it the light no longer applies
+    vector<sf::Vector2f> points;
+    vector<float> distances; // Distance along the route of each point
+    vector<float> headings;  // Cardinal heading of each segment (points[i] to points[i + 1])
+
+    float length() const { return distances.empty() ? 0.0f : distances.back(); }
+};
+
+class RouteTable
+{
+    Route routes[SCENARIO_LANES][3];
+    float turnRatios[SCENARIO_LANES][3];
+
+public:
+    RouteTable(const ScenarioBlob &scenario)
+    {
+        for (int lane = 0; lane < SCENARIO_LANES; lane++)
+        {
+            for (int movement = MOVE_LEFT; movement <= MOVE_RIGHT; movement++)
+                build(scenario, lane, static_cast<tMovement>(movement));
+
+            float total = 0;
+            for (int movement = MOVE_LEFT; movement <= MOVE_RIGHT; movement++)
+                total += scenario.turnRatios[lane][movement];
+            for (int movement = MOVE_LEFT; movement <= MOVE_RIGHT; movement++)
+                turnRatios[lane][movement] = scenario.turnRatios[lane][movement] / total;
+        }
+    }
+
+    const Route &get(int lane, tMovement movement) const { return routes[lane][movement]; }
+
+    // Movement drawn from the lane's turn ratios; roll is uniform in [0, 1)
+    const Route &pick(int lane, float roll) const
+    {
+        if (roll < turnRatios[lane][MOVE_LEFT])
+            return routes[lane][MOVE_LEFT];
+        if (roll < turnRatios[lane][MOVE_LEFT] + turnRatios[lane][MOVE_THROUGH])
+            return routes[lane][MOVE_THROUGH];
+        return routes[lane][MOVE_RIGHT];
+    }
+
+private:
+    static sf::Vector2f headingVector(float dir)
+    {
+        if (dir == 0)
+            return sf::Vector2f(0, 1);
+        if (dir == 90)
+            return sf::Vector2f(1, 0);
+        if (dir == 180)
+            return sf::Vector2f(0, -1);
+        return sf::Vector2f(-1, 0);
+    }
+
+    // Point where a car moving from p along heading leaves the window plus the margin
+    static sf::Vector2f exitPoint(const ScenarioBlob &scenario, sf::Vector2f p, float dir)
+    {
+        if (dir == 0)
+            return sf::Vector2f(p.x, scenario.windowHeight + ROUTE_EXIT_MARGIN);
+        if (dir == 90)
+            return sf::Vector2f(scenario.windowWidth + ROUTE_EXIT_MARGIN, p.y);
+        if (dir == 180)
+            return sf::Vector2f(p.x, -ROUTE_EXIT_MARGIN);
+        return sf::Vector2f(-ROUTE_EXIT_MARGIN, p.y);
+    }
+
+    void build(const ScenarioBlob &scenario, int lane, tMovement movement)
+    {
+        Route &route = routes[lane][movement];
+        const float *spawn = scenario.spawnPositions[lane];
+        sf::Vector2f start(spawn[0], spawn[1]);
+        float dir = spawn[2];
+
+        route.entryLane = lane;
+        route.movement = movement;
+        route.entryDir = dir;
+        float stopDistance;
+        route.stopProgress = scenario.distanceToStopLine(start.x, start.y, stopDistance) ? stopDistance : 0.0f;
+        route.points.clear();
+        route.points.push_back(start);
+
+        float exitDir = movement == MOVE_LEFT ? fmod(dir + 90, 360) : movement == MOVE_RIGHT ? fmod(dir + 270, 360) : dir;
+        bool vertical = (dir == 0 || dir == 180);
+
+        // Corner onto each lane of the new heading, nearest first along the approach
+        float nearest = INFINITY, farthest = -INFINITY;
+        sf::Vector2f nearestCorner, farthestCorner;
+        for (int other = 0; other < SCENARIO_LANES && movement != MOVE_THROUGH; other++)
+        {
+            if (scenario.spawnPositions[other][2] != exitDir)
+                continue;
+            sf::Vector2f corner = vertical ? sf::Vector2f(start.x, scenario.spawnPositions[other][1])
+                                           : sf::Vector2f(scenario.spawnPositions[other][0], start.y);
+            sf::Vector2f ahead = headingVector(dir);
+            float along = (corner.x - start.x) * ahead.x + (corner.y - start.y) * ahead.y;
+            if (along <= ROUTE_TURN_RADIUS)
+                continue; // Behind the spawn point
+            if (along < nearest)
+            {
+                nearest = along;
+                nearestCorner = corner;
+            }
+            if (along > farthest)
+            {
+                farthest = along;
+                farthestCorner = corner;
+            }
+        }
+
+        if (movement == MOVE_THROUGH || nearest == INFINITY)
+        {
+            if (movement != MOVE_THROUGH)
+                cerr << "Routes: lane " << lane << " has no lane to turn into, driving straight\n";
+            route.points.push_back(exitPoint(scenario, start, dir));
+        }
+        else
+        {
+            sf::Vector2f corner = movement == MOVE_LEFT ? nearestCorner : farthestCorner;
+            sf::Vector2f in = headingVector(dir);
+            sf::Vector2f out = headingVector(exitDir);
+            sf::Vector2f a = corner - in * ROUTE_TURN_RADIUS;
+            sf::Vector2f b = corner + out * ROUTE_TURN_RADIUS;
+
+            // Quadratic curve a -> b with the corner as control point
+            for (int i = 0; i <= ROUTE_CURVE_POINTS; i++)
+            {
+                float t = (float)i / ROUTE_CURVE_POINTS;
+                route.points.push_back(a * ((1 - t) * (1 - t)) + corner * (2 * (1 - t) * t) + b * (t * t));
+            }
+            route.points.push_back(exitPoint(scenario, b, exitDir));
+        }
+
+        route.distances.assign(1, 0.0f);
+        route.headings.clear();
+        for (size_t i = 1; i < route.points.size(); i++)
+        {
+            sf::Vector2f step = route.points[i] - route.points[i - 1];
+            route.distances.push_back(route.distances.back() + sqrt(step.x * step.x + step.y * step.y));
+
+            // Snap to the closest of 0/90/180/270 so sprites and recordings keep cardinal headings
+            float heading;
+            if (fabs(step.y) >= fabs(step.x))
+                heading = step.y >= 0 ? 0 : 180;
+            else
+                heading = step.x >= 0 ? 90 : 270;
+            route.headings.push_back(heading);
+        }
+    }
+};
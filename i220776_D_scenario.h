@@ -0,0 +1,499 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "i220776_D_roadtile.h"
+#include "i220776_D_trafficlight.h"
+
+using namespace std;
+
+// Compiled scenario format.
+// A scenario text file (see scenarios/default.txt) is turned into a ScenarioBlob by the
+// scenario compiler (i220776_D_scenarioCompiler.cpp). The blob is a single fixed-size POD
+// record, so the simulator maps the file and reads it in place without any parsing.
+// Bump SCENARIO_VERSION whenever the layout below changes.
+
+const uint32_t SCENARIO_MAGIC = 0x46585453; // "STXF" in little-endian byte order
+const uint32_t SCENARIO_VERSION = 4;
+
+const int SCENARIO_LANES = 8;      // The simulator models exactly eight spawn lanes
+const int SCENARIO_MAX_TILES = 64;
+const int SCENARIO_MAX_LIGHTS = 4; // SmartTraffix tracks at most four lights
+const int SCENARIO_MAX_PASS_RULES = 16;
+const int SCENARIO_MAX_EXIT_RULES = 8;
+const int SCENARIO_MAX_CAR6_SPAWNS = 8;
+const int SCENARIO_PROFILE_SLOTS = 48; // Half-hour slots of a simulated day
+const int SCENARIO_MAX_WINDOW_SIZE = 8192; // Pixels per side, bounds the capture framebuffer
+const float DEFAULT_LIGHT_INTERVAL = 10.0f; // Seconds of green per light without a timing entry
+const float DEFAULT_PRIORITY_DURATION = 5.0f;
+
+enum ScenarioAxis
+{
+    AXIS_X = 0,
+    AXIS_Y = 1
+};
+
+enum ScenarioCompare
+{
+    COMPARE_LESS = 0,
+    COMPARE_GREATER = 1
+};
+
+enum ScenarioProfileKind
+{
+    PROFILE_DEMAND = 0, // Divides the lane's spawnInterval
+    PROFILE_CAR5 = 1,   // Multiplies car5Probability
+    PROFILE_CAR6 = 2    // Divides the CAR6 spawn interval, 0 keeps heavy vehicles out
+};
+
+// Per-lane spawn and speed settings, mirrors LaneConfig
+struct ScenarioLane
+{
+    float speed; // Initial lane speed
+    float spawnInterval;
+    float car5Probability;
+    float car5Interval;
+};
+
+struct ScenarioTile
+{
+    int32_t type; // tRoadTileType
+    int32_t row;
+    int32_t col;
+};
+
+struct ScenarioLight
+{
+    float x, y, rotation;
+    int32_t state; // tLightState
+    float approachDir; // Direction of travel of the cars this light controls
+};
+
+// A car matches when its coordinate on fixedAxis equals fixedValue and its other
+// coordinate is below/above threshold. Used for the stop lines and the exit edges.
+struct ScenarioLineTest
+{
+    int32_t fixedAxis; // ScenarioAxis
+    float fixedValue;
+    int32_t compare; // ScenarioCompare
+    float threshold;
+
+    bool matches(float x, float y) const
+    {
+        float fixed = fixedAxis == AXIS_X ? x : y;
+        float other = fixedAxis == AXIS_X ? y : x;
+        if (fixed != fixedValue)
+            return false;
+        return compare == COMPARE_LESS ? other < threshold : other > threshold;
+    }
+};
+
+// Cars past a stop line keep moving regardless of the light
+struct ScenarioPassRule
+{
+    ScenarioLineTest test;
+};
+
+// Cars heading in dir that match test leave the map and release their two lanes
+struct ScenarioExitRule
+{
+    float dir;
+    ScenarioLineTest test;
+    int32_t lanes[2];
+};
+
+// Time-of-day multipliers for one lane, indexed by half-hour slot of the simulated day
+struct ScenarioProfile
+{
+    float series[3][SCENARIO_PROFILE_SLOTS]; // Indexed by ScenarioProfileKind
+};
+
+// Signal timing in force during one profile slot
+struct ScenarioTiming
+{
+    float cycle;    // Seconds for one rotation through every light
+    float priority; // Seconds a CAR5 keeps its green after its last request
+    float splits[SCENARIO_MAX_LIGHTS]; // Share of the cycle each light is green, normalised over lightCount
+};
+
+struct ScenarioBlob
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size; // sizeof(ScenarioBlob) when written
+    uint32_t reserved;
+    char name[32];
+
+    int32_t windowWidth;
+    int32_t windowHeight;
+
+    int32_t tileCount;
+    int32_t lightCount;
+    int32_t passRuleCount;
+    int32_t exitRuleCount;
+    int32_t car6SpawnCount;
+    int32_t padding;
+
+    ScenarioLane lanes[SCENARIO_LANES];
+    float spawnPositions[SCENARIO_LANES][3]; // x, y, dir for each lane
+    ScenarioTile tiles[SCENARIO_MAX_TILES];
+    ScenarioLight lights[SCENARIO_MAX_LIGHTS];
+    ScenarioPassRule passRules[SCENARIO_MAX_PASS_RULES];
+    ScenarioExitRule exitRules[SCENARIO_MAX_EXIT_RULES];
+    int32_t car6Spawns[SCENARIO_MAX_CAR6_SPAWNS]; // Spawn lanes used for a CAR6 convoy
+    ScenarioProfile profiles[SCENARIO_LANES];
+    float turnRatios[SCENARIO_LANES][3]; // Left, through, right share of each lane's traffic
+    ScenarioTiming timings[SCENARIO_PROFILE_SLOTS];
+
+    // Index of the light controlling cars heading in dir, or -1
+    int lightForDirection(float dir) const
+    {
+        for (int i = 0; i < lightCount; i++)
+        {
+            if (lights[i].approachDir == dir)
+                return i;
+        }
+        return -1;
+    }
+
+    bool isPastStopLine(float x, float y) const
+    {
+        for (int i = 0; i < passRuleCount; i++)
+        {
+            if (passRules[i].test.matches(x, y))
+                return true;
+        }
+        return false;
+    }
+
+    // Signed distance from (x, y) to the stop line of the lane it is in: positive while the
+    // car is still approaching, zero or negative once past. False when no stop line covers the lane.
+    bool distanceToStopLine(float x, float y, float &distance) const
+    {
+        for (int i = 0; i < passRuleCount; i++)
+        {
+            const ScenarioLineTest &test = passRules[i].test;
+            float fixed = test.fixedAxis == AXIS_X ? x : y;
+            float other = test.fixedAxis == AXIS_X ? y : x;
+            if (fixed == test.fixedValue)
+            {
+                // Pass rules hold once the car is past the threshold, so the line is the threshold itself
+                distance = test.compare == COMPARE_GREATER ? test.threshold - other : other - test.threshold;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Exit rule matched by a car at (x, y) heading in dir, or nullptr
+    const ScenarioExitRule *exitRuleFor(float x, float y, float dir) const
+    {
+        for (int i = 0; i < exitRuleCount; i++)
+        {
+            if (exitRules[i].dir == dir && exitRules[i].test.matches(x, y))
+                return &exitRules[i];
+        }
+        return nullptr;
+    }
+};
+
+static_assert(std::is_trivially_copyable<ScenarioBlob>::value, "ScenarioBlob must stay a plain byte image");
+
+// Sets the left/through/right ratios of one lane, or of every lane when lane is -1
+inline void setTurnRatios(ScenarioBlob &blob, int lane, float left, float through, float right)
+{
+    for (int i = 0; i < SCENARIO_LANES; i++)
+    {
+        if (lane != -1 && lane != i)
+            continue;
+        blob.turnRatios[i][0] = left;
+        blob.turnRatios[i][1] = through;
+        blob.turnRatios[i][2] = right;
+    }
+}
+
+// Equal splits of DEFAULT_LIGHT_INTERVAL per light, the fixed rotation SmartTraffix always had
+inline ScenarioTiming defaultTiming(int lightCount)
+{
+    ScenarioTiming timing = {};
+    timing.cycle = DEFAULT_LIGHT_INTERVAL * lightCount;
+    timing.priority = DEFAULT_PRIORITY_DURATION;
+    for (int i = 0; i < lightCount; i++)
+        timing.splits[i] = 1.0f / lightCount;
+    return timing;
+}
+
+// Sets slots [fromSlot, toSlot), wrapping past midnight like setProfileRange
+inline void setTimingRange(ScenarioBlob &blob, int fromSlot, int toSlot, const ScenarioTiming &timing)
+{
+    int slot = fromSlot;
+    do
+    {
+        blob.timings[slot] = timing;
+        slot = (slot + 1) % SCENARIO_PROFILE_SLOTS;
+    } while (slot != toSlot);
+}
+
+// Every multiplier of every lane back to 1 (flat demand)
+inline void resetProfiles(ScenarioBlob &blob)
+{
+    for (ScenarioProfile &profile : blob.profiles)
+    {
+        for (auto &series : profile.series)
+        {
+            for (float &value : series)
+                value = 1.0f;
+        }
+    }
+}
+
+// Sets slots [fromSlot, toSlot) of one lane, or of every lane when lane is -1.
+// A range with toSlot <= fromSlot wraps past midnight.
+inline void setProfileRange(ScenarioBlob &blob, int lane, ScenarioProfileKind kind, int fromSlot, int toSlot, float multiplier)
+{
+    for (int i = 0; i < SCENARIO_LANES; i++)
+    {
+        if (lane != -1 && lane != i)
+            continue;
+        int slot = fromSlot;
+        do
+        {
+            blob.profiles[i].series[kind][slot] = multiplier;
+            slot = (slot + 1) % SCENARIO_PROFILE_SLOTS;
+        } while (slot != toSlot);
+    }
+}
+
+// Returns an empty message when the blob is usable, otherwise the reason it is not
+inline string validateScenario(const ScenarioBlob &blob)
+{
+    if (blob.magic != SCENARIO_MAGIC)
+        return "bad magic";
+    if (blob.version != SCENARIO_VERSION)
+        return "unsupported version " + to_string(blob.version);
+    if (blob.size != sizeof(ScenarioBlob))
+        return "size mismatch";
+    if (memchr(blob.name, '\0', sizeof(blob.name)) == nullptr)
+        return "name is not terminated";
+    if (blob.windowWidth < 1 || blob.windowWidth > SCENARIO_MAX_WINDOW_SIZE || blob.windowHeight < 1 || blob.windowHeight > SCENARIO_MAX_WINDOW_SIZE)
+        return "window size must be 1-" + to_string(SCENARIO_MAX_WINDOW_SIZE);
+    if (blob.tileCount < 0 || blob.tileCount > SCENARIO_MAX_TILES)
+        return "too many tiles";
+    if (blob.lightCount < 1 || blob.lightCount > SCENARIO_MAX_LIGHTS)
+        return "light count must be 1-" + to_string(SCENARIO_MAX_LIGHTS);
+    if (blob.passRuleCount < 0 || blob.passRuleCount > SCENARIO_MAX_PASS_RULES)
+        return "too many pass rules";
+    if (blob.exitRuleCount < 0 || blob.exitRuleCount > SCENARIO_MAX_EXIT_RULES)
+        return "too many exit rules";
+    if (blob.car6SpawnCount < 0 || blob.car6SpawnCount > SCENARIO_MAX_CAR6_SPAWNS)
+        return "too many car6 spawns";
+    for (int i = 0; i < blob.tileCount; i++)
+    {
+        const ScenarioTile &tile = blob.tiles[i];
+        if (tile.type < NONE || tile.type > CROSS)
+            return "tile type out of range";
+        // Tiles are placed at row * TILEHEIGHT, col * TILEWIDTH and must start inside the window
+        if (tile.row < 0 || tile.col < 0 || tile.row >= (blob.windowHeight + TILEHEIGHT - 1) / TILEHEIGHT || tile.col >= (blob.windowWidth + TILEWIDTH - 1) / TILEWIDTH)
+            return "tile position outside the window";
+    }
+    for (int i = 0; i < blob.lightCount; i++)
+    {
+        const ScenarioLight &light = blob.lights[i];
+        if (light.state != GREEN && light.state != RED)
+            return "light state must be GREEN or RED";
+        if (light.approachDir != 0 && light.approachDir != 90 && light.approachDir != 180 && light.approachDir != 270)
+            return "light approach direction must be 0, 90, 180 or 270";
+    }
+    for (int i = 0; i < blob.car6SpawnCount; i++)
+    {
+        if (blob.car6Spawns[i] < 0 || blob.car6Spawns[i] >= SCENARIO_LANES)
+            return "car6 spawn lane out of range";
+    }
+    for (int i = 0; i < blob.exitRuleCount; i++)
+    {
+        for (int lane : blob.exitRules[i].lanes)
+        {
+            if (lane < 0 || lane >= SCENARIO_LANES)
+                return "exit rule lane out of range";
+        }
+    }
+    for (const auto &ratios : blob.turnRatios)
+    {
+        if (!(ratios[0] >= 0 && ratios[1] >= 0 && ratios[2] >= 0 && ratios[0] + ratios[1] + ratios[2] > 0))
+            return "turn ratios must be non-negative and not all zero";
+    }
+    for (const ScenarioTiming &timing : blob.timings)
+    {
+        float splitSum = 0;
+        for (int i = 0; i < blob.lightCount; i++)
+        {
+            if (!(timing.splits[i] >= 0))
+                return "negative or invalid timing split";
+            splitSum += timing.splits[i];
+        }
+        if (!(timing.cycle > 0 && timing.priority >= 0 && splitSum > 0))
+            return "timing needs a positive cycle, a non-negative priority and a non-zero split";
+    }
+    for (const ScenarioProfile &profile : blob.profiles)
+    {
+        for (const auto &series : profile.series)
+        {
+            for (float value : series)
+            {
+                if (!(value >= 0.0f))
+                    return "negative or invalid profile multiplier";
+            }
+        }
+    }
+    return "";
+}
+
+// The four-way intersection that used to be hard-coded in main()
+inline ScenarioBlob defaultScenario()
+{
+    ScenarioBlob blob;
+    memset(&blob, 0, sizeof(blob));
+    blob.magic = SCENARIO_MAGIC;
+    blob.version = SCENARIO_VERSION;
+    blob.size = sizeof(ScenarioBlob);
+    strncpy(blob.name, "default", sizeof(blob.name) - 1);
+    blob.windowWidth = 1000;
+    blob.windowHeight = 1000;
+
+    const ScenarioLane lanes[SCENARIO_LANES] = {
+        {6.0f, 1.0f, 0.20f, 15.0f}, {6.0f, 1.0f, 0.20f, 15.0f}, // North lanes
+        {6.0f, 2.0f, 0.05f, 15.0f}, {6.0f, 2.0f, 0.05f, 15.0f}, // South lanes
+        {6.0f, 1.5f, 0.10f, 20.0f}, {6.0f, 1.5f, 0.10f, 20.0f}, // East lanes
+        {6.0f, 2.0f, 0.30f, 15.0f}, {6.0f, 2.0f, 0.30f, 15.0f}  // West lanes
+    };
+    const float spawns[SCENARIO_LANES][3] = {
+        {510, -80, 0}, {545, -80, 0}, {405, 1070, 180}, {445, 1070, 180},
+        {-80, 445, 90}, {-80, 407, 90}, {1070, 500, 270}, {1070, 545, 270}};
+    memcpy(blob.lanes, lanes, sizeof(lanes));
+    memcpy(blob.spawnPositions, spawns, sizeof(spawns));
+
+    const ScenarioTile tiles[] = {
+        {VER, 0, 2}, {VER, 1, 2}, {HOR, 2, 0}, {HOR, 2, 1}, {CROSS, 2, 2}, {HOR, 2, 3},
+        {HOR, 2, 4}, {HOR, 2, 5}, {VER, 4, 2}, {VER, 3, 2}, {VER, 5, 2}};
+    blob.tileCount = sizeof(tiles) / sizeof(tiles[0]);
+    memcpy(blob.tiles, tiles, sizeof(tiles));
+
+    const ScenarioLight lights[] = {
+        {535, 500, 180, GREEN, 270},
+        {510, 500, 90, RED, 180},
+        {430, 500, 180, RED, 90},
+        {500, 400, 90, GREEN, 0}};
+    blob.lightCount = 4;
+    memcpy(blob.lights, lights, sizeof(lights));
+
+    const ScenarioPassRule passRules[] = {
+        {{AXIS_Y, 500, COMPARE_LESS, 600}},
+        {{AXIS_Y, 545, COMPARE_LESS, 600}},
+        {{AXIS_Y, 445, COMPARE_GREATER, 370}},
+        {{AXIS_Y, 407, COMPARE_GREATER, 370}},
+        {{AXIS_X, 510, COMPARE_GREATER, 400}},
+        {{AXIS_X, 545, COMPARE_GREATER, 400}},
+        {{AXIS_X, 405, COMPARE_LESS, 600}},
+        {{AXIS_X, 445, COMPARE_LESS, 600}}};
+    blob.passRuleCount = sizeof(passRules) / sizeof(passRules[0]);
+    memcpy(blob.passRules, passRules, sizeof(passRules));
+
+    const ScenarioExitRule exitRules[] = {
+        {90, {AXIS_Y, 445, COMPARE_GREATER, 1000}, {0, 1}},
+        {270, {AXIS_Y, 500, COMPARE_LESS, 0}, {2, 3}},
+        {0, {AXIS_X, 505, COMPARE_GREATER, 1000}, {4, 5}},
+        {180, {AXIS_X, 445, COMPARE_LESS, 0}, {6, 7}}};
+    blob.exitRuleCount = sizeof(exitRules) / sizeof(exitRules[0]);
+    memcpy(blob.exitRules, exitRules, sizeof(exitRules));
+
+    const int32_t car6Spawns[] = {7, 1, 5, 2};
+    blob.car6SpawnCount = 4;
+    memcpy(blob.car6Spawns, car6Spawns, sizeof(car6Spawns));
+
+    // Peaks at 07:00-09:30 and 16:30-20:30 double the demand and keep heavy vehicles out;
+    // the night is quiet
+    resetProfiles(blob);
+    setProfileRange(blob, -1, PROFILE_DEMAND, 14, 19, 2.0f);
+    setProfileRange(blob, -1, PROFILE_DEMAND, 33, 41, 2.0f);
+    setProfileRange(blob, -1, PROFILE_DEMAND, 46, 12, 0.4f);
+    setProfileRange(blob, -1, PROFILE_CAR6, 14, 19, 0.0f);
+    setProfileRange(blob, -1, PROFILE_CAR6, 33, 41, 0.0f);
+
+    setTurnRatios(blob, -1, 0.25f, 0.5f, 0.25f);
+    setTimingRange(blob, 0, 0, defaultTiming(blob.lightCount));
+
+    return blob;
+}
+
+// Read-only memory mapping of a compiled scenario file
+class ScenarioFile
+{
+    void *base;
+    size_t length;
+
+public:
+    ScenarioFile() : base(nullptr), length(0) {}
+    ScenarioFile(const ScenarioFile &) = delete;
+    ScenarioFile &operator=(const ScenarioFile &) = delete;
+
+    // Maps path and checks the header; the data is used in place afterwards
+    bool open(const string &path)
+    {
+        close();
+
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            cerr << "Scenario: cannot open " << path << "\n";
+            return false;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size != (off_t)sizeof(ScenarioBlob))
+        {
+            cerr << "Scenario: " << path << " is not a compiled scenario (wrong size)\n";
+            ::close(fd);
+            return false;
+        }
+
+        void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED)
+        {
+            cerr << "Scenario: mmap failed for " << path << "\n";
+            return false;
+        }
+
+        string error = validateScenario(*static_cast<const ScenarioBlob *>(mapped));
+        if (!error.empty())
+        {
+            cerr << "Scenario: " << path << ": " << error << "\n";
+            munmap(mapped, st.st_size);
+            return false;
+        }
+
+        base = mapped;
+        length = st.st_size;
+        return true;
+    }
+
+    const ScenarioBlob *get() const { return static_cast<const ScenarioBlob *>(base); }
+
+    void close()
+    {
+        if (base != nullptr)
+        {
+            munmap(base, length);
+            base = nullptr;
+            length = 0;
+        }
+    }
+
+    ~ScenarioFile() { close(); }
+};
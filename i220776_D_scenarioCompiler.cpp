@@ -0,0 +1,338 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <map>
+#include "i220776_D_scenario.h"
+
+// Scenario compiler: turns a scenario text description into the binary blob mapped by the simulator.
+//
+// Usage: ./scenarioc <scenario.txt> <scenario.bin>
+
+using namespace std;
+
+bool parseAxis(const string &text, int32_t &axis)
+{
+    if (text == "x")
+        axis = AXIS_X;
+    else if (text == "y")
+        axis = AXIS_Y;
+    else
+        return false;
+    return true;
+}
+
+bool parseCompare(const string &text, int32_t &compare)
+{
+    if (text == "lt")
+        compare = COMPARE_LESS;
+    else if (text == "gt")
+        compare = COMPARE_GREATER;
+    else
+        return false;
+    return true;
+}
+
+bool parseLineTest(istringstream &in, ScenarioLineTest &test)
+{
+    string axis, compare;
+    if (!(in >> axis >> test.fixedValue >> compare >> test.threshold))
+        return false;
+    return parseAxis(axis, test.fixedAxis) && parseCompare(compare, test.compare);
+}
+
+bool parseTileType(const string &text, int32_t &type)
+{
+    static const map<string, tRoadTileType> names = {
+        {"NONE", NONE}, {"HOR", HOR}, {"VER", VER}, {"TTOP", TTOP}, {"TBOT", TBOT}, {"TLEFT", TLEFT}, {"TRIGHT", TRIGHT}, {"CTL", CTL}, {"CTR", CTR}, {"CBL", CBL}, {"CBR", CBR}, {"CROSS", CROSS}};
+
+    auto it = names.find(text);
+    if (it == names.end())
+        return false;
+    type = it->second;
+    return true;
+}
+
+// "HH:MM" on a half-hour boundary to a profile slot; "24:00" is accepted as the end of the day
+bool parseSlot(const string &text, int &slot)
+{
+    int hours, minutes;
+    char colon;
+    istringstream in(text);
+    if (!(in >> hours >> colon >> minutes) || colon != ':' || (minutes != 0 && minutes != 30))
+        return false;
+    slot = hours * 2 + minutes / 30;
+    if (slot < 0 || slot > SCENARIO_PROFILE_SLOTS)
+        return false;
+    slot %= SCENARIO_PROFILE_SLOTS;
+    return true;
+}
+
+bool parseProfile(istringstream &in, ScenarioBlob &blob)
+{
+    static const map<string, ScenarioProfileKind> kinds = {
+        {"demand", PROFILE_DEMAND}, {"car5", PROFILE_CAR5}, {"car6", PROFILE_CAR6}};
+
+    string lane, kind, from, to;
+    float multiplier;
+    if (!(in >> lane >> kind >> from >> to >> multiplier))
+        return false;
+
+    auto it = kinds.find(kind);
+    int laneIndex = -1, fromSlot, toSlot;
+    if (it == kinds.end() || !parseSlot(from, fromSlot) || !parseSlot(to, toSlot))
+        return false;
+    if (lane != "all")
+    {
+        istringstream laneText(lane);
+        if (!(laneText >> laneIndex) || laneIndex < 0 || laneIndex >= SCENARIO_LANES)
+            return false;
+    }
+
+    setProfileRange(blob, laneIndex, it->second, fromSlot, toSlot, multiplier);
+    return true;
+}
+
+bool parseTiming(istringstream &in, ScenarioBlob &blob)
+{
+    string from, to;
+    ScenarioTiming timing = {};
+    int fromSlot, toSlot;
+    if (!(in >> from >> to >> timing.cycle >> timing.priority) || !parseSlot(from, fromSlot) || !parseSlot(to, toSlot))
+        return false;
+
+    int splitCount = 0;
+    while (splitCount < SCENARIO_MAX_LIGHTS && in >> timing.splits[splitCount])
+        splitCount++;
+    if (splitCount == 0 || !(in >> ws).eof())
+        return false;
+
+    setTimingRange(blob, fromSlot, toSlot, timing);
+    return true;
+}
+
+// Parses the text description into blob; reports the first error with its line number
+bool compileScenario(istream &input, ScenarioBlob &blob, string &error)
+{
+    memset(&blob, 0, sizeof(blob));
+    blob.magic = SCENARIO_MAGIC;
+    blob.version = SCENARIO_VERSION;
+    blob.size = sizeof(ScenarioBlob);
+    blob.windowWidth = 1000;
+    blob.windowHeight = 1000;
+    resetProfiles(blob);
+    setTurnRatios(blob, -1, 0.0f, 1.0f, 0.0f); // Straight through unless "turns" says otherwise
+
+    int laneCount = 0;
+    int spawnCount = 0;
+    string line;
+    int lineNumber = 0;
+
+    while (getline(input, line))
+    {
+        lineNumber++;
+        size_t comment = line.find('#');
+        if (comment != string::npos)
+            line = line.substr(0, comment);
+
+        istringstream in(line);
+        string keyword;
+        if (!(in >> keyword))
+            continue;
+
+        bool ok = true;
+        if (keyword == "name")
+        {
+            string name;
+            ok = static_cast<bool>(in >> name);
+            strncpy(blob.name, name.c_str(), sizeof(blob.name) - 1);
+        }
+        else if (keyword == "window")
+        {
+            ok = static_cast<bool>(in >> blob.windowWidth >> blob.windowHeight);
+        }
+        else if (keyword == "lane")
+        {
+            if (laneCount >= SCENARIO_LANES)
+            {
+                error = "more than " + to_string(SCENARIO_LANES) + " lanes";
+                ok = false;
+            }
+            else
+            {
+                ScenarioLane &lane = blob.lanes[laneCount++];
+                ok = static_cast<bool>(in >> lane.speed >> lane.spawnInterval >> lane.car5Probability >> lane.car5Interval);
+            }
+        }
+        else if (keyword == "spawn")
+        {
+            if (spawnCount >= SCENARIO_LANES)
+            {
+                error = "more than " + to_string(SCENARIO_LANES) + " spawn positions";
+                ok = false;
+            }
+            else
+            {
+                float *spawn = blob.spawnPositions[spawnCount++];
+                ok = static_cast<bool>(in >> spawn[0] >> spawn[1] >> spawn[2]);
+            }
+        }
+        else if (keyword == "tile")
+        {
+            string type;
+            if (blob.tileCount >= SCENARIO_MAX_TILES)
+            {
+                error = "too many tiles";
+                ok = false;
+            }
+            else
+            {
+                ScenarioTile &tile = blob.tiles[blob.tileCount++];
+                ok = (in >> type >> tile.row >> tile.col) && parseTileType(type, tile.type);
+            }
+        }
+        else if (keyword == "light")
+        {
+            string state;
+            if (blob.lightCount >= SCENARIO_MAX_LIGHTS)
+            {
+                error = "too many lights";
+                ok = false;
+            }
+            else
+            {
+                ScenarioLight &light = blob.lights[blob.lightCount++];
+                ok = static_cast<bool>(in >> light.x >> light.y >> light.rotation >> state >> light.approachDir);
+                if (state == "GREEN")
+                    light.state = GREEN;
+                else if (state == "RED")
+                    light.state = RED;
+                else
+                    ok = false;
+            }
+        }
+        else if (keyword == "pass")
+        {
+            if (blob.passRuleCount >= SCENARIO_MAX_PASS_RULES)
+            {
+                error = "too many pass rules";
+                ok = false;
+            }
+            else
+            {
+                ok = parseLineTest(in, blob.passRules[blob.passRuleCount++].test);
+            }
+        }
+        else if (keyword == "exit")
+        {
+            if (blob.exitRuleCount >= SCENARIO_MAX_EXIT_RULES)
+            {
+                error = "too many exit rules";
+                ok = false;
+            }
+            else
+            {
+                ScenarioExitRule &rule = blob.exitRules[blob.exitRuleCount++];
+                ok = (in >> rule.dir) && parseLineTest(in, rule.test) && (in >> rule.lanes[0] >> rule.lanes[1]);
+            }
+        }
+        else if (keyword == "car6")
+        {
+            int lane;
+            while (in >> lane)
+            {
+                if (blob.car6SpawnCount >= SCENARIO_MAX_CAR6_SPAWNS)
+                {
+                    error = "too many car6 spawns";
+                    ok = false;
+                    break;
+                }
+                blob.car6Spawns[blob.car6SpawnCount++] = lane;
+            }
+        }
+        else if (keyword == "turns")
+        {
+            string lane;
+            float left, through, right;
+            int laneIndex = -1;
+            ok = static_cast<bool>(in >> lane >> left >> through >> right);
+            if (ok && lane != "all")
+            {
+                istringstream laneText(lane);
+                ok = (laneText >> laneIndex) && laneIndex >= 0 && laneIndex < SCENARIO_LANES;
+            }
+            if (ok)
+                setTurnRatios(blob, laneIndex, left, through, right);
+        }
+        else if (keyword == "timing")
+            ok = parseTiming(in, blob);
+        else if (keyword == "profile")
+        {
+            ok = parseProfile(in, blob);
+        }
+        else
+        {
+            error = "unknown keyword '" + keyword + "'";
+            ok = false;
+        }
+
+        if (!ok)
+        {
+            if (error.empty())
+                error = "malformed '" + keyword + "' entry";
+            error = "line " + to_string(lineNumber) + ": " + error;
+            return false;
+        }
+    }
+
+    if (laneCount != SCENARIO_LANES || spawnCount != SCENARIO_LANES)
+    {
+        error = "exactly " + to_string(SCENARIO_LANES) + " lane and spawn entries are required";
+        return false;
+    }
+
+    // Slots without a timing entry keep the fixed rotation
+    for (ScenarioTiming &timing : blob.timings)
+    {
+        if (timing.cycle == 0)
+            timing = defaultTiming(blob.lightCount);
+    }
+
+    error = validateScenario(blob);
+    return error.empty();
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 3)
+    {
+        cerr << "Usage: " << argv[0] << " <scenario.txt> <scenario.bin>\n";
+        return 1;
+    }
+
+    ifstream input(argv[1]);
+    if (!input)
+    {
+        cerr << "Cannot open " << argv[1] << "\n";
+        return 1;
+    }
+
+    ScenarioBlob blob;
+    string error;
+    if (!compileScenario(input, blob, error))
+    {
+        cerr << argv[1] << ": " << error << "\n";
+        return 1;
+    }
+
+    ofstream output(argv[2], ios::binary | ios::trunc);
+    output.write(reinterpret_cast<const char *>(&blob), sizeof(blob));
+    if (!output)
+    {
+        cerr << "Cannot write " << argv[2] << "\n";
+        return 1;
+    }
+
+    cout << "Compiled scenario '" << blob.name << "' (" << sizeof(blob) << " bytes) to " << argv[2] << "\n";
+    return 0;
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include "i220776_D_trafficlight.h"
+#include "i220776_D_scenario.h"
+#include "i220776_D_simTick.h"
+
+using namespace std;
+
+// Signal phases and their publication.
+// A PhasePlan is the rotation compiled into a flat table: phase i gives the green to one light
+// for a whole number of ticks, and the light states of every phase are precomputed as one
+// SignalWord. Finding the phase for an offset into the cycle is a scan over at most
+// SCENARIO_MAX_LIGHTS entries, and the plan is only rebuilt when the timing changes.
+//
+// SmartTraffix publishes the current word through a SignalState: one atomic 32-bit store per
+// change, so any thread that loads it sees the light states, phase and priority flag of the same
+// instant, without a lock and without touching TrafficLight objects.
+
+// Bits 0-15: tLightState of light i (GREEN = 0, RED = 1), the layout of TrajectoryFrame::lightStates
+// Bits 16-23: phase of the plan, SIGNAL_NO_PHASE while a CAR5 holds priority
+// Bit 24: CAR5 priority active
+typedef uint32_t SignalWord;
+
+const uint32_t SIGNAL_LIGHT_MASK = 0xFFFF;
+const int SIGNAL_PHASE_SHIFT = 16;
+const uint32_t SIGNAL_NO_PHASE = 0xFF;
+const uint32_t SIGNAL_PRIORITY_BIT = 1u << 24;
+
+// Word with only light green, every other light of lightCount red
+inline SignalWord makeSignalWord(int lightCount, int green, uint32_t phase, bool priority)
+{
+    uint32_t lights = ((1u << lightCount) - 1) & ~(1u << green);
+    return lights | phase << SIGNAL_PHASE_SHIFT | (priority ? SIGNAL_PRIORITY_BIT : 0);
+}
+
+inline tLightState signalLight(SignalWord word, int light) { return static_cast<tLightState>((word >> light) & 1); }
+inline uint32_t signalLights(SignalWord word) { return word & SIGNAL_LIGHT_MASK; }
+inline uint32_t signalPhase(SignalWord word) { return (word >> SIGNAL_PHASE_SHIFT) & 0xFF; }
+inline bool signalPriority(SignalWord word) { return (word & SIGNAL_PRIORITY_BIT) != 0; }
+
+struct SignalPhase
+{
+    SimTick begin, end; // Offsets into the cycle, end exclusive
+    int green;          // Light holding the green
+    SignalWord word;
+};
+
+class PhasePlan
+{
+    SignalPhase phases[SCENARIO_MAX_LIGHTS];
+    int phaseCount;
+    SimTick cycleTicks;
+
+public:
+    PhasePlan() : phaseCount(0), cycleTicks(0) {}
+
+    // Green times in seconds, per light. The rotation goes 0, n-1, n-2, ..., 1 as it always has;
+    // every phase lasts at least one tick.
+    void compile(const float greenTimes[], int lightCount)
+    {
+        phaseCount = lightCount;
+        SimTick offset = 0;
+        for (int phase = 0; phase < lightCount; phase++)
+        {
+            int green = (lightCount - phase) % lightCount;
+            SimTick ticks = max<SimTick>(1, (SimTick)ceil(greenTimes[green] / SIM_TICK_SECONDS - 1e-3));
+            phases[phase] = {offset, offset + ticks, green, makeSignalWord(lightCount, green, phase, false)};
+            offset += ticks;
+        }
+        cycleTicks = offset;
+    }
+
+    int getPhaseCount() const { return phaseCount; }
+    SimTick getCycleTicks() const { return cycleTicks; }
+    const SignalPhase &phase(int index) const { return phases[index]; }
+
+    // Phase giving light its green
+    int phaseFor(int light) const
+    {
+        for (int index = 0; index < phaseCount; index++)
+        {
+            if (phases[index].green == light)
+                return index;
+        }
+        return 0;
+    }
+
+    // Phase running at offset ticks into the cycle; offset may exceed one cycle
+    int phaseAt(SimTick offset) const
+    {
+        offset %= cycleTicks;
+        int index = 0;
+        while (offset >= phases[index].end)
+            index++;
+        return index;
+    }
+};
+
+class SignalState
+{
+    atomic<SignalWord> word;
+
+public:
+    SignalState(SignalWord initial = 0) : word(initial) {}
+
+    SignalWord load() const { return word.load(memory_order_acquire); }
+    void publish(SignalWord value) { word.store(value, memory_order_release); }
+};
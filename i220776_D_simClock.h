@@ -0,0 +1,115 @@
+#pragma once
+#include <SFML/System.hpp>
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <cmath>
+#include <ctime>
+#include <cstdio>
+#include "i220776_D_car.h"
+#include "i220776_D_scenario.h"
+
+using namespace std;
+
+// Simulated time of day.
+// The clock advances by SIM_TICK_SECONDS per tick multiplied by a warp factor. Lane demand and
+// signal timing follow the scenario's time-of-day profiles (see scenarios/default.txt) instead of
+// the machine's wall clock. Warp only speeds up this clock: vehicles, spawn timers and light cycles
+// still move at SIM_TICK_SECONDS per tick, so a large warp is a time-lapse of the demand profile,
+// not a faster day. Run --headless --ticks unpaced to simulate a whole day quickly.
+
+const double SECONDS_PER_DAY = 24 * 60 * 60;
+const double SECONDS_PER_PROFILE_SLOT = SECONDS_PER_DAY / SCENARIO_PROFILE_SLOTS;
+const float DEFAULT_TIME_WARP = 1.0f;
+const float CAR6_SPAWN_INTERVAL = 15.0f; // Seconds between CAR6 convoys at multiplier 1
+
+class SimClock
+{
+    double secondsOfDay; // [0, SECONDS_PER_DAY)
+    unsigned day;
+    float warp;
+
+public:
+    SimClock(double startSeconds, float warp = DEFAULT_TIME_WARP) : secondsOfDay(0), day(0), warp(warp)
+    {
+        set(startSeconds, 0);
+    }
+
+    // Moves the clock forward by seconds of unwarped simulation time
+    void advance(float seconds)
+    {
+        secondsOfDay += seconds * warp;
+        while (secondsOfDay >= SECONDS_PER_DAY)
+        {
+            secondsOfDay -= SECONDS_PER_DAY;
+            day++;
+        }
+    }
+
+    void set(double seconds, unsigned newDay)
+    {
+        secondsOfDay = fmod(seconds, SECONDS_PER_DAY);
+        if (secondsOfDay < 0)
+            secondsOfDay += SECONDS_PER_DAY;
+        day = newDay;
+    }
+
+    double getSecondsOfDay() const { return secondsOfDay; }
+    unsigned getDay() const { return day; }
+    float getWarp() const { return warp; }
+    void setWarp(float newWarp) { warp = newWarp; }
+
+    // Half-hour slot indexing the scenario's demand profiles
+    int slot() const { return static_cast<int>(secondsOfDay / SECONDS_PER_PROFILE_SLOT) % SCENARIO_PROFILE_SLOTS; }
+
+    // "HH:MM"
+    string timeOfDay() const
+    {
+        int minutes = static_cast<int>(secondsOfDay / 60);
+        char text[16];
+        snprintf(text, sizeof(text), "%02d:%02d", minutes / 60, minutes % 60);
+        return text;
+    }
+
+    // Time of day on the machine's clock, the default starting point
+    static double localTimeOfDay()
+    {
+        time_t now = time(0);
+        tm *ltm = localtime(&now);
+        return ltm->tm_hour * 3600 + ltm->tm_min * 60 + ltm->tm_sec;
+    }
+};
+
+// Parses "HH:MM" into seconds since midnight
+bool parseTimeOfDay(const string &text, double &seconds)
+{
+    int hours, minutes;
+    char colon;
+    istringstream in(text);
+    if (!(in >> hours >> colon >> minutes) || colon != ':' || hours < 0 || hours > 23 || minutes < 0 || minutes > 59)
+    {
+        cerr << "Invalid time of day '" << text << "', expected HH:MM\n";
+        return false;
+    }
+    seconds = hours * 3600 + minutes * 60;
+    return true;
+}
+
+// Sets every lane's spawn settings from its profile at the given slot.
+// A multiplier of 0 stops that kind of spawn entirely.
+void applyDemandProfiles(const ScenarioBlob &scenario, int slot, LaneConfig laneConfigs[])
+{
+    for (int i = 0; i < SCENARIO_LANES; i++)
+    {
+        const ScenarioLane &lane = scenario.lanes[i];
+        const ScenarioProfile &profile = scenario.profiles[i];
+
+        float demand = profile.series[PROFILE_DEMAND][slot];
+        float car5 = profile.series[PROFILE_CAR5][slot];
+        float car6 = profile.series[PROFILE_CAR6][slot];
+
+        laneConfigs[i].spawnInterval = demand > 0 ? lane.spawnInterval / demand : INFINITY;
+        laneConfigs[i].car5Probability = min(1.0f, lane.car5Probability * car5);
+        laneConfigs[i].car6Interval = car6 > 0 ? CAR6_SPAWN_INTERVAL / car6 : INFINITY;
+    }
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <cstdint>
+
+// Simulation time.
+// The simulation's tick counter (Simulation::tick) is the only time source of a run. Every tick
+// stands for SIM_TICK_SECONDS; timers only remember the tick they were last restarted at, so
+// reading one is a subtraction rather than a clock_gettime call, and a run behaves the same
+// whether its ticks are paced to the wall clock (window) or executed back to back (headless,
+// replicas, timing search).
+
+typedef uint32_t SimTick;
+
+const float SIM_TICK_SECONDS = 0.01f; // Simulated seconds per tick
+
+struct TickTimer
+{
+    SimTick start = 0;
+
+    float elapsedSeconds(SimTick now) const { return (now - start) * SIM_TICK_SECONDS; }
+    void restart(SimTick now) { start = now; }
+};
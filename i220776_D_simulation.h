@@ -0,0 +1,240 @@
+#pragma once
+#include <iostream>
+#include <random>
+#include <vector>
+#include "i220776_D_car.h"
+#include "i220776_D_SmartTraffix.h"
+#include "i220776_D_carBreakDown.h"
+#include "i220776_D_spawnCars.h"
+#include "i220776_D_scenario.h"
+#include "i220776_D_checkpoint.h"
+#include "i220776_D_emergency.h"
+#include "i220776_D_simClock.h"
+#include "i220776_D_routes.h"
+#include "i220776_D_simTick.h"
+#include "i220776_D_worldSnapshot.h"
+
+using namespace std;
+
+// One running intersection.
+// Owns everything a run mutates: vehicles, lights, the controller, the challan ledger, spawn
+// timers and its own random generator. Nothing is kept in globals, so replicas seeded
+// differently never see each other's state (see i220776_D_replicas.h). step() advances one
+// tick of SIM_TICK_SECONDS; every timer in the run counts those ticks, so how fast step() is
+// called only decides how fast the run goes. Drawing, recording and capture are left to the
+// caller. Other threads must not touch the members while it runs; they read world instead.
+// Allocations made by step() are charged to vehicles unless a subsystem charges its own
+// (i220776_D_memoryAccounting.h).
+
+class Simulation
+{
+public:
+    const ScenarioBlob &scenario;
+    mt19937 rng;
+    SimulationStats stats;
+    LaneConfig laneConfigs[SCENARIO_LANES];
+    SimClock clock; // Lane demand and CAR5/CAR6 rates follow the simulated time of day
+    RouteTable routes;
+    TrafficLight tlights[SCENARIO_MAX_LIGHTS]; // Placement only; states come from trafficController->signals()
+    SmartTraffix *trafficController;
+    ChallanGenerator challanGenerator;
+
+    vector<Car *> cars; // MAX_SIMULATION_CARS slots, the first carCount in use
+    vector<CarData *> carData;
+    int carCount;
+    int carsInLane[SCENARIO_LANES];
+    SimTick tick;
+    int speedStep; // Lane speed increment applied once a second
+    SpeedChangeList speedChanges; // Cars whose speed changed this tick, for checkSpeedViolations
+    int spawnCheckThreads;        // canSpawnCar threads per lane and tick; 1 keeps the check on the caller's thread
+
+    vector<Car *> spawnedCars; // Entered during the last step, rescue vehicles included
+    vector<Car *> removedCars; // Left the map during the last step; deleted when the next one starts
+    Seqlock<WorldSnapshot> world; // Counters as of the last step, for any thread
+
+private:
+    int profileSlot;
+    SpawnTimers spawnTimers;
+    TickTimer speedTimer;
+    BreakdownScheduler breakdownScheduler;
+    EmergencyIndex emergencyIndex;
+    PreemptionScheduler preemptionScheduler;
+
+public:
+    // controllerProcesses as for SmartTraffix; batch runs decide the lights in-process
+    Simulation(const ScenarioBlob &scenario, double startTime, float timeWarp, unsigned seed, bool controllerProcesses = true)
+        : scenario(scenario), rng(seed), clock(startTime, timeWarp), routes(scenario),
+          carCount(0),
+          carsInLane(), tick(0), speedStep(0), spawnCheckThreads(DEFAULT_SPAWN_CHECK_THREADS), profileSlot(-1), breakdownScheduler(rng), emergencyIndex(scenario)
+    {
+        stats.hasStarted = true;
+        {
+            MemoryScope scope(MEMORY_VEHICLES);
+            cars.assign(MAX_SIMULATION_CARS, nullptr);
+            carData.assign(MAX_SIMULATION_CARS, nullptr);
+        }
+
+        for (int i = 0; i < SCENARIO_LANES; i++)
+        {
+            laneConfigs[i].currentSpeed = scenario.lanes[i].speed;
+            laneConfigs[i].car5Interval = scenario.lanes[i].car5Interval;
+        }
+
+        for (int i = 0; i < scenario.lightCount; i++)
+        {
+            const ScenarioLight &light = scenario.lights[i];
+            tlights[i] = TrafficLight(light.x, light.y, light.rotation, static_cast<tLightState>(light.state));
+        }
+        MemoryScope scope(MEMORY_CONTROLLER);
+        trafficController = new SmartTraffix(scenario.lightCount, controllerProcesses);
+    }
+
+    Simulation(const Simulation &) = delete;
+    Simulation &operator=(const Simulation &) = delete;
+
+    ~Simulation()
+    {
+        for (int i = 0; i < carCount; i++)
+        {
+            delete cars[i];
+            delete carData[i];
+        }
+        deleteRemovedCars();
+        delete trafficController;
+    }
+
+    // Everything a checkpoint captures
+    SimulationState checkpointState()
+    {
+        return {cars.data(), carData.data(), &carCount, MAX_SIMULATION_CARS, carsInLane, trafficController,
+                &challanGenerator, &stats, &rng, &speedStep, &tick, &spawnTimers, &speedTimer, &clock, &routes};
+    }
+
+    // Schedules breakdowns and indexes ambulances for the cars a checkpoint restored
+    void adoptRestoredCars()
+    {
+        for (int i = 0; i < carCount; i++)
+        {
+            breakdownScheduler.schedule(cars[i], carData[i], tick);
+            emergencyIndex.add(cars[i]);
+        }
+    }
+
+    // Simulated time since the run started, in milliseconds
+    uint32_t elapsedMs() const { return tickMs(tick); }
+    // Simulated time at which tick at starts, in milliseconds
+    static uint32_t tickMs(SimTick at) { return at * (uint32_t)lround(SIM_TICK_SECONDS * 1000); }
+
+    // Advances one tick
+    void step()
+    {
+        MemoryScope scope(MEMORY_VEHICLES);
+        clock.advance(SIM_TICK_SECONDS);
+        if (clock.slot() != profileSlot)
+        {
+            profileSlot = clock.slot();
+            applyDemandProfiles(scenario, profileSlot, laneConfigs);
+            const ScenarioTiming &timing = scenario.timings[profileSlot];
+            MemoryScope controllerScope(MEMORY_CONTROLLER);
+            trafficController->setTiming(timing.cycle, timing.splits, timing.priority);
+        }
+
+        spawnedCars.clear();
+        int firstNewCar = carCount;
+        spawnCars(cars.data(), carData.data(), carCount, carsInLane, scenario, routes, laneConfigs, rng,
+                  spawnTimers, tick, MAX_SIMULATION_CARS, spawnCheckThreads);
+        for (int i = firstNewCar; i < carCount; i++)
+        {
+            breakdownScheduler.schedule(cars[i], carData[i], tick);
+            emergencyIndex.add(cars[i]);
+            spawnedCars.push_back(cars[i]);
+        }
+        {
+            MemoryScope controllerScope(MEMORY_CONTROLLER);
+            trafficController->update(tick);
+            preemptionScheduler.update(*trafficController, scenario.lightCount);
+        }
+
+        if (speedTimer.elapsedSeconds(tick) >= 1.0f)
+        {
+            speedStep++;
+            speedTimer.restart(tick);
+            for (int i = 0; i < carCount; i++)
+            {
+                if ((int)(rng() % 2) == i % 2)
+                {
+                    cars[i]->setSpeed((scenario.lanes[carData[i]->laneIndex].speed + speedStep) * KMH_TO_PIXELS, &speedChanges);
+                }
+            }
+        }
+
+        // Rescue vehicles are scheduled by processDue itself
+        int firstRescue = carCount;
+        breakdownScheduler.processDue(tick, cars.data(), carData.data(), carCount, MAX_SIMULATION_CARS, carsInLane, stats);
+        for (int i = firstRescue; i < carCount; i++)
+        {
+            spawnedCars.push_back(cars[i]);
+            speedChanges.add(cars[i]); // Took the broken car's speed as it spawned
+        }
+
+        // Challans for this tick's speed changes, before exiting cars are removed
+        checkSpeedViolations(speedChanges, challanGenerator, *trafficController);
+
+        deleteRemovedCars();
+        DetectorCounts detectors;
+        updateCars(nullptr, cars.data(), carData.data(), trafficController->signals(), carCount, carsInLane, scenario, &removedCars, &detectors);
+        for (Car *car : removedCars)
+        {
+            breakdownScheduler.cancel(car);
+            emergencyIndex.remove(car);
+        }
+
+        // The light controllers decide on this tick's counts while the caller captures the
+        // frame and the next tick spawns
+        float emergencyEtas[SCENARIO_MAX_LIGHTS];
+        emergencyIndex.refreshAll();
+        emergencyIndex.arrivalEtas(emergencyEtas, scenario.lightCount);
+        {
+            MemoryScope controllerScope(MEMORY_CONTROLLER);
+            trafficController->postDetectors(detectors, emergencyEtas);
+        }
+        tick++;
+        publishWorld(detectors);
+    }
+
+private:
+    // The cars that left during the previous step, kept until now for the caller to inspect
+    void deleteRemovedCars()
+    {
+        for (Car *car : removedCars)
+        {
+            delete car->getData();
+            delete car;
+        }
+        removedCars.clear();
+    }
+
+    void publishWorld(const DetectorCounts &detectors)
+    {
+        WorldSnapshot snapshot = {};
+        snapshot.tick = tick - 1;
+        snapshot.timeMs = tickMs(snapshot.tick);
+        snapshot.signals = trafficController->signals();
+        snapshot.vehicles = carCount;
+        for (int i = 0; i < carCount; i++)
+            snapshot.vehiclesByType[cars[i]->getType()]++;
+        for (int lane = 0; lane < SCENARIO_LANES; lane++)
+            snapshot.carsInLane[lane] = carsInLane[lane];
+        for (int light = 0; light < scenario.lightCount; light++)
+        {
+            snapshot.approaching[light] = detectors.approaching[light];
+            snapshot.waiting[light] = detectors.waiting[light];
+        }
+        snapshot.breakdowns = stats.totalBreakdowns;
+        snapshot.challansIssued = challanGenerator.getTotalChallanCount();
+        snapshot.challansUnpaid = challanGenerator.getUnpaidCount();
+        snapshot.activeChallans = trafficController->getActiveChallanCount();
+        snapshot.finesOutstanding = challanGenerator.getOutstandingAmount();
+        world.publish(snapshot);
+    }
+};
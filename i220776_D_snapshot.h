@@ -0,0 +1,56 @@
+#pragma once
+#include <atomic>
+#include "i220776_D_trajectory.h"
+
+using namespace std;
+
+// Simulation to renderer hand-off.
+// The simulation thread fills the back buffer and publishes it; the render thread picks up
+// the newest published buffer whenever it is ready to draw. The three buffers rotate through
+// a single atomic index exchange, so neither side ever waits for the other: the writer always
+// has a free buffer and the reader always has a complete one. Snapshots the reader never got
+// to are simply overwritten.
+
+template <typename T>
+class TripleBuffer
+{
+    static const unsigned FRESH = 4; // Set on middle while it holds a snapshot not yet read
+
+    T buffers[3];
+    atomic<unsigned> middle; // Buffer index shared by both sides, plus FRESH
+    unsigned back;           // Writer only
+    unsigned front;          // Reader only
+
+public:
+    TripleBuffer() : middle(1), back(0), front(2) {}
+    TripleBuffer(const TripleBuffer &) = delete;
+    TripleBuffer &operator=(const TripleBuffer &) = delete;
+
+    // Buffer the writer fills next
+    T &writeBuffer() { return buffers[back]; }
+
+    // Hands the filled write buffer to the reader and takes back a free one
+    void publish()
+    {
+        back = middle.exchange(back | FRESH, memory_order_acq_rel) & 3;
+    }
+
+    // Switches readBuffer() to the newest published snapshot; false when nothing new was published
+    bool update()
+    {
+        if (!(middle.load(memory_order_relaxed) & FRESH))
+            return false;
+        front = middle.exchange(front, memory_order_acq_rel) & 3;
+        return true;
+    }
+
+    const T &readBuffer() const { return buffers[front]; }
+};
+
+// What the renderer needs from one simulation tick
+struct SimulationSnapshot
+{
+    TrajectoryFrame frame; // Vehicle positions and light states
+    char timeOfDay[8];     // Simulated clock, "HH:MM"
+    vector<float> heatmap; // Running-average occupancy per cell, empty unless the overlay is shown
+};
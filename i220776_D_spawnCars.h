@@ -1,3 +1,4 @@
+#pragma once
 #include <SFML/Window.hpp>
 #include <SFML/Graphics.hpp>
 #include <iostream>
@@ -10,15 +11,12 @@
 #include "i220776_D_trafficlightgroup.h"
 #include "i220776_D_car.h"
 #include "i220776_D_SmartTraffix.h"
+#include "i220776_D_scenario.h"
+#include "i220776_D_routes.h"
 #include <sstream>
 #include <sys/wait.h>
 #include <sys/time.h>
 
-// Random number generator setup
-random_device rd;
-mt19937 gen(rd());
-uniform_real_distribution<> dis(0, 1);
-
 // Mutex for thread-safe result sharing
 pthread_mutex_t spawnCheckMutex = PTHREAD_MUTEX_INITIALIZER;
 
@@ -69,21 +67,30 @@ void *checkSpawnConditionsThread(void *args)
     return nullptr;
 }
 
-// Threaded version of canSpawnCar
-bool canSpawnCarMultiThreaded(int carCount, Car *cars[], const float spawnPositions[][3], int spawnIndex, float minDistance)
+// Threads canSpawnCar splits the cars between unless told otherwise
+const int DEFAULT_SPAWN_CHECK_THREADS = 10;
+
+// Threaded version of canSpawnCar; one thread means the caller's, without creating any
+bool canSpawnCarMultiThreaded(int carCount, Car *cars[], const float spawnPositions[][3], int spawnIndex, float minDistance, int numThreads = DEFAULT_SPAWN_CHECK_THREADS)
 {
-    const int NUM_THREADS = 10; // Adjustable number of threads
-    pthread_t threads[NUM_THREADS];
-    SpawnCheckArgs threadArgs[NUM_THREADS];
+    if (numThreads <= 1)
+    {
+        bool canSpawn = true;
+        SpawnCheckArgs args = {carCount, cars, spawnPositions, spawnIndex, minDistance, &canSpawn, 0, carCount};
+        checkSpawnConditionsThread(&args);
+        return canSpawn;
+    }
+
+    vector<pthread_t> threads(numThreads);
+    vector<SpawnCheckArgs> threadArgs(numThreads);
 
     // Flag to track spawn condition
     bool canSpawn = true;
 
     // Calculate cars per thread
-    int carsPerThread = carCount / NUM_THREADS;
-    int remainingCars = carCount % NUM_THREADS;
+    int carsPerThread = carCount / numThreads;
 
-    for (int i = 0; i < NUM_THREADS; i++)
+    for (int i = 0; i < numThreads; i++)
     {
         threadArgs[i].carCount = carCount;
         threadArgs[i].cars = cars;
@@ -92,16 +99,16 @@ bool canSpawnCarMultiThreaded(int carCount, Car *cars[], const float spawnPositi
         threadArgs[i].minDistance = minDistance;
         threadArgs[i].canSpawn = &canSpawn;
 
-        // Distribute cars evenly among threads
+        // Distribute cars evenly among threads, the last one takes the remainder
         threadArgs[i].startIndex = i * carsPerThread;
-        threadArgs[i].endIndex = (i == NUM_THREADS - 1) ? carCount : (i + 1) * carsPerThread + (i == NUM_THREADS - 2 ? remainingCars : 0);
+        threadArgs[i].endIndex = (i == numThreads - 1) ? carCount : (i + 1) * carsPerThread;
 
         // Create thread
         pthread_create(&threads[i], nullptr, checkSpawnConditionsThread, &threadArgs[i]);
     }
 
     // Wait for all threads to complete
-    for (int i = 0; i < NUM_THREADS; i++)
+    for (int i = 0; i < numThreads; i++)
     {
         pthread_join(threads[i], nullptr);
     }
@@ -110,37 +117,53 @@ bool canSpawnCarMultiThreaded(int carCount, Car *cars[], const float spawnPositi
     return canSpawn;
 }
 
-bool canSpawnCar(int carCount, Car *cars[], const float spawnPositions[][3], int spawnIndex, float minDistance)
+bool canSpawnCar(int carCount, Car *cars[], const float spawnPositions[][3], int spawnIndex, float minDistance, int numThreads = DEFAULT_SPAWN_CHECK_THREADS)
 {
-    return canSpawnCarMultiThreaded(carCount, cars, spawnPositions, spawnIndex, minDistance);
+    return canSpawnCarMultiThreaded(carCount, cars, spawnPositions, spawnIndex, minDistance, numThreads);
 }
 
+// Nothing spawns during the first seconds of a run
+const float SPAWN_START_SECONDS = 1.5f;
+
+// Tick each kind of spawn last happened, per lane where it applies
+struct SpawnTimers
+{
+    TickTimer lanes[SCENARIO_LANES];
+    TickTimer car5[SCENARIO_LANES];
+    TickTimer car6;
+};
+
 void spawnCars(
     Car *cars[],
     CarData *carData[],
     int &carCount,
     int carsInLane[],
-    const float spawnPositions[][3],
+    const ScenarioBlob &scenario,
+    const RouteTable &routes,
     LaneConfig laneConfigs[],
-    Clock globalSpawnClock,
-    Clock spawnClocks[],
-    Clock car5SpawnClocks[],
-    int maxCars)
+    mt19937 &rng,
+    SpawnTimers &timers,
+    SimTick now,
+    int maxCars,
+    int spawnCheckThreads = DEFAULT_SPAWN_CHECK_THREADS)
 {
-    if (globalSpawnClock.getElapsedTime().asSeconds() >= 1.5f)
+    const float(*spawnPositions)[3] = scenario.spawnPositions;
+    // All spawn-time randomness draws from the simulation's rng so a checkpoint can capture it
+    uniform_real_distribution<> dis(0, 1);
+
+    if (now * SIM_TICK_SECONDS >= SPAWN_START_SECONDS)
     {
-        for (int i = 0; i < 8; i++)
+        for (int i = 0; i < SCENARIO_LANES; i++)
         {
             int laneIndex = i / 2;
 
             // Check minimum distance from other cars
-            bool canSpawn = canSpawnCar(carCount, cars, spawnPositions, i, 50);
+            bool canSpawn = canSpawnCar(carCount, cars, spawnPositions, i, 50, spawnCheckThreads);
 
             // Special handling for CAR6
-            static Clock car6SpawnClock;
             bool shouldSpawnCar6 =
-                cars[i]->isValidCar6Lane(i) &&
-                car6SpawnClock.getElapsedTime().asSeconds() >= 15.0f;
+                allowedInLane<CAR6>(i) &&
+                timers.car6.elapsedSeconds(now) >= laneConfigs[i].car6Interval;
 
             if (shouldSpawnCar6)
             {
@@ -161,9 +184,9 @@ void spawnCars(
                     }
 
                     // Spawn multiple CAR6 vehicles
-                    int car6SpawnPositions[] = {7, 1, 5, 2};
-                    for (int pos : car6SpawnPositions)
+                    for (int k = 0; k < scenario.car6SpawnCount; k++)
                     {
+                        int pos = scenario.car6Spawns[k];
                         cars[carCount] = new Car(CAR6,
                                                  spawnPositions[pos][0],
                                                  spawnPositions[pos][1],
@@ -171,35 +194,36 @@ void spawnCars(
 
                         // Initialize car data
                         carData[carCount] = new CarData();
-                        carData[carCount]->numberPlate = cars[carCount]->generateNumberPlate();
+                        cars[carCount]->setData(carData[carCount]);
+                        cars[carCount]->setRoute(&routes.pick(pos, dis(rng)));
+                        carData[carCount]->plate = cars[carCount]->generateNumberPlate();
                         carData[carCount]->laneIndex = laneIndex;
                         carData[carCount]->challanStatus = false;
                         carData[carCount]->isBroken = false;
-                        carData[carCount]->speedUpdateClock.restart();
 
                         carCount++;
                         carsInLane[laneIndex]++;
                     }
 
-                    car6SpawnClock.restart();
+                    timers.car6.restart(now);
                 }
             }
-            else if (spawnClocks[i].getElapsedTime().asSeconds() >= laneConfigs[laneIndex].spawnInterval &&
+            else if (timers.lanes[i].elapsedSeconds(now) >= laneConfigs[laneIndex].spawnInterval &&
                      carsInLane[laneIndex] < 6 && carCount < maxCars)
             {
                 if (canSpawn)
                 {
                     // Determine car type (excluding CAR6)
-                    int carType = rand() % 5; // Only choose from CAR1 to CAR5
+                    int carType = rng() % 5; // Only choose from CAR1 to CAR5
                     bool spawnCAR5 = false;
 
                     // Check if we should spawn CAR5 based on lane-specific probabilities
-                    if (car5SpawnClocks[i].getElapsedTime().asSeconds() >= laneConfigs[i].car5Interval)
+                    if (timers.car5[i].elapsedSeconds(now) >= laneConfigs[i].car5Interval)
                     {
-                        if (dis(gen) < laneConfigs[i].car5Probability)
+                        if (dis(rng) < laneConfigs[i].car5Probability)
                         {
                             spawnCAR5 = true;
-                            car5SpawnClocks[i].restart();
+                            timers.car5[i].restart(now);
                         }
                     }
 
@@ -209,7 +233,7 @@ void spawnCars(
                     }
                     else
                     {
-                        carType = rand() % 4; // CAR1-4
+                        carType = rng() % 4; // CAR1-4
                     }
 
                     // Create new car
@@ -221,141 +245,110 @@ void spawnCars(
 
                     // Initialize car data
                     carData[carCount] = new CarData();
-                    carData[carCount]->numberPlate = cars[carCount]->generateNumberPlate();
+                    cars[carCount]->setData(carData[carCount]);
+                    cars[carCount]->setRoute(&routes.pick(i, dis(rng)));
+                    carData[carCount]->plate = cars[carCount]->generateNumberPlate();
                     carData[carCount]->laneIndex = laneIndex;
                     carData[carCount]->challanStatus = false;
                     carData[carCount]->isBroken = false;
-                    carData[carCount]->speedUpdateClock.restart();
 
                     carCount++;
                     carsInLane[laneIndex]++;
-                    spawnClocks[i].restart();
+                    timers.lanes[i].restart(now);
                 }
             }
         }
-        globalSpawnClock.restart();
     }
 }
 
-void updateCars(RenderWindow *window, Car *cars[], TrafficLight tlights[], int carCount, int *carsInLane, SmartTraffix trafficController)
+// window may be nullptr for headless runs, in which case nothing is drawn
+// Removed cars are dropped from cars/carData and carCount is updated to the survivors.
+// When removedCars is given, the cars that left the map are appended to it.
+// signals is the controller's word for this tick (SmartTraffix::signals()).
+// When detectors is given, it receives the per-light vehicle counts the light controllers use.
+void updateCars(RenderWindow *window, Car *cars[], CarData *carData[], SignalWord signals, int &carCount, int *carsInLane, const ScenarioBlob &scenario, vector<Car *> *removedCars = nullptr, DetectorCounts *detectors = nullptr)
 {
-    // First, check if there's a CAR5 in any lane
-    bool car5Present = false;
-    int car5LightIndex = -1;
-
-    for (int i = 0; i < carCount; i++)
-    {
-        if (cars[i]->getType() == CAR5)
-        {
-            // Determine which traffic light corresponds to the CAR5's direction
-            float carDir = cars[i]->getDir();
-
-            if (carDir == 270)      // East-moving lane
-                car5LightIndex = 0; // North-South horizontal light
-            else if (carDir == 180) // West-moving lane
-                car5LightIndex = 1; // North-South horizontal light
-            else if (carDir == 90)  // North-moving lane
-                car5LightIndex = 2; // East-West vertical light
-            else if (carDir == 0)   // South-moving lane
-                car5LightIndex = 3; // East-West vertical light
-
-            car5Present = true;
-            break;
-        }
-    }
+    if (detectors != nullptr)
+        *detectors = DetectorCounts();
 
-    // // If CAR5 is present, trigger priority handling
-    // if (car5Present && car5LightIndex != -1)
-    // {
-    //     trafficController.handleCar5Priority(car5LightIndex);
-    // }
+    // CAR5 priority is handled by PreemptionScheduler from the light controllers' requests
     int newCarCount = 0;
     for (int i = 0; i < carCount; i++)
     {
         // Draw the car
-        cars[i]->draw(window);
-
-        // Determine which traffic light corresponds to the car's direction
-        int correspondingLightIndex = -1;
-        float carDir = cars[i]->getDir();
-
-        // Map car's position and direction to the correct traffic light
-        if (carDir == 270)               // East-moving lane
-            correspondingLightIndex = 0; // North-South horizontal light
-        else if (carDir == 180)          // West-moving lane
-            correspondingLightIndex = 1; // North-South horizontal light
-        else if (carDir == 90)           // North-moving lane
-            correspondingLightIndex = 2; // East-West vertical light
-        else if (carDir == 0)            // South-moving lane
-            correspondingLightIndex = 3; // East-West vertical light
-
-        // Move car based on traffic light and specific position conditions
-        bool canMove = false;
-
-        if (tlights[correspondingLightIndex].getState() == GREEN)
-            canMove = true;
-
-        if (
-            (cars[i]->getX() < 600 && cars[i]->getY() == 500) ||
-            (cars[i]->getX() < 600 && cars[i]->getY() == 545) ||
-            (cars[i]->getX() > 370 && cars[i]->getY() == 445) ||
-            (cars[i]->getX() > 370 && cars[i]->getY() == 407) ||
-            (cars[i]->getX() == 510 && cars[i]->getY() > 400) ||
-            (cars[i]->getX() == 545 && cars[i]->getY() > 400) ||
-            (cars[i]->getX() == 405 && cars[i]->getY() < 600) ||
-            (cars[i]->getX() == 445 && cars[i]->getY() < 600))
-            canMove = true;
-
-        if (canMove)
-            cars[i]->move2();
+        if (window != nullptr)
+            cars[i]->draw(window);
 
         bool shouldRemoveCar = false;
-
-        if (cars[i]->getX() > 1000 && cars[i]->getDir() == 90)
+        const Route *route = cars[i]->getRoute();
+        if (route != nullptr)
         {
-            if (cars[i]->getY() == 445)
+            // Routed cars obey the light of their approach until they pass its stop line,
+            // and leave once they reach the end of the route
+            int lightIndex = scenario.lightForDirection(route->entryDir);
+            bool beforeStopLine = cars[i]->getRouteProgress() < route->stopProgress;
+            bool green = lightIndex != -1 && signalLight(signals, lightIndex) == GREEN;
+            if (green || !beforeStopLine)
+                cars[i]->followRoute();
+            else
+                cars[i]->holdOnRoute();
+
+            if (detectors != nullptr && lightIndex != -1 && beforeStopLine)
             {
-                carsInLane[0]--;
-                carsInLane[1]--;
-                shouldRemoveCar = true;
+                detectors->approaching[lightIndex]++;
+                detectors->waiting[lightIndex] += !green;
             }
-        }
-        else if (cars[i]->getX() < 0 && cars[i]->getDir() == 270)
-        {
-            if (cars[i]->getY() == 500)
+
+            if (cars[i]->hasFinishedRoute())
             {
-                carsInLane[2]--;
-                carsInLane[3]--;
+                if (carData[i] != nullptr)
+                    carsInLane[carData[i]->laneIndex]--;
                 shouldRemoveCar = true;
             }
         }
-        else if (cars[i]->getY() > 1000 && cars[i]->getDir() == 0)
+        else
         {
-            if (cars[i]->getX() == 505)
+            // Determine which traffic light corresponds to the car's direction
+            int correspondingLightIndex = scenario.lightForDirection(cars[i]->getDir());
+
+            // Move car based on traffic light and specific position conditions
+            bool canMove = false;
+
+            if (correspondingLightIndex != -1 && signalLight(signals, correspondingLightIndex) == GREEN)
+                canMove = true;
+
+            // Cars already past their stop line clear the junction regardless of the light
+            if (scenario.isPastStopLine(cars[i]->getX(), cars[i]->getY()))
+                canMove = true;
+            else if (detectors != nullptr && correspondingLightIndex != -1)
             {
-                carsInLane[4]--;
-                carsInLane[5]--;
-                shouldRemoveCar = true;
+                detectors->approaching[correspondingLightIndex]++;
+                detectors->waiting[correspondingLightIndex] += !canMove;
             }
-        }
-        else if (cars[i]->getY() < 0 && cars[i]->getDir() == 180)
-        {
-            if (cars[i]->getX() == 445)
+
+            if (canMove)
+                cars[i]->move2();
+
+            const ScenarioExitRule *exitRule = scenario.exitRuleFor(cars[i]->getX(), cars[i]->getY(), cars[i]->getDir());
+            if (exitRule != nullptr)
             {
-                carsInLane[6]--;
-                carsInLane[7]--;
+                carsInLane[exitRule->lanes[0]]--;
+                carsInLane[exitRule->lanes[1]]--;
                 shouldRemoveCar = true;
             }
         }
 
         if (!shouldRemoveCar)
         {
-            // Keep the car in the array
+            // Keep the car and its data in the arrays
             cars[newCarCount] = cars[i];
+            carData[newCarCount] = carData[i];
             newCarCount++;
         }
         else
         {
+            if (removedCars != nullptr)
+                removedCars->push_back(cars[i]);
             // Delete the car and its associated data
             // delete cars[i];
         }
@@ -0,0 +1,387 @@
+#pragma once
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <cmath>
+#include <random>
+#include <algorithm>
+#include "i220776_D_scenario.h"
+#include "i220776_D_replicas.h"
+
+using namespace std;
+
+// Signal-timing optimizer.
+// The scenario's demand profiles split the day into regimes: slots whose multipliers are all the
+// same (e.g. both peaks, the night, the rest of the day). For each regime a separable CMA-ES
+// searches cycle length, per-light splits and CAR5 priority duration. Every candidate is scored
+// by short headless replicas frozen at the regime's time of day (warp 0), all seeds of all
+// candidates of a generation running as one replica batch. The cost is the mean time a vehicle
+// spends waiting at red, counting vehicles still queued at the end so starving an approach
+// does not pay off. Scores are cached per quantised parameter vector, and the cache can be kept
+// in a file so an interrupted overnight run resumes where it stopped. The best plan of each
+// regime is written as scenario "timing" lines.
+
+const unsigned DEFAULT_OPTIMIZER_TICKS = 12000; // Two minutes, several cycles even when they are long
+const int DEFAULT_OPTIMIZER_GENERATIONS = 12;
+const int DEFAULT_OPTIMIZER_POPULATION = 8;
+const int DEFAULT_OPTIMIZER_SEEDS = 4; // Replicas per candidate, the same seeds for every candidate
+
+// Search bounds
+const float OPTIMIZER_MIN_CYCLE = 10.0f;
+const float OPTIMIZER_MAX_CYCLE = 120.0f;
+const float OPTIMIZER_MIN_PRIORITY = 1.0f;
+const float OPTIMIZER_MAX_PRIORITY = 15.0f;
+const float OPTIMIZER_MIN_WEIGHT = 0.1f; // Relative to the largest split, keeps every light served
+
+struct TimingOptimizerOptions
+{
+    string outputPath;
+    string cachePath; // Empty keeps the cache in memory only
+    int generations;
+    int population;
+    int seeds;
+    ReplicaOptions replica; // jobs, baseSeed, ticks and tickSeconds are used
+};
+
+// Separable CMA-ES over [0, 1]^dims: a Gaussian with a diagonal covariance, adapted from the
+// ranked candidates of each generation (rank-mu update, cumulative step-size control)
+class TimingSearch
+{
+    int dims, lambda, mu;
+    vector<double> weights;
+    double muEff;
+    vector<double> mean, variances, path;
+    double sigma, cSigma, dSigma, cMu, chiN;
+    mt19937 rng;
+
+public:
+    TimingSearch(const vector<double> &start, int lambda, unsigned seed, double initialSigma = 0.3)
+        : dims(start.size()), lambda(max(4, lambda)), mu(this->lambda / 2), mean(start),
+          variances(start.size(), 1.0), path(start.size(), 0.0), sigma(initialSigma), rng(seed)
+    {
+        double sum = 0, squares = 0;
+        for (int i = 0; i < mu; i++)
+        {
+            weights.push_back(log(mu + 0.5) - log(i + 1.0));
+            sum += weights.back();
+        }
+        for (double &weight : weights)
+        {
+            weight /= sum;
+            squares += weight * weight;
+        }
+        muEff = 1.0 / squares;
+
+        cSigma = (muEff + 2) / (dims + muEff + 5);
+        dSigma = 1 + cSigma + 2 * max(0.0, sqrt((muEff - 1) / (dims + 1)) - 1);
+        cMu = min(1.0, (dims + 2) / 3.0 * 2 * (muEff - 2 + 1 / muEff) / ((dims + 2) * (dims + 2) + muEff));
+        chiN = sqrt((double)dims) * (1 - 1.0 / (4 * dims) + 1.0 / (21.0 * dims * dims));
+    }
+
+    int populationSize() const { return lambda; }
+    double stepSize() const { return sigma; }
+
+    // Draws the next generation, clamped to the unit box
+    vector<vector<double>> ask()
+    {
+        normal_distribution<double> normal(0.0, 1.0);
+        vector<vector<double>> candidates(lambda, vector<double>(dims));
+        for (vector<double> &candidate : candidates)
+        {
+            for (int d = 0; d < dims; d++)
+                candidate[d] = min(1.0, max(0.0, mean[d] + sigma * sqrt(variances[d]) * normal(rng)));
+        }
+        return candidates;
+    }
+
+    // Moves the distribution towards the cheapest candidates; lower cost is better
+    void tell(const vector<vector<double>> &candidates, const vector<double> &costs)
+    {
+        vector<int> order(candidates.size());
+        for (size_t i = 0; i < order.size(); i++)
+            order[i] = i;
+        sort(order.begin(), order.end(), [&](int a, int b)
+             { return costs[a] < costs[b]; });
+
+        // Steps of the selected candidates in units of sigma, as actually taken after clamping
+        vector<double> meanStep(dims, 0.0);
+        vector<double> varianceUpdate(dims, 0.0);
+        for (int i = 0; i < mu; i++)
+        {
+            const vector<double> &x = candidates[order[i]];
+            for (int d = 0; d < dims; d++)
+            {
+                double y = (x[d] - mean[d]) / sigma;
+                meanStep[d] += weights[i] * y;
+                varianceUpdate[d] += weights[i] * y * y;
+            }
+        }
+
+        double pathLength = 0;
+        for (int d = 0; d < dims; d++)
+        {
+            mean[d] = min(1.0, max(0.0, mean[d] + sigma * meanStep[d]));
+            path[d] = (1 - cSigma) * path[d] + sqrt(cSigma * (2 - cSigma) * muEff) * meanStep[d] / sqrt(variances[d]);
+            pathLength += path[d] * path[d];
+            variances[d] = (1 - cMu) * variances[d] + cMu * varianceUpdate[d];
+        }
+        sigma *= exp(cSigma / dSigma * (sqrt(pathLength) / chiN - 1));
+        sigma = min(1.0, max(1e-3, sigma));
+    }
+};
+
+// Slots sharing the same multipliers on every lane
+struct DemandRegime
+{
+    vector<int> slots;
+};
+
+inline vector<DemandRegime> findDemandRegimes(const ScenarioBlob &scenario)
+{
+    vector<DemandRegime> regimes;
+    vector<vector<float>> signatures;
+    for (int slot = 0; slot < SCENARIO_PROFILE_SLOTS; slot++)
+    {
+        vector<float> signature;
+        for (const ScenarioProfile &profile : scenario.profiles)
+        {
+            for (const auto &series : profile.series)
+                signature.push_back(series[slot]);
+        }
+
+        size_t regime = find(signatures.begin(), signatures.end(), signature) - signatures.begin();
+        if (regime == signatures.size())
+        {
+            signatures.push_back(signature);
+            regimes.push_back(DemandRegime());
+        }
+        regimes[regime].slots.push_back(slot);
+    }
+    return regimes;
+}
+
+inline string slotLabel(int slot)
+{
+    char text[16];
+    snprintf(text, sizeof(text), "%02d:%02d", (slot % SCENARIO_PROFILE_SLOTS) / 2, slot % 2 * 30);
+    return text;
+}
+
+// Candidate in the unit box to a timing, rounded so nearby candidates share cache entries
+inline ScenarioTiming decodeTiming(const vector<double> &x, int lightCount)
+{
+    ScenarioTiming timing = {};
+    timing.cycle = round((OPTIMIZER_MIN_CYCLE + x[0] * (OPTIMIZER_MAX_CYCLE - OPTIMIZER_MIN_CYCLE)) * 2) / 2;
+    timing.priority = round((OPTIMIZER_MIN_PRIORITY + x[1] * (OPTIMIZER_MAX_PRIORITY - OPTIMIZER_MIN_PRIORITY)) * 4) / 4;
+
+    float weightSum = 0;
+    for (int i = 0; i < lightCount; i++)
+    {
+        timing.splits[i] = OPTIMIZER_MIN_WEIGHT + x[2 + i] * (1 - OPTIMIZER_MIN_WEIGHT);
+        weightSum += timing.splits[i];
+    }
+    for (int i = 0; i < lightCount; i++)
+        timing.splits[i] = round(timing.splits[i] / weightSum * 100) / 100;
+    return timing;
+}
+
+inline vector<double> encodeTiming(const ScenarioTiming &timing, int lightCount)
+{
+    vector<double> x(2 + lightCount);
+    x[0] = (timing.cycle - OPTIMIZER_MIN_CYCLE) / (OPTIMIZER_MAX_CYCLE - OPTIMIZER_MIN_CYCLE);
+    x[1] = (timing.priority - OPTIMIZER_MIN_PRIORITY) / (OPTIMIZER_MAX_PRIORITY - OPTIMIZER_MIN_PRIORITY);
+    float largest = *max_element(timing.splits, timing.splits + lightCount);
+    for (int i = 0; i < lightCount; i++)
+        x[2 + i] = (timing.splits[i] / largest - OPTIMIZER_MIN_WEIGHT) / (1 - OPTIMIZER_MIN_WEIGHT);
+    for (double &value : x)
+        value = min(1.0, max(0.0, value));
+    return x;
+}
+
+inline string formatTiming(const ScenarioTiming &timing, int lightCount)
+{
+    ostringstream text;
+    text << timing.cycle << " " << timing.priority;
+    for (int i = 0; i < lightCount; i++)
+        text << " " << timing.splits[i];
+    return text.str();
+}
+
+class TimingOptimizer
+{
+    const ScenarioBlob &scenario;
+    TimingOptimizerOptions options;
+    map<string, double> cache; // Cache key -> mean seconds waiting at red per vehicle
+    int evaluations, cacheHits;
+
+public:
+    TimingOptimizer(const ScenarioBlob &scenario, const TimingOptimizerOptions &options)
+        : scenario(scenario), options(options), evaluations(0), cacheHits(0)
+    {
+        loadCache();
+    }
+
+    bool run()
+    {
+        ofstream output(options.outputPath);
+        if (!output)
+        {
+            cerr << "Optimizer: cannot write " << options.outputPath << "\n";
+            return false;
+        }
+        output << "# Signal timing for scenario '" << scenario.name << "' from smarttraffix --optimize-timing\n"
+               << "# " << options.replica.ticks << " ticks x " << options.seeds << " seeds per candidate, "
+               << options.generations << " generations of " << options.population << "\n";
+
+        vector<DemandRegime> regimes = findDemandRegimes(scenario);
+        cout << "Optimizer: " << regimes.size() << " demand regimes\n";
+        for (const DemandRegime &regime : regimes)
+        {
+            int slot = regime.slots[0];
+            ScenarioTiming baseline = scenario.timings[slot];
+            double baselineCost = evaluate(slot, vector<ScenarioTiming>(1, baseline))[0];
+            ScenarioTiming best = baseline;
+            double bestCost = baselineCost;
+
+            TimingSearch search(encodeTiming(baseline, scenario.lightCount), options.population, options.replica.baseSeed + slot);
+            for (int generation = 0; generation < options.generations; generation++)
+            {
+                vector<vector<double>> candidates = search.ask();
+                vector<ScenarioTiming> timings;
+                for (const vector<double> &candidate : candidates)
+                    timings.push_back(decodeTiming(candidate, scenario.lightCount));
+
+                vector<double> costs = evaluate(slot, timings);
+                for (size_t i = 0; i < costs.size(); i++)
+                {
+                    if (costs[i] < bestCost)
+                    {
+                        bestCost = costs[i];
+                        best = timings[i];
+                    }
+                }
+                search.tell(candidates, costs);
+                cout << "Optimizer: regime " << slotLabel(slot) << " generation " << generation + 1
+                     << ": best " << bestCost << " s waiting (baseline " << baselineCost << " s), step "
+                     << search.stepSize() << "\n";
+            }
+
+            output << "# regime starting " << slotLabel(slot) << ": " << bestCost << " s waiting at red per vehicle, baseline "
+                   << baselineCost << " s\n";
+            for (size_t i = 0; i < regime.slots.size();)
+            {
+                // One line per run of consecutive slots
+                size_t end = i + 1;
+                while (end < regime.slots.size() && regime.slots[end] == regime.slots[end - 1] + 1)
+                    end++;
+                output << "timing " << slotLabel(regime.slots[i]) << " " << (regime.slots[end - 1] + 1 == SCENARIO_PROFILE_SLOTS ? "24:00" : slotLabel(regime.slots[end - 1] + 1))
+                       << " " << formatTiming(best, scenario.lightCount) << "\n";
+                i = end;
+            }
+        }
+
+        cout << "Optimizer: " << evaluations << " candidates simulated, " << cacheHits << " taken from the cache; wrote "
+             << options.outputPath << "\n";
+        return static_cast<bool>(output);
+    }
+
+private:
+    string cacheKey(int slot, const ScenarioTiming &timing) const
+    {
+        ostringstream key;
+        key << scenario.name << " " << slotLabel(slot) << " " << options.replica.ticks << "x" << options.seeds << "@"
+            << options.replica.baseSeed << " " << formatTiming(timing, scenario.lightCount);
+        return key.str();
+    }
+
+    // Mean seconds waiting at red per vehicle for each timing, simulated at the given slot
+    vector<double> evaluate(int slot, const vector<ScenarioTiming> &timings)
+    {
+        vector<double> costs(timings.size(), INFINITY);
+        vector<int> pending; // Indices into timings that are not cached yet
+        map<string, int> firstOfKey;
+        for (size_t i = 0; i < timings.size(); i++)
+        {
+            string key = cacheKey(slot, timings[i]);
+            auto cached = cache.find(key);
+            if (cached != cache.end())
+            {
+                costs[i] = cached->second;
+                cacheHits++;
+            }
+            else if (firstOfKey.insert({key, (int)i}).second)
+                pending.push_back(i);
+        }
+
+        if (!pending.empty())
+        {
+            // One scenario copy per candidate, frozen at the regime's time of day
+            vector<ScenarioBlob> variants(pending.size(), scenario);
+            vector<ReplicaTask> tasks;
+            for (size_t p = 0; p < pending.size(); p++)
+            {
+                setTimingRange(variants[p], 0, 0, timings[pending[p]]);
+                for (int seed = 0; seed < options.seeds; seed++)
+                    tasks.push_back({&variants[p], options.replica.baseSeed + (uint32_t)seed, slot * SECONDS_PER_PROFILE_SLOT});
+            }
+
+            ReplicaOptions replica = options.replica;
+            replica.timeWarp = 0.0f;
+            vector<ReplicaResult> results;
+            runReplicaBatch(tasks, replica, results, true);
+
+            ofstream cacheFile;
+            if (!options.cachePath.empty())
+                cacheFile.open(options.cachePath, ios::app);
+            for (size_t p = 0; p < pending.size(); p++)
+            {
+                double held = 0, vehicles = 0;
+                bool complete = true;
+                for (int seed = 0; seed < options.seeds; seed++)
+                {
+                    const ReplicaResult &result = results[p * options.seeds + seed];
+                    complete = complete && result.completed;
+                    held += result.heldTicks + result.heldTicksRemaining;
+                    vehicles += result.routedExited + result.routedRemaining;
+                }
+                if (!complete || vehicles == 0)
+                    continue; // Left at INFINITY and not cached
+                double cost = held / vehicles * options.replica.tickSeconds;
+
+                string key = cacheKey(slot, timings[pending[p]]);
+                cache[key] = cost;
+                if (cacheFile.is_open())
+                    cacheFile << key << " = " << cost << "\n";
+                evaluations++;
+            }
+        }
+
+        // Duplicates within the generation share the first one's score
+        for (size_t i = 0; i < timings.size(); i++)
+        {
+            auto cached = cache.find(cacheKey(slot, timings[i]));
+            if (cached != cache.end())
+                costs[i] = cached->second;
+        }
+        return costs;
+    }
+
+    void loadCache()
+    {
+        if (options.cachePath.empty())
+            return;
+        ifstream cacheFile(options.cachePath);
+        string line;
+        while (getline(cacheFile, line))
+        {
+            size_t separator = line.rfind(" = ");
+            if (separator != string::npos)
+                cache[line.substr(0, separator)] = atof(line.c_str() + separator + 3);
+        }
+        if (!cache.empty())
+            cout << "Optimizer: " << cache.size() << " cached scores from " << options.cachePath << "\n";
+    }
+};
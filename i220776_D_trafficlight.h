@@ -21,9 +21,7 @@ class TrafficLight
     float dir;                // direction of the traffic light (determines the orientation of the traffic light on the map)
     tLightState state;        // current state of the light (either green or red). tLightState should be an enum
     TrafficLight *next;       // pointer to the next traffic light in the traffic light group
-    sf::Texture redTexture;   // texture for red light
-    sf::Texture greenTexture; // texture for green light
-    sf::Sprite sprite;
+    sf::Sprite sprite;        // texture is bound at draw time from the shared red/green textures
 
 public:
     float getX() const { return x; }
@@ -31,16 +29,14 @@ public:
     tLightState getState() const { return state; }
     float getRotation() const { return dir; }
 
-    TrafficLight() : x(0), y(0), dir(0), state(RED)
+    TrafficLight() : x(0), y(0), dir(0), state(RED), next(NULL)
     {
         // Default initialization with some default values
-        redTexture.loadFromFile("images/trafficlights/red.png");
-        sprite.setTexture(redTexture);
         sprite.setPosition(sf::Vector2f(0, 0));
         sprite.setRotation(0);
         sprite.setOrigin(0, 0);
     }
-    TrafficLight(float x, float y, float dir, tLightState state)
+    TrafficLight(float x, float y, float dir, tLightState state) : next(NULL)
     {
         this->x = x;
         this->y = y;
@@ -48,20 +44,6 @@ public:
         this->dir = dir;
         // Initialization of variables (coordiates and rotation)
 
-        // in case of green light
-        if (state == GREEN)
-        {
-            greenTexture.loadFromFile("images/trafficlights/green.png");
-            sprite.setTexture(greenTexture);
-        }
-
-        // in case of red light
-        else
-        {
-            redTexture.loadFromFile("images/trafficlights/red.png");
-            sprite.setTexture(redTexture);
-        }
-
         sprite.setPosition(sf::Vector2f(x, y));
         sprite.setRotation(dir);
         sprite.setOrigin(0, 0);
@@ -95,8 +77,31 @@ public:
         return {x, y, dir};
     }
 
+    static const char *imagePathFor(tLightState state)
+    {
+        return state == GREEN ? "images/trafficlights/green.png" : "images/trafficlights/red.png";
+    }
+
+    // Shared red/green textures, loaded on first draw so headless runs never create a GL context
+    static const sf::Texture &textureFor(tLightState state)
+    {
+        static sf::Texture textures[2];
+        static bool loaded[2] = {false, false};
+
+        if (!loaded[state])
+        {
+            textures[state].loadFromFile(imagePathFor(state));
+            loaded[state] = true;
+        }
+        return textures[state];
+    }
+
     // Draws the traffic lights to the window
-    void draw(sf::RenderWindow *window) { window->draw(this->sprite); }
+    void draw(sf::RenderWindow *window)
+    {
+        sprite.setTexture(textureFor(state));
+        window->draw(this->sprite);
+    }
 
     // Returns current traffic light state
     tLightState getState() { return state; }
@@ -104,17 +109,6 @@ public:
     void setState(tLightState state)
     {
         this->state = state;
-
-        if (state == GREEN)
-        {
-            greenTexture.loadFromFile("images/trafficlights/green.png");
-            sprite.setTexture(greenTexture);
-        }
-        else
-        {
-            redTexture.loadFromFile("images/trafficlights/red.png");
-            sprite.setTexture(redTexture);
-        }
     }
 };
 
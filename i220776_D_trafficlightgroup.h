@@ -16,6 +16,7 @@ using namespace chrono;
 class TrafficLightGroup
 {
     TrafficLight *head;       // Pointer to the head of the traffic light in the group
+    TrafficLight *tail;       // Last light added, so add() never walks the list
     TrafficLight *greenLight; // Traffic light when the state is green
 
     float duration; // Period
@@ -25,7 +26,7 @@ public:
 
     // Constructor for TrafficLightGroup class
     //  duration: TrafficLight period
-    TrafficLightGroup(float duration) : head(NULL), greenLight(NULL), time(0)
+    TrafficLightGroup(float duration) : head(NULL), tail(NULL), greenLight(NULL), time(0)
     {
         // Initialize head, tail, and greenLight pointers to NULL and time to 0.
         this->duration = duration; // Initialize the duration.
@@ -36,18 +37,12 @@ public:
     void add(TrafficLight *light)
     {
         light->setNext(NULL);
-        TrafficLight *tmp = head;
-
-        if (tmp != NULL)
-        {
-            while (tmp->returnNext() != NULL)
-                tmp = tmp->returnNext();
-            tmp->setNext(light);
-        }
+
+        if (tail != NULL)
+            tail->setNext(light);
         else
-        {
             head = light;
-        }
+        tail = light;
 
         // Also add to the vector for easier access
         lights.push_back(light);
@@ -0,0 +1,512 @@
+#pragma once
+#include <SFML/Window.hpp>
+#include <SFML/Graphics.hpp>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <queue>
+#include <unordered_map>
+#include <cstdint>
+#include <cmath>
+#include <pthread.h>
+#include "i220776_D_car.h"
+#include "i220776_D_trafficlight.h"
+#include "i220776_D_roadtile.h"
+#include "i220776_D_scenario.h"
+#include "i220776_D_memoryAccounting.h"
+
+using namespace std;
+using namespace sf;
+
+// Trajectory recording.
+// Every simulation tick is stored as one frame: the light states plus each vehicle's
+// position, speed, type, direction and breakdown flag. Positions and speeds are fixed point
+// (1/100 pixel, 1/100 speed unit) and stored as zigzag varint deltas against the same
+// vehicle in the previous frame, so a car cruising along a lane costs a few bytes per tick.
+//
+// File layout: magic, version, then frames. Each frame is prefixed by its byte length.
+//   frame   := varint(tick delta) varint(time delta ms) varint(light count) varint(light bits)
+//              varint(vehicle count) vehicle*
+//   vehicle := zigzag(id delta within frame) varint(flags) zigzag(x) zigzag(y) zigzag(speed)
+//   flags   := new | broken << 1 | dirIndex << 2 | type << 4
+// x/y/speed are absolute for vehicles flagged new and deltas otherwise.
+
+const uint32_t TRAJECTORY_MAGIC = 0x52585453; // "STXR"
+const uint32_t TRAJECTORY_VERSION = 1;
+const float TRAJECTORY_SCALE = 100.0f; // Fixed point steps per pixel / speed unit
+const size_t TRAJECTORY_QUEUE_LIMIT = 1024; // Frames buffered before the simulation waits for the writer
+// A frame holds at most MAX_SIMULATION_CARS vehicles of five varints each, 10 bytes at most per varint
+const uint64_t TRAJECTORY_MAX_FRAME_BYTES = 5 * 10 * (MAX_SIMULATION_CARS + 1);
+
+struct VehicleSample
+{
+    uint32_t id;
+    uint8_t type; // tVehicleType
+    bool broken;
+    float x, y, dir, speed;
+};
+
+struct TrajectoryFrame
+{
+    uint32_t tick;
+    uint32_t timeMs; // Simulation time of the frame
+    uint32_t lightCount;
+    uint32_t lightStates; // Bit i is the tLightState of light i
+    vector<VehicleSample> vehicles;
+};
+
+// Fills frame from the live simulation arrays
+inline void captureFrame(TrajectoryFrame &frame, uint32_t tick, uint32_t timeMs,
+                         Car *cars[], CarData *carData[], int carCount,
+                         SignalWord signals, int lightCount)
+{
+    frame.tick = tick;
+    frame.timeMs = timeMs;
+    frame.lightCount = lightCount;
+    frame.lightStates = signalLights(signals); // Same bit layout
+
+    frame.vehicles.resize(carCount);
+    for (int i = 0; i < carCount; i++)
+    {
+        VehicleSample &sample = frame.vehicles[i];
+        sample.id = cars[i]->getId();
+        sample.type = cars[i]->getType();
+        sample.broken = carData[i] != nullptr && carData[i]->isBroken;
+        sample.x = cars[i]->getX();
+        sample.y = cars[i]->getY();
+        sample.dir = cars[i]->getDir();
+        sample.speed = cars[i]->getSpeed();
+    }
+}
+
+// Varint / zigzag primitives shared by the writer and the reader
+inline void putVarint(vector<uint8_t> &out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+inline void putZigzag(vector<uint8_t> &out, int64_t value)
+{
+    putVarint(out, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+inline bool getVarint(const uint8_t *&p, const uint8_t *end, uint64_t &value)
+{
+    value = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7)
+    {
+        uint8_t byte = *p++;
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+inline bool getZigzag(const uint8_t *&p, const uint8_t *end, int64_t &value)
+{
+    uint64_t raw;
+    if (!getVarint(p, end, raw))
+        return false;
+    value = (int64_t)(raw >> 1) ^ -(int64_t)(raw & 1);
+    return true;
+}
+
+inline int64_t toFixed(float value) { return (int64_t)llround(value * TRAJECTORY_SCALE); }
+inline float fromFixed(int64_t value) { return value / TRAJECTORY_SCALE; }
+
+// Per-vehicle state the delta coder keeps between frames (fixed point)
+struct TrajectoryVehicleState
+{
+    int64_t x, y, speed;
+};
+
+// Delta state shared by encoder and decoder; only vehicles of the previous frame are kept
+struct TrajectoryCodec
+{
+    uint32_t lastTick = 0;
+    uint32_t lastTimeMs = 0;
+    unordered_map<uint32_t, TrajectoryVehicleState> previous;
+    unordered_map<uint32_t, TrajectoryVehicleState> current;
+
+    void encode(const TrajectoryFrame &frame, vector<uint8_t> &out)
+    {
+        putVarint(out, frame.tick - lastTick);
+        putVarint(out, frame.timeMs - lastTimeMs);
+        putVarint(out, frame.lightCount);
+        putVarint(out, frame.lightStates);
+        putVarint(out, frame.vehicles.size());
+
+        current.clear();
+        uint32_t lastId = 0;
+        for (const VehicleSample &sample : frame.vehicles)
+        {
+            TrajectoryVehicleState state = {toFixed(sample.x), toFixed(sample.y), toFixed(sample.speed)};
+            auto it = previous.find(sample.id);
+            bool isNew = it == previous.end();
+            TrajectoryVehicleState base = isNew ? TrajectoryVehicleState{0, 0, 0} : it->second;
+
+            uint32_t dirIndex = ((int)lround(sample.dir / 90.0f)) & 3;
+            putZigzag(out, (int64_t)sample.id - (int64_t)lastId);
+            putVarint(out, (isNew ? 1u : 0u) | (sample.broken ? 2u : 0u) | (dirIndex << 2) | ((uint32_t)sample.type << 4));
+            putZigzag(out, state.x - base.x);
+            putZigzag(out, state.y - base.y);
+            putZigzag(out, state.speed - base.speed);
+
+            current[sample.id] = state;
+            lastId = sample.id;
+        }
+
+        previous.swap(current);
+        lastTick = frame.tick;
+        lastTimeMs = frame.timeMs;
+    }
+
+    bool decode(const uint8_t *p, const uint8_t *end, TrajectoryFrame &frame)
+    {
+        uint64_t tickDelta, timeDelta, lightCount, lightStates, vehicleCount;
+        if (!getVarint(p, end, tickDelta) || !getVarint(p, end, timeDelta) ||
+            !getVarint(p, end, lightCount) || !getVarint(p, end, lightStates) ||
+            !getVarint(p, end, vehicleCount))
+            return false;
+
+        frame.tick = lastTick + (uint32_t)tickDelta;
+        frame.timeMs = lastTimeMs + (uint32_t)timeDelta;
+        frame.lightCount = (uint32_t)lightCount;
+        frame.lightStates = (uint32_t)lightStates;
+        // Every vehicle takes at least five bytes
+        if (vehicleCount > (uint64_t)MAX_SIMULATION_CARS || vehicleCount > (uint64_t)(end - p) / 5)
+            return false;
+        frame.vehicles.resize(vehicleCount);
+
+        current.clear();
+        uint32_t lastId = 0;
+        for (VehicleSample &sample : frame.vehicles)
+        {
+            int64_t idDelta, dx, dy, dspeed;
+            uint64_t flags;
+            if (!getZigzag(p, end, idDelta) || !getVarint(p, end, flags) ||
+                !getZigzag(p, end, dx) || !getZigzag(p, end, dy) || !getZigzag(p, end, dspeed))
+                return false;
+
+            sample.id = (uint32_t)((int64_t)lastId + idDelta);
+            TrajectoryVehicleState base = {0, 0, 0};
+            if ((flags & 1) == 0)
+            {
+                auto it = previous.find(sample.id);
+                if (it == previous.end())
+                    return false;
+                base = it->second;
+            }
+
+            if ((flags >> 4) >= (uint64_t)VEHICLE_TYPE_COUNT)
+                return false;
+            TrajectoryVehicleState state = {base.x + dx, base.y + dy, base.speed + dspeed};
+            sample.broken = (flags & 2) != 0;
+            sample.dir = ((flags >> 2) & 3) * 90.0f;
+            sample.type = (uint8_t)(flags >> 4);
+            sample.x = fromFixed(state.x);
+            sample.y = fromFixed(state.y);
+            sample.speed = fromFixed(state.speed);
+
+            current[sample.id] = state;
+            lastId = sample.id;
+        }
+
+        previous.swap(current);
+        lastTick = frame.tick;
+        lastTimeMs = frame.timeMs;
+        return p == end;
+    }
+};
+
+// Streams frames to disk. Encoding and writing happen on a background thread so the
+// simulation loop only pays for copying the frame into the queue.
+class TrajectoryWriter
+{
+    ofstream file;
+    TrajectoryCodec codec;
+    queue<TrajectoryFrame> pending;
+    pthread_t writerThread;
+    pthread_mutex_t queueMutex = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t queueChanged = PTHREAD_COND_INITIALIZER;
+    bool running = false;
+    bool stopping = false;
+    uint64_t framesWritten = 0;
+    uint64_t bytesWritten = 0;
+
+    static void *writerThreadMain(void *args)
+    {
+        TrajectoryWriter *writer = static_cast<TrajectoryWriter *>(args);
+        MemoryScope scope(MEMORY_RENDERING);
+        vector<uint8_t> body, prefix;
+
+        while (true)
+        {
+            pthread_mutex_lock(&writer->queueMutex);
+            while (writer->pending.empty() && !writer->stopping)
+                pthread_cond_wait(&writer->queueChanged, &writer->queueMutex);
+
+            if (writer->pending.empty())
+            {
+                pthread_mutex_unlock(&writer->queueMutex);
+                break;
+            }
+
+            TrajectoryFrame frame = std::move(writer->pending.front());
+            writer->pending.pop();
+            pthread_cond_broadcast(&writer->queueChanged);
+            pthread_mutex_unlock(&writer->queueMutex);
+
+            body.clear();
+            prefix.clear();
+            writer->codec.encode(frame, body);
+            putVarint(prefix, body.size());
+            writer->file.write(reinterpret_cast<const char *>(prefix.data()), prefix.size());
+            writer->file.write(reinterpret_cast<const char *>(body.data()), body.size());
+            writer->framesWritten++;
+            writer->bytesWritten += prefix.size() + body.size();
+
+            // Caught up with the simulation: push what we have to disk so an aborted run stays readable
+            pthread_mutex_lock(&writer->queueMutex);
+            bool caughtUp = writer->pending.empty();
+            pthread_mutex_unlock(&writer->queueMutex);
+            if (caughtUp)
+                writer->file.flush();
+        }
+
+        writer->file.flush();
+        return nullptr;
+    }
+
+public:
+    TrajectoryWriter() {}
+    TrajectoryWriter(const TrajectoryWriter &) = delete;
+    TrajectoryWriter &operator=(const TrajectoryWriter &) = delete;
+
+    bool open(const string &path)
+    {
+        file.open(path, ios::binary | ios::trunc);
+        if (!file)
+        {
+            cerr << "Trajectory: cannot create " << path << "\n";
+            return false;
+        }
+
+        uint32_t header[2] = {TRAJECTORY_MAGIC, TRAJECTORY_VERSION};
+        file.write(reinterpret_cast<const char *>(header), sizeof(header));
+        bytesWritten = sizeof(header);
+
+        stopping = false;
+        running = pthread_create(&writerThread, nullptr, writerThreadMain, this) == 0;
+        return running;
+    }
+
+    bool isOpen() const { return running; }
+
+    // Hands a frame to the writer thread; waits only if the writer has fallen far behind
+    void submit(TrajectoryFrame &&frame)
+    {
+        if (!running)
+            return;
+
+        pthread_mutex_lock(&queueMutex);
+        while (pending.size() >= TRAJECTORY_QUEUE_LIMIT)
+            pthread_cond_wait(&queueChanged, &queueMutex);
+        pending.push(std::move(frame));
+        pthread_cond_broadcast(&queueChanged);
+        pthread_mutex_unlock(&queueMutex);
+    }
+
+    // Drains the queue and closes the file
+    void close()
+    {
+        if (!running)
+            return;
+
+        pthread_mutex_lock(&queueMutex);
+        stopping = true;
+        pthread_cond_broadcast(&queueChanged);
+        pthread_mutex_unlock(&queueMutex);
+
+        pthread_join(writerThread, nullptr);
+        file.close();
+        running = false;
+        cout << "Trajectory: wrote " << framesWritten << " frames, " << bytesWritten << " bytes\n";
+    }
+
+    ~TrajectoryWriter() { close(); }
+};
+
+// Reads frames back in order
+class TrajectoryReader
+{
+    ifstream file;
+    TrajectoryCodec codec;
+    vector<uint8_t> body;
+
+public:
+    bool open(const string &path)
+    {
+        file.open(path, ios::binary);
+        uint32_t header[2] = {0, 0};
+        if (!file.read(reinterpret_cast<char *>(header), sizeof(header)))
+        {
+            cerr << "Trajectory: cannot read " << path << "\n";
+            return false;
+        }
+        if (header[0] != TRAJECTORY_MAGIC || header[1] != TRAJECTORY_VERSION)
+        {
+            cerr << "Trajectory: " << path << " is not a version " << TRAJECTORY_VERSION << " recording\n";
+            return false;
+        }
+        return true;
+    }
+
+    // Returns false at the end of the recording or on a truncated/corrupt frame
+    bool next(TrajectoryFrame &frame)
+    {
+        uint64_t length = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            int byte = file.get();
+            if (byte == EOF)
+                return false;
+            length |= (uint64_t)(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0)
+                break;
+        }
+
+        if (length > TRAJECTORY_MAX_FRAME_BYTES)
+            return false;
+        body.resize(length);
+        if (!file.read(reinterpret_cast<char *>(body.data()), length))
+            return false;
+        return codec.decode(body.data(), body.data() + length, frame);
+    }
+};
+
+// Draws frames (recorded or live snapshots) through Car::draw and TrafficLight::draw.
+// Keeps one display-only Car per vehicle id so sprites persist between frames; these cars
+// never enter the simulation, and tlights here are the caller's display copies.
+class FrameView
+{
+    unordered_map<uint32_t, Car *> viewCars;
+    unordered_map<uint32_t, Car *> liveCars;
+
+public:
+    FrameView() {}
+    FrameView(const FrameView &) = delete;
+    FrameView &operator=(const FrameView &) = delete;
+
+    ~FrameView()
+    {
+        for (auto &entry : viewCars)
+            delete entry.second;
+    }
+
+    // Brings the display cars and light states in line with frame
+    void show(const TrajectoryFrame &frame, TrafficLight tlights[], int lightCount)
+    {
+        for (int i = 0; i < lightCount && i < (int)frame.lightCount; i++)
+        {
+            tlights[i].setState(static_cast<tLightState>((frame.lightStates >> i) & 1));
+        }
+
+        liveCars.clear();
+        for (const VehicleSample &sample : frame.vehicles)
+        {
+            Car *car;
+            auto it = viewCars.find(sample.id);
+            if (it == viewCars.end())
+                car = new Car(static_cast<tVehicleType>(sample.type), sample.x, sample.y, sample.dir);
+            else
+                car = it->second;
+
+            car->setPosition(sample.x, sample.y, sample.dir);
+            if (car->isInBrokenState() != sample.broken)
+                car->setBreakdownState(sample.broken);
+            liveCars[sample.id] = car;
+        }
+
+        // Vehicles missing from this frame have left the map
+        for (auto &entry : viewCars)
+        {
+            if (liveCars.find(entry.first) == liveCars.end())
+                delete entry.second;
+        }
+        viewCars.swap(liveCars);
+    }
+
+    // Draws the current frame; the caller adds any overlay and calls window.display()
+    void draw(RenderWindow &window, vector<RoadTile> &roadtiles, TrafficLight tlights[], int lightCount)
+    {
+        window.clear(Color::White);
+        for (auto &tile : roadtiles)
+            tile.draw(&window);
+        for (int i = 0; i < lightCount; i++)
+            tlights[i].draw(&window);
+        for (auto &entry : viewCars)
+            entry.second->draw(&window);
+    }
+};
+
+// Plays a recording back without simulating.
+// speed scales playback (2 = twice as fast); +/- change it and space pauses while running.
+inline void replayTrajectory(RenderWindow &window, const string &path, vector<RoadTile> &roadtiles,
+                             TrafficLight tlights[], int lightCount, float speed)
+{
+    TrajectoryReader reader;
+    if (!reader.open(path))
+        return;
+
+    FrameView view;
+    TrajectoryFrame frame;
+    bool havePrevious = false;
+    uint32_t previousTimeMs = 0;
+    bool paused = false;
+
+    while (window.isOpen())
+    {
+        Event event;
+        while (window.pollEvent(event))
+        {
+            if (event.type == Event::Closed)
+                window.close();
+            if (event.type == Event::KeyPressed)
+            {
+                if (event.key.code == Keyboard::Add)
+                    speed *= 2.0f;
+                else if (event.key.code == Keyboard::Subtract)
+                    speed /= 2.0f;
+                else if (event.key.code == Keyboard::Space)
+                    paused = !paused;
+            }
+        }
+
+        if (paused)
+        {
+            sf::sleep(sf::seconds(0.01f));
+            continue;
+        }
+
+        if (!reader.next(frame))
+            break;
+
+        // Keep the recorded pacing, scaled by the playback speed
+        if (havePrevious && speed > 0)
+            sf::sleep(sf::milliseconds((Int32)((frame.timeMs - previousTimeMs) / speed)));
+        havePrevious = true;
+        previousTimeMs = frame.timeMs;
+
+        view.show(frame, tlights, lightCount);
+        view.draw(window, roadtiles, tlights, lightCount);
+        window.display();
+    }
+}
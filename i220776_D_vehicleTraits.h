@@ -0,0 +1,79 @@
+#pragma once
+#include <cstdint>
+
+// Vehicle types and everything that depends on the type alone.
+// One constexpr row per tVehicleType replaces the switches that used to live in Car (textures),
+// the speed check (limits), ChallanGenerator (category and fine) and the spawner (lane rules).
+// Kernels index VEHICLE_TRAITS by type, so there is no branch per type in the hot loops; code
+// that handles one known type asks traits<TYPE>() and gets the row at compile time.
+
+enum tVehicleType
+{
+    CAR1,
+    CAR2,
+    CAR3,
+    CAR4,
+    CAR5,
+    CAR6,
+    CAR7
+};
+
+const int VEHICLE_TYPE_COUNT = CAR7 + 1;
+
+enum VehicleCategory
+{
+    REGULAR,   // CAR1-CAR4
+    EMERGENCY, // CAR5
+    HEAVY,     // CAR6-CAR7
+    UNKNOWN
+};
+
+struct VehicleTraits
+{
+    const char *imagePath;
+    VehicleCategory category;
+    float speedLimit;   // km/h, a challan is issued above it
+    float fine;         // Base challan amount before the service charge
+    uint8_t laneMask;   // Bit i set when the type may spawn in lane i
+    float length;       // Footprint along the heading, in pixels
+    float width;        // Footprint across the heading
+    int textureLength;  // Size of the placeholder drawn when the image is missing
+    int textureWidth;
+};
+
+const uint8_t ALL_LANES = 0xFF;
+const uint8_t EVEN_LANES = 0xAA; // lane2, lane4, lane6, lane8 (odd 0-based indices)
+
+constexpr VehicleTraits VEHICLE_TRAITS[VEHICLE_TYPE_COUNT] = {
+    {"images/vehicles/car6.png", REGULAR, 60.0f, 5000.0f, ALL_LANES, 36.0f, 18.0f, 60, 30},      // CAR1
+    {"images/vehicles/car2.png", REGULAR, 60.0f, 5000.0f, ALL_LANES, 36.0f, 18.0f, 60, 30},      // CAR2
+    {"images/vehicles/car3.png", REGULAR, 60.0f, 5000.0f, ALL_LANES, 36.0f, 18.0f, 60, 30},      // CAR3
+    {"images/vehicles/car4.png", REGULAR, 60.0f, 5000.0f, ALL_LANES, 36.0f, 18.0f, 60, 30},      // CAR4
+    {"images/vehicles/ambulance.png", EMERGENCY, 80.0f, 0.0f, ALL_LANES, 36.0f, 18.0f, 60, 30},  // CAR5
+    {"images/vehicles/bus.png", HEAVY, 40.0f, 7000.0f, EVEN_LANES, 60.0f, 18.0f, 120, 30},       // CAR6
+    {"images/vehicles/car7.png", HEAVY, 40.0f, 7000.0f, ALL_LANES, 36.0f, 18.0f, 60, 30},        // CAR7
+};
+
+// Longest footprint of any type
+constexpr float maxVehicleLength()
+{
+    float longest = 0;
+    for (const VehicleTraits &traits : VEHICLE_TRAITS)
+        longest = traits.length > longest ? traits.length : longest;
+    return longest;
+}
+
+inline const VehicleTraits &traitsOf(tVehicleType type) { return VEHICLE_TRAITS[type]; }
+
+template <tVehicleType Type>
+constexpr const VehicleTraits &traits()
+{
+    static_assert(Type >= CAR1 && Type <= CAR7, "no traits for this vehicle type");
+    return VEHICLE_TRAITS[Type];
+}
+
+template <tVehicleType Type>
+constexpr bool allowedInLane(int lane)
+{
+    return (traits<Type>().laneMask >> lane) & 1;
+}
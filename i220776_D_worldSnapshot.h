@@ -0,0 +1,116 @@
+#pragma once
+#include <iostream>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include "i220776_D_scenario.h"
+#include "i220776_D_signalPlan.h"
+#include "i220776_D_vehicleTraits.h"
+
+using namespace std;
+
+// Counters of the whole intersection for readers outside the simulation thread.
+// Simulation::step publishes a WorldSnapshot at the end of every tick through a Seqlock: the
+// writer bumps a sequence number to odd, stores the value and bumps it back to even; a reader
+// copies the value and retries if the sequence was odd or moved while it copied. The writer
+// never waits for anyone, and any number of portal, payment or analytics threads read a
+// consistent tick without a lock.
+
+template <typename T>
+class Seqlock
+{
+    static_assert(is_trivially_copyable<T>::value && sizeof(T) % sizeof(uint32_t) == 0,
+                  "Seqlock holds plain values made of 32-bit words");
+    static const size_t WORDS = sizeof(T) / sizeof(uint32_t);
+
+    atomic<uint32_t> sequence; // Odd while a write is in progress
+    atomic<uint32_t> words[WORDS];
+
+public:
+    Seqlock() : sequence(0)
+    {
+        for (atomic<uint32_t> &word : words)
+            word.store(0, memory_order_relaxed);
+    }
+
+    Seqlock(const Seqlock &) = delete;
+    Seqlock &operator=(const Seqlock &) = delete;
+
+    // Single writer only
+    void publish(const T &value)
+    {
+        uint32_t copy[WORDS];
+        memcpy(copy, &value, sizeof(T));
+
+        uint32_t start = sequence.load(memory_order_relaxed);
+        sequence.store(start + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        for (size_t i = 0; i < WORDS; i++)
+            words[i].store(copy[i], memory_order_relaxed);
+        sequence.store(start + 2, memory_order_release);
+    }
+
+    // The last published value, never torn; all zero before the first publish
+    T read() const
+    {
+        uint32_t copy[WORDS];
+        uint32_t before, after;
+        do
+        {
+            before = sequence.load(memory_order_acquire);
+            for (size_t i = 0; i < WORDS; i++)
+                copy[i] = words[i].load(memory_order_relaxed);
+            atomic_thread_fence(memory_order_acquire);
+            after = sequence.load(memory_order_relaxed);
+        } while ((before & 1) || before != after);
+
+        T value;
+        memcpy(&value, copy, sizeof(T));
+        return value;
+    }
+
+    // Number of values published so far
+    uint32_t version() const { return sequence.load(memory_order_acquire) / 2; }
+};
+
+// Every field is 32 bits wide, see Seqlock
+struct WorldSnapshot
+{
+    uint32_t tick;
+    uint32_t timeMs;
+    SignalWord signals;
+    int32_t vehicles;
+    int32_t vehiclesByType[VEHICLE_TYPE_COUNT];
+    int32_t carsInLane[SCENARIO_LANES];
+    int32_t approaching[SCENARIO_MAX_LIGHTS]; // Vehicles before each light's stop line
+    int32_t waiting[SCENARIO_MAX_LIGHTS];     // Of those, held by a red light
+    int32_t breakdowns;
+    int32_t challansIssued;
+    int32_t challansUnpaid;
+    int32_t activeChallans; // Plates in SmartTraffix's active challan queue
+    float finesOutstanding; // Total amount of the unpaid challans, PKR
+};
+
+inline void printWorldSnapshot(ostream &out, const WorldSnapshot &snapshot, int lightCount)
+{
+    out << "Intersection at tick " << snapshot.tick << " (" << snapshot.timeMs / 1000.0 << " s):\n";
+    out << "Vehicles: " << snapshot.vehicles << " (";
+    for (int type = 0; type < VEHICLE_TYPE_COUNT; type++)
+        out << (type ? ", " : "") << "CAR" << type + 1 << " " << snapshot.vehiclesByType[type];
+    out << ")\n";
+    out << "Lanes:";
+    for (int lane = 0; lane < SCENARIO_LANES; lane++)
+        out << " " << snapshot.carsInLane[lane];
+    out << "\n";
+    for (int light = 0; light < lightCount; light++)
+    {
+        out << "Light " << light << ": " << (signalLight(snapshot.signals, light) == GREEN ? "GREEN" : "RED")
+            << ", " << snapshot.waiting[light] << " waiting of " << snapshot.approaching[light] << " approaching\n";
+    }
+    if (signalPriority(snapshot.signals))
+        out << "Ambulance priority active\n";
+    out << "Breakdowns: " << snapshot.breakdowns << "\n";
+    out << "Challans: " << snapshot.challansIssued << " issued, " << snapshot.challansUnpaid << " unpaid ("
+        << snapshot.finesOutstanding << " PKR outstanding), " << snapshot.activeChallans << " active\n";
+}